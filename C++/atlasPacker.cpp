@@ -0,0 +1,203 @@
+/* -----------------------------------------------------------------------------------
+   -- atlasPacker.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <algorithm>
+#include <climits>
+#include "atlasPacker.hpp"
+
+// -----------------------------------------------------------------------------------
+// Tall images first, then wide, gives the skyline the least ragged top.
+static bool ItemOrder(const std::pair<int, int> &a, const std::pair<int, int> &b)
+{
+    if (a.first != b.first)
+        return a.first > b.first;
+    return a.second > b.second;
+}
+
+// -----------------------------------------------------------------------------------
+AtlasPacker::AtlasPacker(int _pageWidth, int _pageHeight, int _padding) :
+    pageWidth(_pageWidth)
+  , pageHeight(_pageHeight)
+  , padding(_padding)
+  , items()
+  , pages()
+  , regions()
+  , rejected()
+  , usedArea(0)
+{}
+
+// -----------------------------------------------------------------------------------
+void AtlasPacker::Add(const std::string &key, int width, int height)
+{
+    Item item;
+    item.key = key;
+    item.width = width;
+    item.height = height;
+    items.push_back(item);
+}
+
+// -----------------------------------------------------------------------------------
+void AtlasPacker::Clear()
+{
+    items.clear();
+    pages.clear();
+    regions.clear();
+    rejected.clear();
+    usedArea = 0;
+}
+
+// -----------------------------------------------------------------------------------
+bool AtlasPacker::GetRegion(const std::string &key, AtlasRegion &region) const
+{
+    AtlasRegionMap::const_iterator it = regions.find(key);
+    if (it == regions.end())
+    {
+        return false;
+    }
+    region = it->second;
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+float AtlasPacker::GetFillEfficiency() const
+{
+    if (pages.empty())
+    {
+        return 0.0f;
+    }
+    return (float)((double)usedArea / ((double)pages.size() * pageWidth * pageHeight));
+}
+
+// -----------------------------------------------------------------------------------
+// Find the lowest spot on the skyline the rectangle fits, ties go to the left most.
+bool AtlasPacker::Find(Skyline &sky, int width, int height, int &bestIndex, int &bestX, int &bestY)
+{
+    int bestTop = INT_MAX;
+    bestIndex = -1;
+    for (size_t i = 0; i < sky.size(); ++i)
+    {
+        int x = sky[i].x;
+        if (x + width > pageWidth)
+        {
+            break;
+        }
+        // the rectangle rests on the highest node it spans
+        int y = 0;
+        int remaining = width;
+        for (size_t j = i; remaining > 0; ++j)
+        {
+            y = std::max(y, sky[j].y);
+            remaining -= sky[j].width;
+        }
+        if (y + height > pageHeight)
+        {
+            continue;
+        }
+        if (y + height < bestTop)
+        {
+            bestTop = y + height;
+            bestIndex = i;
+            bestX = x;
+            bestY = y;
+        }
+    }
+    return bestIndex >= 0;
+}
+
+// -----------------------------------------------------------------------------------
+void AtlasPacker::Place(Skyline &sky, int index, int x, int y, int width, int height)
+{
+    SkylineNode node;
+    node.x = x;
+    node.y = y + height;
+    node.width = width;
+    sky.insert(sky.begin() + index, node);
+
+    // trim the nodes now under the new one
+    for (size_t i = index + 1; i < sky.size(); )
+    {
+        int overlap = (sky[i - 1].x + sky[i - 1].width) - sky[i].x;
+        if (overlap <= 0)
+        {
+            break;
+        }
+        sky[i].x += overlap;
+        sky[i].width -= overlap;
+        if (sky[i].width <= 0)
+        {
+            sky.erase(sky.begin() + i);
+            continue;
+        }
+        break;
+    }
+
+    // merge neighbours at the same height
+    for (size_t i = 0; i + 1 < sky.size(); )
+    {
+        if (sky[i].y == sky[i + 1].y)
+        {
+            sky[i].width += sky[i + 1].width;
+            sky.erase(sky.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+int AtlasPacker::Pack()
+{
+    std::vector< std::pair<int, int> > order;      // (height, index)
+    order.reserve(items.size());
+    for (size_t i = 0; i < items.size(); ++i)
+    {
+        order.push_back(std::make_pair(items[i].height, (int)i));
+    }
+    std::stable_sort(order.begin(), order.end(), ItemOrder);
+
+    for (size_t n = 0; n < order.size(); ++n)
+    {
+        const Item &item = items[order[n].second];
+        int w = item.width + padding * 2;
+        int h = item.height + padding * 2;
+        if (w > pageWidth || h > pageHeight || item.width <= 0 || item.height <= 0)
+        {
+            rejected.push_back(item.key);
+            continue;
+        }
+
+        int page = -1, index = -1, x = 0, y = 0;
+        for (size_t p = 0; p < pages.size(); ++p)
+        {
+            if (Find(pages[p], w, h, index, x, y))
+            {
+                page = p;
+                break;
+            }
+        }
+        if (page < 0)
+        {
+            Skyline sky;
+            SkylineNode node = { 0, 0, pageWidth };
+            sky.push_back(node);
+            pages.push_back(sky);
+            page = pages.size() - 1;
+            Find(pages[page], w, h, index, x, y);
+        }
+        Place(pages[page], index, x, y, w, h);
+
+        AtlasRegion region;
+        region.page = page;
+        region.x = x + padding;
+        region.y = y + padding;
+        region.width = item.width;
+        region.height = item.height;
+        regions[item.key] = region;
+        usedArea += (long long)item.width * item.height;
+    }
+    items.clear();
+    return pages.size();
+}
@@ -0,0 +1,67 @@
+/* -----------------------------------------------------------------------------------
+   -- atlasPacker.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __ATLAS_PACKER_HPP__
+#define __ATLAS_PACKER_HPP__
+#include <string>
+#include <vector>
+#include <map>
+
+// -----------------------------------------------------------------------------------
+// Where an image ended up in the atlas, in pixels of the page.
+struct AtlasRegion
+{
+    int page;
+    int x, y;
+    int width, height;
+};
+typedef std::map<std::string, AtlasRegion> AtlasRegionMap;
+
+// -----------------------------------------------------------------------------------
+// Packs rectangles onto fixed size pages with the skyline bottom-left heuristic.
+// This has no GL in it, so it can be used by the offline tools as well as by the
+// TextureAtlas at load time.
+class AtlasPacker
+{
+private:
+    struct Item
+    {
+        std::string key;
+        int width, height;
+    };
+    struct SkylineNode
+    {
+        int x, y, width;
+    };
+    typedef std::vector<SkylineNode> Skyline;
+
+    int                     pageWidth, pageHeight;  // the size of every page
+    int                     padding;                // the gap left around every image
+    std::vector<Item>       items;                  // the images waiting to be packed
+    std::vector<Skyline>    pages;                  // the skyline of every page
+    AtlasRegionMap          regions;                // the packed results
+    std::vector<std::string> rejected;              // images too large for a page
+    long long               usedArea;               // pixels covered by packed images
+
+    bool Find(Skyline &sky, int width, int height, int &bestIndex, int &bestX, int &bestY);
+    void Place(Skyline &sky, int index, int x, int y, int width, int height);
+
+public:
+    AtlasPacker(int _pageWidth, int _pageHeight, int _padding);
+
+    void Add(const std::string &key, int width, int height);   // queue a image to pack
+    int  Pack();                                                // pack everything queued, returns the number of pages
+    void Clear();
+
+    bool GetRegion(const std::string &key, AtlasRegion &region) const;
+    const AtlasRegionMap & GetRegions() const       { return regions; }
+    const std::vector<std::string> & GetRejected() const { return rejected; }
+    int  GetNumPages() const                        { return pages.size(); }
+    int  GetPageWidth() const                       { return pageWidth; }
+    int  GetPageHeight() const                      { return pageHeight; }
+    long long GetUsedArea() const                   { return usedArea; }
+    float GetFillEfficiency() const;                // used area over the total area of all pages
+};
+
+#endif
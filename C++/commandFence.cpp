@@ -0,0 +1,73 @@
+/* -----------------------------------------------------------------------------------
+   -- commandFence.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "commandFence.hpp"
+#include "commandProperty.hpp"      // StaticQueueCommand
+
+std::mutex CommandFence::lock;
+std::vector<long> CommandFence::completed;
+std::atomic<long> CommandFence::issued(0);
+
+// -----------------------------------------------------------------------------------
+CommandFence::CommandFence() : BaseCommandObject()
+    , id(++issued)
+    , done(false)
+{}
+
+// -----------------------------------------------------------------------------------
+CommandFence::~CommandFence()
+{}
+
+// -----------------------------------------------------------------------------------
+void CommandFence::Boost()
+{
+    class_ < CommandFence, CommandFencePtr, bases<BaseCommandObject>, boost::noncopyable >("CommandFence", "Marks a point in the command queue, done once the render thread applied it", no_init)
+        .def("Queue", &CommandFence::Queue, "Queue a fence after everything queued so far")
+        .staticmethod("Queue")
+        .def("Collect", &CommandFence::Collect, "The ids of the fences applied since the last call, once per tick")
+        .staticmethod("Collect")
+        .add_property("id", &CommandFence::GetID)
+        .add_property("done", &CommandFence::IsDone)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+CommandFencePtr CommandFence::Queue()
+{
+    CommandFencePtr fence(new CommandFence());
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(fence);
+    StaticQueueCommand(cmd);
+    return fence;
+}
+
+// -----------------------------------------------------------------------------------
+list CommandFence::Collect()
+{
+    std::vector<long> ids;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ids.swap(completed);
+    }
+    list result;
+    for (std::vector<long>::iterator it = ids.begin(); it != ids.end(); ++it)
+    {
+        result.append(*it);
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread, no python here.
+void CommandFence::ApplyCommand(CommandObjectPtr cmd)
+{
+    done = true;
+    std::lock_guard<std::mutex> guard(lock);
+    completed.push_back(id);
+}
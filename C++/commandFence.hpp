@@ -0,0 +1,45 @@
+/* -----------------------------------------------------------------------------------
+   -- commandFence.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __COMMAND_FENCE_HPP__
+#define __COMMAND_FENCE_HPP__
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "commandObject.hpp"
+
+class CommandFence;
+typedef boost::shared_ptr<CommandFence> CommandFencePtr;
+
+// -----------------------------------------------------------------------------------
+// Tells python when the render thread has caught up. The queue is applied in order,
+// so once the fence's own command is applied every command and batch queued before it
+// has been too. The render thread only marks the fence done and puts it on the
+// completed list, Collect hands the ids to python on its own thread, where
+// CommandFuture.py wakes the tasklets waiting on them.
+class CommandFence : public BaseCommandObject
+{
+private:
+    static std::mutex               lock;
+    static std::vector<long>        completed;      // fences applied since the last Collect
+    static std::atomic<long>        issued;         // the last id handed out
+    long                            id;
+    std::atomic<bool>               done;
+
+public:
+    CommandFence();
+    ~CommandFence();
+    static void Boost();
+
+    static CommandFencePtr Queue();                 // python thread, after the commands to wait for
+    static list Collect();                          // .. the ids applied since the last call
+    long GetID()                                    { return id; }
+    bool IsDone()                                   { return done; }
+
+public:                             // BaseCommandObject
+    virtual void ApplyCommand(CommandObjectPtr cmd);
+};
+
+#endif
@@ -6,8 +6,13 @@
 #include "utils.hpp"
 #include "boost/any.hpp"
 #include "profiler.hpp"
+#include "gilGuard.hpp"
+#include "renderStats.hpp"
 using boost::any_cast;
 
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
 #define PRELOAD_CACHE 10
 
 void BaseCommandObject::Boost()
@@ -15,6 +20,35 @@ void BaseCommandObject::Boost()
     docstring_options doc_options(true);
     class_ < BaseCommandObject, boost::noncopyable>("BaseCommandObject", "A command Object for changing things", no_init);
 }
+// -----------------------------------------------------------------------------------
+// The SetData payloads are the property values, so those are the types looked for.
+// Anything else is counted as a holder with a pointer sized value.
+long long CommandObject::PayloadBytes(const boost::any &a)
+{
+    if (a.empty())                                          return 0;
+    if (const std::string *s = any_cast<std::string>(&a))   return PayloadBytes(*s);
+    if (const std::vector<std::string> *l = any_cast< std::vector<std::string> >(&a))
+    {
+        long long bytes = PayloadBytes(*l);
+        for (std::vector<std::string>::const_iterator it = l->begin(); it != l->end(); ++it)
+        {
+            bytes += MemoryAccounting::StringBytes(*it);
+        }
+        return bytes;
+    }
+    if (const int *v = any_cast<int>(&a))                   return PayloadBytes(*v);
+    if (const long *v = any_cast<long>(&a))                 return PayloadBytes(*v);
+    if (const float *v = any_cast<float>(&a))               return PayloadBytes(*v);
+    if (const double *v = any_cast<double>(&a))             return PayloadBytes(*v);
+    if (const bool *v = any_cast<bool>(&a))                 return PayloadBytes(*v);
+    if (const glm::vec2 *v = any_cast<glm::vec2>(&a))       return PayloadBytes(*v);
+    if (const glm::vec3 *v = any_cast<glm::vec3>(&a))       return PayloadBytes(*v);
+    if (const glm::vec4 *v = any_cast<glm::vec4>(&a))       return PayloadBytes(*v);
+    if (const glm::mat4 *v = any_cast<glm::mat4>(&a))       return PayloadBytes(*v);
+    if (const voidPtr *v = any_cast<voidPtr>(&a))           return PayloadBytes(*v);
+    return 2 * sizeof(void *);
+}
+
 // -----------------------------------------------------------------------------------
 // This class will mange the cache of command objects, ensuring they are allocated
 // as needed and destroyed on shutdown.
@@ -41,9 +75,14 @@ CommandObject::CommandObject(void):
     inCache(1),
     // the arguments of the command
     dest(),
+    accounted(MemoryAccounting::Alloc(MEM_COMMANDS, sizeof(CommandObject))),
     profileTimeStart(0.0f)
 
 {
+    for (int i = 0; i < 6; ++i)
+    {
+        dataBytes[i] = 0;
+    }
     Reset();
 }
 
@@ -51,6 +90,7 @@ CommandObject::CommandObject(void):
 CommandObject::~CommandObject(void)
 {
     Reset(); // ensure that all pointers are cleaned up
+    MemoryAccounting::Free(MEM_COMMANDS, accounted);
 }
 
 void CommandObject::Boost()
@@ -105,20 +145,48 @@ void CommandObject::Apply()
 {
     IN_CACHE(0);
     GLFW_THREAD_CHECK(); // commands can only be applied from the GLFW thread!
+    GIL_FREE_CHECK();
     assert(dest && "Apply:: Dest not set");
     dest->ApplyCommand(this);
+    dest->CommandApplied();
+    RENDER_STAT_INC(RS_COMMANDS)
 }
 
 // -----------------------------------------------------------------------------------
 // reset the cache, we have guard bits for sanity checking this.
 // It might just be faster and better to skip the guards and
-// just clear them.
+// just clear them. Off the python thread the destination, or a pointer python set,
+// may be the last reference to it, only those are dropped by the PyReleaseQueue.
 void CommandObject::Reset(void)
 {
     cmd = CMD_INVALID;
     id = 0;
+    if (!PyGILHeld())
+    {
+        if (dest && dest.use_count() == 1)
+        {
+            PyReleaseQueue::Defer(dest);
+        }
+        boost::any *data[] = { &any1, &any2, &any3, &any4, &any5, &any6 };
+        for (int i = 0; i < 6; ++i)
+        {
+            if (!data[i]->empty() && data[i]->type() == typeid(voidPtr))
+            {
+                voidPtr &ptr = any_cast<voidPtr &>(*data[i]);
+                if (ptr.use_count() == 1)
+                {
+                    PyReleaseQueue::Defer(ptr);
+                }
+            }
+        }
+    }
     dest = nullPtr;
     any1 = any2 = any3 = any4 = any5 = any6 = NULL;
+    for (int i = 0; i < 6; ++i)
+    {
+        MemoryAccounting::Free(MEM_COMMAND_DATA, dataBytes[i]);
+        dataBytes[i] = 0;
+    }
 }
 // -----------------------------------------------------------------------------------
 // return a dubug display of this object
@@ -21,6 +21,7 @@
 #include "graphicsEnums.hpp"
 #include "profiler.hpp"
 #include "nullPointer.hpp"
+#include "memoryAccounting.hpp"
 
 using namespace boost::python;
 using namespace std;
@@ -39,9 +40,12 @@ typedef vector<CommandObjectPtr> CommandObjectVector;
 class BaseCommandObject : public boost::enable_shared_from_this<BaseCommandObject>
 {
 public:
-    BaseCommandObject(void): boost::enable_shared_from_this<BaseCommandObject>() {};
+    BaseCommandObject(void): boost::enable_shared_from_this<BaseCommandObject>(), unpublished(false) {};
     ~BaseCommandObject(void){};
     virtual void ApplyCommand(CommandObjectPtr cmd) = 0;
+    virtual void CommandApplied(void) {};   // called after every ApplyCommand, the change bits are current
+
+    bool unpublished;                       // being loaded, the render thread can't reach it yet. See BulkLoad
 
     template <typename T>
         boost::shared_ptr<T> GetThis(void) {return dynamic_pointer_cast<T> (shared_from_this());};
@@ -71,6 +75,21 @@ private:                // Argument storage
     boost::any any5;
     boost::any any6;
     // Add other types here.
+    long long accounted;            // MemoryAccounting, this object
+    long long dataBytes[6];         // .. each any's payload
+
+    // what a payload holds: the any's holder, and what the value keeps on the heap
+    template <typename P> static long long PayloadBytes(const P &)                    { return sizeof(P) + sizeof(void *); }
+    static long long PayloadBytes(const std::string &s)                               { return sizeof(std::string) + sizeof(void *) + MemoryAccounting::StringBytes(s); }
+    template <typename P> static long long PayloadBytes(const std::vector<P> &v)      { return sizeof(std::vector<P>) + sizeof(void *) + v.capacity() * sizeof(P); }
+    static long long PayloadBytes(const boost::any &a);                               // SetData, the value's type is looked up
+    template <typename P> void SetSlot(boost::any &slot, int i, const P &item)
+    {
+        IN_CACHE(0);
+        slot = item;
+        MemoryAccounting::Free(MEM_COMMAND_DATA, dataBytes[i]);
+        dataBytes[i] = MemoryAccounting::Enabled() ? MemoryAccounting::Alloc(MEM_COMMAND_DATA, PayloadBytes(item)) : 0;
+    }
 
 public:                 // the command collection and recycling services
     static CommandObjectPtr GetCommand(Commands cmdType);           // this will get a new command if  there is none on the list
@@ -94,37 +113,37 @@ public:                 // External data interface
 
     // GEt and set the Any data
     void GetData1(boost::any &a)            { IN_CACHE(0); a = any1;};
-    void SetData1(boost::any a)             { IN_CACHE(0); any1 = a;};
+    void SetData1(boost::any a)             { SetSlot(any1, 0, a); }
 
     void GetData2(boost::any &a)            { IN_CACHE(0); a = any2;};
-    void SetData2(boost::any a)             { IN_CACHE(0); any2 = a;};
+    void SetData2(boost::any a)             { SetSlot(any2, 1, a); }
 
     void GetData3(boost::any &a)            { IN_CACHE(0); a = any3;};
-    void SetData3(boost::any a)             { IN_CACHE(0); any3 = a;};
+    void SetData3(boost::any a)             { SetSlot(any3, 2, a); }
 
     void GetData4(boost::any &a)            { IN_CACHE(0); a = any4;};
-    void SetData4(boost::any a)             { IN_CACHE(0); any4 = a;};
+    void SetData4(boost::any a)             { SetSlot(any4, 3, a); }
 
     void GetData5(boost::any &a)            { IN_CACHE(0); a = any5;};
-    void SetData5(boost::any a)             { IN_CACHE(0); any5 = a;};
+    void SetData5(boost::any a)             { SetSlot(any5, 4, a); }
 
     void GetData6(boost::any &a)            { IN_CACHE(0); a = any6;};
-    void SetData6(boost::any a)             { IN_CACHE(0); any6 = a;};
+    void SetData6(boost::any a)             { SetSlot(any6, 5, a); }
 
 
     // templated get and set for when we know the type going in and out
     template <typename P> P Get1()          {IN_CACHE(0); return any_cast< P > (any1);}
-    template <typename P> void Set1(P item) {IN_CACHE(0); any1 = item;}
+    template <typename P> void Set1(P item) {SetSlot(any1, 0, item);}
     template <typename P> P Get2()          {IN_CACHE(0); return any_cast< P > (any2);}
-    template <typename P> void Set2(P item) {IN_CACHE(0); any2 = item;}
+    template <typename P> void Set2(P item) {SetSlot(any2, 1, item);}
     template <typename P> P Get3()          {IN_CACHE(0); return any_cast< P > (any3);}
-    template <typename P> void Set3(P item) {IN_CACHE(0); any3 = item;}
+    template <typename P> void Set3(P item) {SetSlot(any3, 2, item);}
     template <typename P> P Get4()          {IN_CACHE(0); return any_cast< P > (any4);}
-    template <typename P> void Set4(P item) {IN_CACHE(0); any4 = item;}
+    template <typename P> void Set4(P item) {SetSlot(any4, 3, item);}
     template <typename P> P Get5()          {IN_CACHE(0); return any_cast< P > (any5);}
-    template <typename P> void Set5(P item) {IN_CACHE(0); any5 = item;}
+    template <typename P> void Set5(P item) {SetSlot(any5, 4, item);}
     template <typename P> P Get6()          {IN_CACHE(0); return any_cast< P > (any6);}
-    template <typename P> void Set6(P item) {IN_CACHE(0); any6 = item;}
+    template <typename P> void Set6(P item) {SetSlot(any6, 5, item);}
 
 
     // Concreat versions for exposing to python, May not need so could remove.
@@ -32,6 +32,31 @@ using boost::any_cast;
 // Name
 #define ExposeGetterSetter(N) N##BaseType Get##N() { return N.pyGet();} void Set##N(N##BaseType v) { N.pySet(v);}
 
+// -----------------------------------------------------------------------------------
+// Bulk loading. While one of these is alive for an object, pySet on that object's
+// properties writes both sides directly, the way Sync does, instead of queuing an
+// update per property. Only for an object the render thread can't reach yet: the
+// decoders wrap each freshly built node in one around its DecodeBinary or DecodeYaml,
+// and the subtree is handed over afterwards with a single RO_Base::Attach. Every
+// other object, and every other pySet on the thread, still goes through a command.
+// NULL does nothing, for a caller that only sometimes loads in bulk.
+class BulkLoad
+{
+public:
+    BulkLoad(BaseCommandObject *_obj) : obj(_obj), was(_obj != NULL && _obj->unpublished)
+    {
+        if (obj) obj->unpublished = true;
+    }
+    ~BulkLoad()
+    {
+        if (obj) obj->unpublished = was;
+    }
+    static long &Bypassed()         { static thread_local long bypassed = 0; return bypassed; }    // updates not queued, for the load stats
+private:
+    BaseCommandObject  *obj;
+    bool                was;
+};
+
 // -----------------------------------------------------------------------------------
 
 template <typename T>
@@ -44,6 +69,7 @@ private:                        // the internal data storage
     T pyValue;                              // the python value
     T cValue;                               // the C side value
     int changeBit:1;                        // the bit that indicates the value changed.
+    int damageBit:1;                        // the C side value really is different, DamageTracker's, see takeDamage
 protected:                      // The interface to derived classes
     void DoUpdate(T value)
     {
@@ -58,9 +84,9 @@ public:                         // publicly exposed interface
     typedef T   valueType;
     // -----------------------------------------------------------------------------------
     // Constuctors with and without initalization values
-    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent): name(_name), ID(_ID), parent(_parent), pyValue(), cValue(), changeBit(1) {};
-    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent, T _value): name(_name), ID(_ID), parent(_parent), pyValue(_value), cValue(_value), changeBit(1) {};
-    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent, const CommandProperty<T>  &othr): name(_name), ID(_ID), parent(_parent), pyValue(othr.pyValue), cValue(othr.cValue), changeBit(1) {};
+    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent): name(_name), ID(_ID), parent(_parent), pyValue(), cValue(), changeBit(1), damageBit(1) {};
+    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent, T _value): name(_name), ID(_ID), parent(_parent), pyValue(_value), cValue(_value), changeBit(1), damageBit(1) {};
+    CommandProperty(std::string _name, int _ID, BaseCommandObject * _parent, const CommandProperty<T>  &othr): name(_name), ID(_ID), parent(_parent), pyValue(othr.pyValue), cValue(othr.cValue), changeBit(1), damageBit(1) {};
     virtual ~CommandProperty(){};
 
 
@@ -89,10 +115,36 @@ public:                         // publicly exposed interface
     // And the settor for the python side of things.
     void pySet(T value)
     {
+        if (parent->unpublished)
+        {
+            pyValue = cValue = value;
+            BulkLoad::Bypassed()++;
+            return;
+        }
         DoUpdate(value);
         pyValue = value;
     }
 
+    // -----------------------------------------------------------------------------------
+    // The two halves of pySet for an update that travels in a NodeBatch with others,
+    // instead of in a command of its own. pyStage on the python thread, cApply on the
+    // render thread when the batch is applied. True if the C side value changed.
+    void pyStage(T value)
+    {
+        pyValue = value;
+    }
+    bool cApply(T value)
+    {
+        changeBit = 1;
+        if (cValue == value)
+        {
+            return false;
+        }
+        cValue = value;
+        damageBit = 1;
+        return true;
+    }
+
     // -----------------------------------------------------------------------------------
     // Serializing in from a Yaml Node
     const YAML::Node& operator<< (const YAML::Node& node)
@@ -132,6 +184,11 @@ public:                         // publicly exposed interface
     bool changed() {return changeBit;}
     void clearChanged() { changeBit = 0;}
 
+    // Set only when an update really changed the C side value. Kept apart from the
+    // change bit so the DamageTracker, its only reader, can clear it without anyone
+    // else that watches changed() missing an update. Render thread only.
+    bool takeDamage() { bool d = damageBit; damageBit = 0; return d;}
+
     // -----------------------------------------------------------------------------------
     // Handle the update command and transfer the data from the Py side to the C side.
     int ApplyCommand(CommandObjectPtr cmd)
@@ -145,9 +202,7 @@ public:                         // publicly exposed interface
         {
             boost::any value;
             cmd->GetData1(value);
-
-            cValue = any_cast< T >(value);
-            changeBit = 1;
+            cApply(any_cast< T >(value));
         }
         else
         {
@@ -0,0 +1,247 @@
+/* -----------------------------------------------------------------------------------
+   -- damageTracker.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "damageTracker.hpp"
+#include "textureStreamer.hpp"
+#include "frameProfiler.hpp"
+#include "utils.hpp"
+#include "gilGuard.hpp"
+
+DamageTrackerPtr DamageTracker::instance;
+
+// -----------------------------------------------------------------------------------
+DamageTracker::DamageTracker() :
+    damaged()
+  , frameDamage(0.f)
+  , frameFull(true)
+  , haveDamage(false)
+  , fullDamage(true)
+  , scissorOn(false)
+  , lastProjView(1.f)
+  , cameraPosition(0.f)
+  , viewportSize(0.f)
+  , orthoView(0.f)
+  , structureVersion(0)
+  , enabled(true)
+  , scissor(false)
+  , bufferAge(2)
+  , idleFrames(0)
+  , activeFrames(0)
+  , partialFrames(0)
+{
+    for (int i = 0; i < MAX_DAMAGE_HISTORY; ++i)
+    {
+        history[i] = glm::vec4(0.f);
+        historyHas[i] = false;
+        historyFull[i] = true;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+DamageTracker::~DamageTracker()
+{}
+
+// -----------------------------------------------------------------------------------
+void DamageTracker::Boost()
+{
+    class_ < DamageTracker, DamageTrackerPtr, boost::noncopyable >("DamageTracker", "Skips frames where nothing on screen changed", no_init)
+        .def("GetInstance", &DamageTracker::GetInstance)
+        .staticmethod("GetInstance")
+        .add_property("enabled", &DamageTracker::GetEnabled, &DamageTracker::SetEnabled, "When off every frame is drawn")
+        .add_property("scissor", &DamageTracker::GetScissor, &DamageTracker::SetScissor, "Only redraw the damaged part of the screen")
+        .add_property("bufferAge", &DamageTracker::GetBufferAge, &DamageTracker::SetBufferAge, "Frames old the back buffer is when we draw into it")
+        .add_property("idleFrames", &DamageTracker::GetIdleFrames, "Frames skipped")
+        .add_property("activeFrames", &DamageTracker::GetActiveFrames, "Frames drawn")
+        .add_property("partialFrames", &DamageTracker::GetPartialFrames, "Frames drawn through the scissor")
+        .def("DamageAll", &DamageTracker::DamageAll, "Draw the whole of the next frame")
+        .def("ResetStats", &DamageTracker::ResetStats)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void DamageTracker::StartInstance()
+{
+    if (!instance)
+    {
+        instance = DamageTrackerPtr(new DamageTracker());
+    }
+}
+
+// -----------------------------------------------------------------------------------
+DamageTrackerPtr DamageTracker::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void DamageTracker::StopInstance()
+{
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+// Where the object was drawn is taken now, before its next transform, where it goes
+// is taken in ApplyScissor.
+void DamageTracker::Damage(RO_Base *object)
+{
+    if (!instance || !instance->enabled)
+    {
+        return;
+    }
+    instance->damaged.push_back(boost::weak_ptr<BaseCommandObject>(object->shared_from_this()));
+    glm::vec4 rect;
+    if (!object->GetScreenRect(instance->lastProjView, rect))
+    {
+        instance->fullDamage = true;
+        return;
+    }
+    instance->AddRect(rect);
+}
+
+// -----------------------------------------------------------------------------------
+void DamageTracker::AddRect(const glm::vec4 &rect)
+{
+    if (!haveDamage)
+    {
+        frameDamage = rect;
+        haveDamage = true;
+        return;
+    }
+    frameDamage = glm::vec4(glm::min(frameDamage.x, rect.x), glm::min(frameDamage.y, rect.y), glm::max(frameDamage.z, rect.z), glm::max(frameDamage.w, rect.w));
+}
+
+// -----------------------------------------------------------------------------------
+// Call after draining the command queue. How many commands were applied doesn't
+// matter, the damage bits already tell us whether any of them changed something.
+// Textures still streaming in keep us drawing, decoding or queued for upload or half
+// uploaded, the objects pick them up while rendering and report the damage then.
+bool DamageTracker::NeedsFrame(ViewOptionsPtr opt)
+{
+    GLFW_THREAD_CHECK();
+    GIL_FREE_CHECK();
+    glm::vec3 cam = opt->cameraPosition();
+    glm::vec2 viewport(opt->viewportSize().x, opt->viewportSize().y);
+    glm::vec3 ortho(opt->orthoView().x, opt->orthoView().y, opt->orthoView().z);
+    if (cam != cameraPosition || viewport != viewportSize || ortho != orthoView)
+    {
+        cameraPosition = cam;
+        viewportSize = viewport;
+        orthoView = ortho;
+        fullDamage = true;
+    }
+    if (structureVersion != RO_Base::GetStructureVersion())
+    {
+        structureVersion = RO_Base::GetStructureVersion();
+        fullDamage = true;
+    }
+
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    bool streaming = streamer && (streamer->GetPendingDecodes() > 0 || streamer->HasPendingUploads() || streamer->GetUploadedTextures() > 0);
+    // a capture counts submitted frames, it would never end on an idle scene
+    if (FrameProfiler::Recording())
+    {
+        fullDamage = true;
+    }
+    if (!enabled || fullDamage || haveDamage || !damaged.empty() || streaming)
+    {
+        ++activeFrames;
+        return true;
+    }
+    ++idleFrames;
+    return false;
+}
+
+// -----------------------------------------------------------------------------------
+// Call after the transforms and before the clear.
+void DamageTracker::ApplyScissor(const glm::mat4 &projView)
+{
+    GLFW_THREAD_CHECK();
+    for (size_t i = 0; i < damaged.size(); ++i)
+    {
+        boost::shared_ptr<BaseCommandObject> object = damaged[i].lock();
+        glm::vec4 rect;
+        if (object && boost::static_pointer_cast<RO_Base>(object)->GetScreenRect(projView, rect))
+        {
+            AddRect(rect);
+        }
+        else if (object)
+        {
+            fullDamage = true;
+        }
+    }
+    damaged.clear();
+
+    frameFull = fullDamage || !enabled || !scissor;
+    if (frameFull)
+    {
+        return;
+    }
+    glm::vec4 area = frameDamage;
+    bool any = haveDamage;
+    for (int i = 0; i < bufferAge - 1; ++i)
+    {
+        if (historyFull[i])
+        {
+            frameFull = true;
+            return;
+        }
+        if (!historyHas[i])
+        {
+            continue;
+        }
+        area = !any ? history[i] : glm::vec4(glm::min(area.x, history[i].x), glm::min(area.y, history[i].y), glm::max(area.z, history[i].z), glm::max(area.w, history[i].w));
+        any = true;
+    }
+    if (!any)
+    {
+        area = glm::vec4(-2.f);     // nothing to draw, an empty scissor
+    }
+    // NDC to window pixels, a pixel of slack for the rounding
+    int x0 = glm::max((int)((area.x + 1.f) * 0.5f * viewportSize.x) - 1, 0);
+    int y0 = glm::max((int)((area.y + 1.f) * 0.5f * viewportSize.y) - 1, 0);
+    int x1 = glm::min((int)((area.z + 1.f) * 0.5f * viewportSize.x) + 2, (int)viewportSize.x);
+    int y1 = glm::min((int)((area.w + 1.f) * 0.5f * viewportSize.y) + 2, (int)viewportSize.y);
+    if ((float)(x1 - x0) * (y1 - y0) > 0.5f * viewportSize.x * viewportSize.y)
+    {
+        frameFull = true;   // not worth it
+        return;
+    }
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(x0, y0, glm::max(x1 - x0, 0), glm::max(y1 - y0, 0));
+    GL_CHECK_ERROR("GL Error: DamageTracker::ApplyScissor")
+    scissorOn = true;
+    ++partialFrames;
+}
+
+// -----------------------------------------------------------------------------------
+void DamageTracker::EndFrame(const glm::mat4 &projView)
+{
+    GLFW_THREAD_CHECK();
+    if (scissorOn)
+    {
+        glDisable(GL_SCISSOR_TEST);
+        scissorOn = false;
+    }
+    for (int i = MAX_DAMAGE_HISTORY - 1; i > 0; --i)
+    {
+        history[i] = history[i - 1];
+        historyHas[i] = historyHas[i - 1];
+        historyFull[i] = historyFull[i - 1];
+    }
+    history[0] = frameDamage;
+    historyHas[0] = haveDamage;
+    historyFull[0] = frameFull;
+    lastProjView = projView;
+    haveDamage = false;
+    fullDamage = false;
+    frameFull = false;
+}
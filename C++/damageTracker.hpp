@@ -0,0 +1,87 @@
+/* -----------------------------------------------------------------------------------
+   -- damageTracker.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __DAMAGE_TRACKER_HPP__
+#define __DAMAGE_TRACKER_HPP__
+#include <stdio.h>
+#include <vector>
+#include <boost/weak_ptr.hpp>
+#include "ro_base.hpp"
+
+class DamageTracker;
+typedef boost::shared_ptr<DamageTracker> DamageTrackerPtr;
+
+// how many frames of damage are kept for the scissor, see bufferAge
+#define MAX_DAMAGE_HISTORY 4
+
+// -----------------------------------------------------------------------------------
+// Decides whether a frame has to be drawn at all, and optionally how little of it.
+// Render objects report themselves when a command really changed one of their
+// properties (the CommandProperty damage bits), the view and structural changes
+// damage everything. A frame with nothing damaged is skipped even if commands were
+// applied, they didn't change anything on screen.
+//
+// Per frame, on the render thread:
+//      drain the command queue
+//      if (!tracker->NeedsFrame(viewOptions)) skip the frame, don't swap
+//      transform
+//      tracker->ApplyScissor(projView)     before the clear
+//      collect, clear, render, swap
+//      tracker->EndFrame(projView)
+//
+// The scissor covers the damage of the last bufferAge frames, as the back buffer we
+// draw into holds what was drawn that many frames ago (2 for plain double buffering).
+class DamageTracker
+{
+private:
+    static DamageTrackerPtr     instance;       // the singleton instance.
+    std::vector< boost::weak_ptr<BaseCommandObject> > damaged;     // objects changed since the last frame
+    glm::vec4       history[MAX_DAMAGE_HISTORY];    // NDC damage of the last frames
+    bool            historyHas[MAX_DAMAGE_HISTORY]; // that frame had any damage
+    bool            historyFull[MAX_DAMAGE_HISTORY];// that frame was drawn in full
+    glm::vec4       frameDamage;        // NDC damage of this frame
+    bool            frameFull;          // this frame is drawn in full
+    bool            haveDamage;         // frameDamage holds something
+    bool            fullDamage;         // DamageAll was called
+    bool            scissorOn;          // we enabled the scissor test
+    glm::mat4       lastProjView;       // the view the last frame was drawn with
+    glm::vec3       cameraPosition;     // the view options the last frame was drawn with
+    glm::vec2       viewportSize;       // ..
+    glm::vec3       orthoView;          // ..
+    unsigned long   structureVersion;   // RO_Base structure version of the last frame
+    bool            enabled;            // when off every frame is drawn
+    bool            scissor;            // limit drawing to the damage
+    int             bufferAge;          // frames of damage the scissor covers
+    long            idleFrames, activeFrames, partialFrames;
+
+    void AddRect(const glm::vec4 &rect);
+
+public:
+    DamageTracker();
+    ~DamageTracker();
+    static void Boost();
+    static void StartInstance();                    // Static Instance interface
+    static DamageTrackerPtr GetInstance();          // ..
+    static void StopInstance();                     // ..
+
+    static void Damage(RO_Base *object);            // object changed, render thread only
+    void DamageAll()                                { fullDamage = true; }
+
+    bool NeedsFrame(ViewOptionsPtr opt);
+    void ApplyScissor(const glm::mat4 &projView);
+    void EndFrame(const glm::mat4 &projView);
+
+    bool GetEnabled()                               { return enabled; }
+    void SetEnabled(bool e)                         { enabled = e; fullDamage = true; }
+    bool GetScissor()                               { return scissor; }
+    void SetScissor(bool s)                         { scissor = s; fullDamage = true; }
+    int  GetBufferAge()                             { return bufferAge; }
+    void SetBufferAge(int a)                        { bufferAge = a < 1 ? 1 : (a > MAX_DAMAGE_HISTORY ? MAX_DAMAGE_HISTORY : a); }
+    long GetIdleFrames()                            { return idleFrames; }
+    long GetActiveFrames()                          { return activeFrames; }
+    long GetPartialFrames()                         { return partialFrames; }
+    void ResetStats()                               { idleFrames = activeFrames = partialFrames = 0; }
+};
+
+#endif
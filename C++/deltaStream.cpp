@@ -0,0 +1,309 @@
+/* -----------------------------------------------------------------------------------
+   -- deltaStream.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <math.h>
+
+using namespace boost::python;
+using namespace std;
+
+#include "deltaStream.hpp"
+
+DeltaStreamPtr DeltaStream::instance;
+std::atomic<bool> DeltaStream::active(false);
+
+// -----------------------------------------------------------------------------------
+namespace
+{
+    void PutVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back((uint8_t)value);
+    }
+
+    void PutZigzag(std::vector<uint8_t> &out, int64_t value)
+    {
+        PutVarint(out, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+    }
+
+    void PutSigned(std::vector<uint8_t> &out, float value, float scale)
+    {
+        PutZigzag(out, (int64_t)llroundf(value * scale));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+DeltaStream::DeltaStream() :
+    tracked()
+  , pending()
+  , views()
+  , nextView(1)
+  , tick(0)
+  , packets(0)
+  , bytes(0)
+  , records(0)
+{}
+
+// -----------------------------------------------------------------------------------
+DeltaStream::~DeltaStream()
+{}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::Boost()
+{
+    class_ < DeltaStream, DeltaStreamPtr, boost::noncopyable >("DeltaStream", "Packs the changes to tracked render objects for the web clients, one packet per tick per view", no_init)
+        .def("GetInstance", &DeltaStream::GetInstance)
+        .staticmethod("GetInstance")
+        .def("Track", &DeltaStream::Track, "Track(node, itemID) report the changes to node as the item")
+        .def("Untrack", &DeltaStream::Untrack)
+        .def("IsTracked", &DeltaStream::IsTracked, "The node's changes go out in the packets")
+        .def("AddView", &DeltaStream::AddView, "A new subscriber, returns its view id")
+        .def("RemoveView", &DeltaStream::RemoveView)
+        .def("Subscribe", &DeltaStream::Subscribe, "Subscribe(view, itemID)")
+        .def("Unsubscribe", &DeltaStream::Unsubscribe)
+        .def("Flush", &DeltaStream::PyFlush, "The packets for this tick, {view: bytes}. Call once per tick")
+        .add_property("packets", &DeltaStream::GetPackets)
+        .add_property("bytes", &DeltaStream::GetBytes)
+        .add_property("records", &DeltaStream::GetRecords, "Items written, summed over the views")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::StartInstance()
+{
+    if (!instance)
+    {
+        instance = DeltaStreamPtr(new DeltaStream());
+    }
+}
+
+// -----------------------------------------------------------------------------------
+DeltaStreamPtr DeltaStream::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::StopInstance()
+{
+    active = false;
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+// Compared against the stream's own copy, the pending entry is only made once
+// something differs.
+void DeltaStream::Record(RO_Base *node)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::unordered_map<RO_Base *, Tracked>::iterator it = tracked.find(node);
+    if (it == tracked.end())
+    {
+        return;
+    }
+    ItemDelta &last = it->second.last;
+    uint32_t fields = 0;
+    if (node->position() != last.position)          { fields |= DF_POSITION;      last.position = node->position(); }
+    if (node->rotation() != last.rotation)          { fields |= DF_ROTATION;      last.rotation = node->rotation(); }
+    if (node->scaleX() != last.scaleX || node->scaleY() != last.scaleY)
+    {
+        fields |= DF_SCALE;
+        last.scaleX = node->scaleX();
+        last.scaleY = node->scaleY();
+    }
+    if (node->alpha() != last.alpha)                { fields |= DF_ALPHA;         last.alpha = node->alpha(); }
+    if (node->enabled() != last.enabled)            { fields |= DF_ENABLED;       last.enabled = node->enabled(); }
+    if (node->visibleState() != last.visibleState)  { fields |= DF_VISIBLESTATE;  last.visibleState = node->visibleState(); }
+    if (!fields)
+    {
+        return;
+    }
+    ItemDelta &delta = pending[it->second.itemID];
+    uint32_t merged = delta.fields | fields;
+    delta = last;
+    delta.fields = merged;
+}
+
+// -----------------------------------------------------------------------------------
+// The copy starts from the python values, the C side may still be catching up and is
+// the render thread's to read. The client has these from the token's JSON already.
+void DeltaStream::Track(RO_BasePtr node, long itemID)
+{
+    Tracked entry;
+    entry.itemID = itemID;
+    entry.node = node;
+    entry.last.position = node->position.pyGet();
+    entry.last.rotation = node->rotation.pyGet();
+    entry.last.scaleX = node->scaleX.pyGet();
+    entry.last.scaleY = node->scaleY.pyGet();
+    entry.last.alpha = node->alpha.pyGet();
+    entry.last.enabled = node->enabled.pyGet();
+    entry.last.visibleState = node->visibleState.pyGet();
+    std::lock_guard<std::mutex> guard(lock);
+    tracked[node.get()] = entry;
+    active = true;
+}
+
+// -----------------------------------------------------------------------------------
+// The reference is dropped here on the python thread, not under the lock.
+void DeltaStream::Untrack(RO_BasePtr node)
+{
+    Tracked entry;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::unordered_map<RO_Base *, Tracked>::iterator it = tracked.find(node.get());
+        if (it == tracked.end())
+        {
+            return;
+        }
+        entry = it->second;
+        tracked.erase(it);
+        active = !tracked.empty();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+bool DeltaStream::IsTracked(RO_BasePtr node)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return tracked.count(node.get()) != 0;
+}
+
+// -----------------------------------------------------------------------------------
+int DeltaStream::AddView()
+{
+    views[nextView];
+    return nextView++;
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::RemoveView(int view)
+{
+    views.erase(view);
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::Subscribe(int view, long itemID)
+{
+    std::map<int, std::set<long> >::iterator it = views.find(view);
+    if (it == views.end())
+    {
+        printf("ERROR: DeltaStream::Subscribe to view %d that doesn't exist\n", view);
+        return;
+    }
+    it->second.insert(itemID);
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::Unsubscribe(int view, long itemID)
+{
+    std::map<int, std::set<long> >::iterator it = views.find(view);
+    if (it != views.end())
+    {
+        it->second.erase(itemID);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void DeltaStream::Encode(std::vector<uint8_t> &out, const std::set<long> &items, const std::map<long, ItemDelta> &changes)
+{
+    std::vector<std::map<long, ItemDelta>::const_iterator> sent;
+    for (std::map<long, ItemDelta>::const_iterator it = changes.begin(); it != changes.end(); ++it)
+    {
+        if (it->second.fields && items.count(it->first))
+        {
+            sent.push_back(it);
+        }
+    }
+    if (sent.empty())
+    {
+        return;
+    }
+    out.push_back(DELTA_STREAM_VERSION);
+    PutVarint(out, tick);
+    PutVarint(out, sent.size());
+    long previous = 0;
+    for (size_t i = 0; i < sent.size(); ++i)
+    {
+        const ItemDelta &delta = sent[i]->second;
+        PutZigzag(out, sent[i]->first - previous);
+        previous = sent[i]->first;
+        PutVarint(out, delta.fields);
+        if (delta.fields & DF_POSITION)
+        {
+            PutSigned(out, delta.position.x, DELTA_POSITION_SCALE);
+            PutSigned(out, delta.position.y, DELTA_POSITION_SCALE);
+            PutSigned(out, delta.position.z, DELTA_POSITION_SCALE);
+        }
+        if (delta.fields & DF_ROTATION)
+        {
+            PutSigned(out, delta.rotation, DELTA_ROTATION_SCALE);
+        }
+        if (delta.fields & DF_SCALE)
+        {
+            PutSigned(out, delta.scaleX, DELTA_SCALE_SCALE);
+            PutSigned(out, delta.scaleY, DELTA_SCALE_SCALE);
+        }
+        if (delta.fields & DF_ALPHA)
+        {
+            out.push_back((uint8_t)lroundf(std::min(std::max(delta.alpha, 0.f), 1.f) * 255.f));
+        }
+        if (delta.fields & DF_ENABLED)
+        {
+            out.push_back(delta.enabled ? 1 : 0);
+        }
+        if (delta.fields & DF_VISIBLESTATE)
+        {
+            PutVarint(out, delta.visibleState.size());
+            out.insert(out.end(), delta.visibleState.begin(), delta.visibleState.end());
+        }
+    }
+    records += sent.size();
+}
+
+// -----------------------------------------------------------------------------------
+// Item ids are sorted, so each is written as the distance from the one before. Zigzag,
+// an id can be negative.
+void DeltaStream::Flush(std::map<int, std::vector<uint8_t> > &out)
+{
+    std::map<long, ItemDelta> changes;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        changes.swap(pending);
+    }
+    ++tick;
+    out.clear();
+    if (changes.empty())
+    {
+        return;
+    }
+    for (std::map<int, std::set<long> >::iterator it = views.begin(); it != views.end(); ++it)
+    {
+        std::vector<uint8_t> packet;
+        Encode(packet, it->second, changes);
+        if (!packet.empty())
+        {
+            ++packets;
+            bytes += packet.size();
+            out[it->first].swap(packet);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+dict DeltaStream::PyFlush()
+{
+    std::map<int, std::vector<uint8_t> > packets;
+    Flush(packets);
+    dict result;
+    for (std::map<int, std::vector<uint8_t> >::iterator it = packets.begin(); it != packets.end(); ++it)
+    {
+        result[it->first] = object(handle<>(PyBytes_FromStringAndSize((const char *)it->second.data(), it->second.size())));
+    }
+    return result;
+}
@@ -0,0 +1,128 @@
+/* -----------------------------------------------------------------------------------
+   -- deltaStream.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __DELTA_STREAM_HPP__
+#define __DELTA_STREAM_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ro_base.hpp"
+
+class DeltaStream;
+typedef boost::shared_ptr<DeltaStream> DeltaStreamPtr;
+
+// -----------------------------------------------------------------------------------
+// The packet format, TokenManager.js decodes it. Unsigned values are LEB128 varints,
+// signed ones zigzag varints, the floats are the value times the scale, rounded.
+//
+//      u8      DELTA_STREAM_VERSION
+//      varint  tick
+//      varint  number of items
+//      per item, by ascending item id:
+//          zigzag  item id - the previous item id (the first from 0)
+//          varint  DeltaField bits, then the values of those bits in bit order
+//              DF_POSITION     3 zigzag    x y z * DELTA_POSITION_SCALE
+//              DF_ROTATION     zigzag      degrees * DELTA_ROTATION_SCALE
+//              DF_SCALE        2 zigzag    scaleX scaleY * DELTA_SCALE_SCALE
+//              DF_ALPHA        u8          alpha * 255
+//              DF_ENABLED      u8          0 or 1
+//              DF_VISIBLESTATE varint length, then the utf8 bytes
+#define DELTA_STREAM_VERSION    2
+#define DELTA_POSITION_SCALE    8.f         // 1/8 of a unit
+#define DELTA_ROTATION_SCALE    10.f        // 1/10 of a degree
+#define DELTA_SCALE_SCALE       1000.f
+
+enum DeltaField
+{
+    DF_POSITION     = 1 << 0,
+    DF_ROTATION     = 1 << 1,
+    DF_SCALE        = 1 << 2,
+    DF_ALPHA        = 1 << 3,
+    DF_ENABLED      = 1 << 4,
+    DF_VISIBLESTATE = 1 << 5,
+};
+
+// -----------------------------------------------------------------------------------
+// Collects the changes the render thread applies to tracked render objects and packs
+// them for the web clients, one packet per tick for each view instead of a JSON
+// message per property. Every applied command and NodeBatch update ends in
+// RO_Base::CommandApplied, which hands the object to Record. The stream keeps its own
+// copy of what it last recorded for each item, starting from the python values at
+// Track, and a property is sent when the C side value differs from it; the change
+// bits aren't used, so it doesn't matter who else reads or clears them. Changes to an
+// item within one tick are merged, the last value is sent. A view is one subscriber,
+// with the item ids it sees.
+//
+//      render thread   CommandApplied -> Record
+//      python thread   Track(node, itemID), AddView, Subscribe(view, itemID)
+//                      Flush once per tick -> {view: packet}
+//                      Untrack(node) once no view subscribes to the item
+class DeltaStream
+{
+private:
+    struct ItemDelta
+    {
+        uint32_t        fields;             // DeltaField bits
+        glm::vec3       position;
+        float           rotation;
+        float           scaleX;
+        float           scaleY;
+        float           alpha;
+        int             enabled;
+        std::string     visibleState;
+        ItemDelta() : fields(0), rotation(0.f), scaleX(1.f), scaleY(1.f), alpha(1.f), enabled(1) {}
+    };
+    struct Tracked
+    {
+        long            itemID;
+        RO_BasePtr      node;               // kept so the key can't be reused
+        ItemDelta       last;               // the values last recorded, render thread after Track
+    };
+
+    static DeltaStreamPtr       instance;
+    static std::atomic<bool>    active;     // anything tracked, Record is skipped otherwise
+    std::mutex                  lock;       // tracked and pending, Record runs on the render thread
+    std::unordered_map<RO_Base *, Tracked> tracked;
+    std::map<long, ItemDelta>   pending;    // by item id, sorted for the id deltas
+    std::map<int, std::set<long> > views;   // python thread only
+    int                         nextView;
+    unsigned long               tick;
+    long                        packets;    // stats, all time
+    long                        bytes;      // ..
+    long                        records;    // .. items written, summed over the views
+
+    void Encode(std::vector<uint8_t> &out, const std::set<long> &items, const std::map<long, ItemDelta> &changes);
+
+public:
+    DeltaStream();
+    ~DeltaStream();
+    static void Boost();
+    static void StartInstance();
+    static DeltaStreamPtr GetInstance();
+    static void StopInstance();
+    static bool Active()                            { return active; }
+
+    void Record(RO_Base *node);                     // render thread, from CommandApplied
+    void Track(RO_BasePtr node, long itemID);       // python thread
+    void Untrack(RO_BasePtr node);                  // ..
+    bool IsTracked(RO_BasePtr node);                // ..
+    int  AddView();                                 // .. a subscriber, returns its view id
+    void RemoveView(int view);
+    void Subscribe(int view, long itemID);
+    void Unsubscribe(int view, long itemID);
+    void Flush(std::map<int, std::vector<uint8_t> > &out);    // .. a packet for each view with changes
+    dict PyFlush();                                 // .. as {view: bytes}
+
+    long GetPackets()                               { return packets; }
+    long GetBytes()                                 { return bytes; }
+    long GetRecords()                               { return records; }
+};
+
+#endif
@@ -0,0 +1,234 @@
+/* -----------------------------------------------------------------------------------
+   -- framePipeline.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <boost/bind.hpp>
+#include <chrono>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "framePipeline.hpp"
+#include "spriteBatcher.hpp"
+#include "utils.hpp"
+#include "gilGuard.hpp"
+#include "frameProfiler.hpp"
+#include "renderStats.hpp"
+
+// -----------------------------------------------------------------------------------
+FramePipeline::FramePipeline(int numThreads) :
+    pool(new WorkerPool(numThreads))
+  , jobs()
+  , current(0)
+  , pending(false)
+  , overlap(true)
+  , collected(0)
+  , culled(0)
+  , packets(0)
+  , fallbacks(0)
+  , overlapped(0)
+  , stale(0)
+  , waitMs(0.f)
+{
+    frames[0].ready = frames[1].ready = false;
+    frames[0].version = frames[1].version = 0;
+}
+
+// -----------------------------------------------------------------------------------
+FramePipeline::~FramePipeline()
+{
+    Finish();
+}
+
+// -----------------------------------------------------------------------------------
+void FramePipeline::Boost()
+{
+    class_ < FramePipeline, FramePipelinePtr, boost::noncopyable >("FramePipeline", "Draw packets built on worker threads, submitted on the render thread", no_init)
+        .add_property("overlap", &FramePipeline::GetOverlap, &FramePipeline::SetOverlap, "Draw the previous frame while the workers prepare the next")
+        .add_property("collected", &FramePipeline::GetCollected, "Objects collected for the last frame drawn")
+        .add_property("culled", &FramePipeline::GetCulled, "Objects outside the view in the last frame drawn")
+        .add_property("packets", &FramePipeline::GetPackets, "Packets submitted in the last frame drawn")
+        .add_property("fallbacks", &FramePipeline::GetFallbacks, "Objects drawn through RenderObject in the last frame drawn")
+        .add_property("overlapped", &FramePipeline::GetOverlapped, "Frames drawn while the next was being prepared")
+        .add_property("stale", &FramePipeline::GetStale, "Prepared frames thrown away because the scene structure changed")
+        .add_property("waitMs", &FramePipeline::GetWaitMs, "Time the last Submit waited on the workers")
+        .add_property("numThreads", &FramePipeline::GetNumThreads)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+// Start building a frame. Must not be called while objects are being changed, the
+// workers read the C side values without locking.
+void FramePipeline::Kick(const RO_BaseVector &roots, const stringList &renderSet, const RenderSettings &settings)
+{
+    GLFW_THREAD_CHECK();
+    GIL_FREE_CHECK();
+    FRAME_ZONE("Kick")
+    Finish();
+    current = 1 - current;
+    FrameData &frame = frames[current];
+    frame.packets.resize(roots.size());
+    frame.collected.assign(roots.size(), 0);
+    frame.culled.assign(roots.size(), 0);
+    frame.fallbacks.assign(roots.size(), 0);
+    frame.parentWorld.resize(roots.size());
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        frame.parentWorld[i] = roots[i]->TransformAncestors();
+    }
+    frame.settings = settings;
+    frame.settings.glState = NULL;      // the workers never touch GL
+    frame.renderSet = renderSet;
+    frame.version = RO_Base::GetStructureVersion();
+    frame.ready = false;
+    lists.resize(roots.size());
+    pending = true;
+    for (size_t i = 0; i < roots.size(); ++i)
+    {
+        pool->Post(boost::bind(&FramePipeline::PrepareRoot, this, current, (int)i, roots[i]), jobs);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Worker thread. Anything whose screen rect is entirely off the view is culled,
+// objects that can't tell where they land are kept. The collect is skipped while
+// the structure version holds, the root's RenderListCache has the list already.
+void FramePipeline::PrepareRoot(int frameIndex, int index, RO_BasePtr root)
+{
+    FRAME_ZONE("Prepare")
+    FrameData &frame = frames[frameIndex];
+    DrawPacketVector &out = frame.packets[index];
+    out.clear();
+
+    RenderObjectVectorPtr renderables;
+    {
+        FRAME_ZONE("Transform")
+        RENDER_PHASE(RS_PHASE_TRANSFORM)
+        root->Transform(frame.parentWorld[index]);
+    }
+    {
+        FRAME_ZONE("Collect")
+        RENDER_PHASE(RS_PHASE_COLLECT)
+        renderables = lists[index].Collect(root, frame.renderSet);
+    }
+
+    FRAME_ZONE("Build")
+    RENDER_PHASE(RS_PHASE_BUILD)
+    long culledCount = 0;
+    int fallbackCount = 0;
+    for (RenderObjectVector::iterator it = renderables->begin(); it != renderables->end(); ++it)
+    {
+        glm::vec4 rect;
+        if ((*it)->GetScreenRect(frame.settings.ProjViewMat, rect) &&
+            (rect.z < -1.f || rect.x > 1.f || rect.w < -1.f || rect.y > 1.f))
+        {
+            ++culledCount;
+            continue;
+        }
+        out.push_back(DrawPacket());
+        DrawPacket &packet = out.back();
+        packet.object = *it;
+        packet.texture = 0;
+        packet.built = (*it)->BuildPacket(packet, &frame.settings);
+        if (!packet.built)
+        {
+            ++fallbackCount;
+        }
+    }
+    frame.collected[index] = renderables->size();
+    frame.culled[index] = culledCount;
+    frame.fallbacks[index] = fallbackCount;
+    RENDER_STAT_ADD(RS_CULLED, culledCount)
+}
+
+// -----------------------------------------------------------------------------------
+void FramePipeline::Finish()
+{
+    if (pending)
+    {
+        FRAME_ZONE("Wait")
+        RENDER_PHASE(RS_PHASE_WAIT)
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        pool->Wait(jobs);
+        waitMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        frames[current].ready = true;
+        pending = false;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void FramePipeline::Draw(FrameData &frame, SpriteBatcher *batcher, RenderSettingsPtr settings)
+{
+    FRAME_ZONE("Render")
+    RENDER_PHASE(RS_PHASE_RENDER)
+    collected = culled = packets = fallbacks = 0;
+    for (size_t i = 0; i < frame.packets.size(); ++i)
+    {
+        collected += frame.collected[i];
+        culled += frame.culled[i];
+        fallbacks += frame.fallbacks[i];
+        packets += frame.packets[i].size();
+    }
+    batcher->RenderPackets(frame.packets, settings);
+}
+
+// -----------------------------------------------------------------------------------
+// Draw the previous frame while the workers are still on this one when we can,
+// otherwise wait and draw this one. After a frame drawn without overlapping the next
+// Submit draws it again, that is the one frame the pipeline needs to fill up.
+// Submit is the frame for the settings' GLStateCache, and ends it for the
+// FrameProfiler and the RenderStats.
+void FramePipeline::Submit(SpriteBatcher *batcher, RenderSettingsPtr settings)
+{
+    GLFW_THREAD_CHECK();
+    GIL_FREE_CHECK();
+    if (settings->glState != NULL)
+    {
+        settings->glState->BeginFrame();
+    }
+    waitMs = 0.f;
+    FrameData &previous = frames[1 - current];
+    bool usable = previous.ready && previous.version == RO_Base::GetStructureVersion();
+    if (previous.ready && !usable)
+    {
+        previous.ready = false;
+        ++stale;
+    }
+    if (overlap && usable && batcher->CanBatch(settings))
+    {
+        int previousFallbacks = 0;
+        for (size_t i = 0; i < previous.fallbacks.size(); ++i)
+        {
+            previousFallbacks += previous.fallbacks[i];
+        }
+        if (previousFallbacks == 0)
+        {
+            Draw(previous, batcher, settings);
+            ++overlapped;
+            Finish();
+            EndFrame(settings);
+            return;
+        }
+    }
+    Finish();
+    Draw(frames[current], batcher, settings);
+    EndFrame(settings);
+}
+
+// -----------------------------------------------------------------------------------
+void FramePipeline::EndFrame(RenderSettingsPtr settings)
+{
+    if (settings->glState != NULL)
+    {
+        settings->glState->EndFrame();
+    }
+    if (FrameProfiler::Recording() && FrameProfiler::GetInstance())
+    {
+        FrameProfiler::GetInstance()->EndFrame();
+    }
+    RenderStats::EndFrame();
+}
@@ -0,0 +1,91 @@
+/* -----------------------------------------------------------------------------------
+   -- framePipeline.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __FRAME_PIPELINE_HPP__
+#define __FRAME_PIPELINE_HPP__
+#include <stdio.h>
+#include <vector>
+#include "ro_base.hpp"
+#include "workerPool.hpp"
+#include "renderList.hpp"
+
+class SpriteBatcher;
+class FramePipeline;
+typedef boost::shared_ptr<FramePipeline> FramePipelinePtr;
+
+// -----------------------------------------------------------------------------------
+// Builds the draw packets for a frame on the worker threads, the render thread only
+// merges and submits them. Each root handed to Kick is one job: the worker runs the
+// transforms, collects, culls against the view and builds the packets of that
+// subtree, so the scene should pass its top level layers rather than one root.
+// The packets are merged in root order, which keeps the painter order.
+//
+// Per frame, on the render thread:
+//      drain the command queue         (the workers are idle, objects can change,
+//                                       time it with RENDER_PHASE(RS_PHASE_COMMANDS))
+//      pipeline->Kick(roots, renderSet, settings)
+//      pipeline->Submit(batcher, &settings)
+//      overlay->Draw()                 (the RenderStatsOverlay, when wanted)
+//
+// When overlapping, Submit draws the frame Kicked last time while the workers
+// prepare this one, so the picture is one frame behind the commands. A prepared
+// frame is thrown away if the structure changed since (objects may be gone), and
+// frames holding objects that can't build packets, or drawn while the batcher can't
+// batch, are prepared and drawn in the same Submit, as those objects draw from their
+// own state. A SceneLoader made from the pipeline shares its workers, a Submit only
+// waits on the frame's jobs but they queue behind a load's parse.
+class FramePipeline
+{
+private:
+    struct FrameData
+    {
+        std::vector<DrawPacketVector>   packets;    // one list per root, merged in order
+        std::vector<long>               collected;  // per root stats, written by the workers
+        std::vector<long>               culled;     // ..
+        std::vector<int>                fallbacks;  // ..
+        std::vector<glm::mat4>          parentWorld;// each root's parent's world matrix, taken at Kick
+        RenderSettings                  settings;   // the settings the frame is built with
+        stringList                      renderSet;  // ..
+        unsigned long                   version;    // RO_Base structure version at Kick
+        bool                            ready;      // prepared, can be drawn while the structure version holds
+    };
+
+    WorkerPoolPtr   pool;               // the workers building the packets, shared with a SceneLoader
+    WorkerGroup     jobs;               // the frame's jobs in it
+    std::vector<RenderListCache> lists; // a root's collected objects, kept while the structure holds. Its worker's only
+    FrameData       frames[2];          // the frame being built and the one before it
+    int             current;            // the frame Kick last started
+    bool            pending;            // the workers are on frames[current]
+    bool            overlap;            // allow drawing the previous frame while preparing
+    long            collected, culled, packets, fallbacks;     // stats for the last submitted frame
+    long            overlapped, stale;  // frames drawn while preparing, prepared frames thrown away
+    float           waitMs;             // time Submit waited on the workers last frame
+
+    void PrepareRoot(int frame, int index, RO_BasePtr root);   // worker thread
+    void Finish();                      // wait for the workers
+    void Draw(FrameData &frame, SpriteBatcher *batcher, RenderSettingsPtr settings);
+    void EndFrame(RenderSettingsPtr settings);  // for the GLStateCache, FrameProfiler and RenderStats
+
+public:
+    FramePipeline(int numThreads = 0);
+    ~FramePipeline();
+    static void Boost();
+
+    void Kick(const RO_BaseVector &roots, const stringList &renderSet, const RenderSettings &settings);
+    void Submit(SpriteBatcher *batcher, RenderSettingsPtr settings);
+
+    bool GetOverlap()                   { return overlap; }
+    void SetOverlap(bool o)             { overlap = o; }
+    long GetCollected()                 { return collected; }
+    long GetCulled()                    { return culled; }
+    long GetPackets()                   { return packets; }
+    long GetFallbacks()                 { return fallbacks; }
+    long GetOverlapped()                { return overlapped; }
+    long GetStale()                     { return stale; }
+    float GetWaitMs()                   { return waitMs; }
+    int  GetNumThreads()                { return pool->GetNumThreads(); }
+    WorkerPoolPtr GetPool()             { return pool; }
+};
+
+#endif
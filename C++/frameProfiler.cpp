@@ -0,0 +1,238 @@
+/* -----------------------------------------------------------------------------------
+   -- frameProfiler.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <algorithm>
+#include <sstream>
+
+using namespace boost::python;
+using namespace std;
+
+#include "frameProfiler.hpp"
+
+FrameProfilerPtr FrameProfiler::instance;
+std::atomic<bool> FrameProfiler::recording(false);
+std::mutex FrameProfiler::bufferLock;
+std::vector< std::unique_ptr<FrameProfileBuffer> > FrameProfiler::buffers;
+
+// -----------------------------------------------------------------------------------
+FrameProfiler::FrameProfiler() :
+    framesLeft(0)
+  , framesCaptured(0)
+  , ready(false)
+  , startTicks(0)
+  , endTicks(0)
+  , frameStart(0)
+  , memory()
+  , captured()
+  , dropped(0)
+{}
+
+// -----------------------------------------------------------------------------------
+FrameProfiler::~FrameProfiler()
+{
+    recording = false;
+}
+
+// -----------------------------------------------------------------------------------
+void FrameProfiler::Boost()
+{
+    class_ < FrameProfiler, FrameProfilerPtr, boost::noncopyable >("FrameProfiler", "Times the phases of a few frames, saved as a Chrome trace", no_init)
+        .def("GetInstance", &FrameProfiler::GetInstance)
+        .staticmethod("GetInstance")
+        .def("Capture", &FrameProfiler::Capture, "Capture(frames) record the next frames")
+        .def("GetTrace", &FrameProfiler::GetTrace, "The last capture as Chrome trace_event JSON")
+        .def("Save", &FrameProfiler::Save, "Save(path) write the last capture, for chrome://tracing or Perfetto")
+        .add_property("ready", &FrameProfiler::GetReady, "The last capture is complete")
+        .add_property("capturing", &FrameProfiler::GetCapturing)
+        .add_property("framesCaptured", &FrameProfiler::GetFramesCaptured)
+        .add_property("events", &FrameProfiler::GetEvents, "Zones in the last capture")
+        .add_property("dropped", &FrameProfiler::GetDropped, "Zones lost to the per thread rings filling, capture fewer frames")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void FrameProfiler::StartInstance()
+{
+    if (!instance)
+    {
+        instance = FrameProfilerPtr(new FrameProfiler());
+    }
+}
+
+// -----------------------------------------------------------------------------------
+FrameProfilerPtr FrameProfiler::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void FrameProfiler::StopInstance()
+{
+    recording = false;
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+// Only the first zone a thread records while capturing takes the lock.
+FrameProfileBuffer *FrameProfiler::ThreadBuffer()
+{
+    static thread_local FrameProfileBuffer *buffer = NULL;
+    if (!buffer)
+    {
+        std::lock_guard<std::mutex> guard(bufferLock);
+        buffers.push_back(std::unique_ptr<FrameProfileBuffer>(new FrameProfileBuffer(buffers.size())));
+        buffer = buffers.back().get();
+    }
+    return buffer;
+}
+
+// -----------------------------------------------------------------------------------
+void FrameProfiler::Capture(int frames)
+{
+    if (frames < 1)
+    {
+        return;
+    }
+    if (recording)
+    {
+        printf("ERROR: FrameProfiler::Capture while a capture is running\n");
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(bufferLock);
+        for (size_t i = 0; i < buffers.size(); ++i)
+        {
+            buffers[i]->captureHead = buffers[i]->head.load(std::memory_order_acquire);
+        }
+    }
+    ready = false;
+    framesCaptured = 0;
+    memory.clear();
+    startTime = std::chrono::steady_clock::now();
+    startTicks = frameStart = FrameProfileTicks();
+    framesLeft = frames;
+    recording = true;
+}
+
+// -----------------------------------------------------------------------------------
+// The frame is a zone too, from the end of the one before.
+void FrameProfiler::EndFrame()
+{
+    if (!recording)
+    {
+        return;
+    }
+    uint64_t now = FrameProfileTicks();
+    ThreadBuffer()->Push("Frame", frameStart, now);
+    frameStart = now;
+    if (MemoryAccounting::Enabled())
+    {
+        MemorySample sample;
+        sample.ticks = now;
+        for (int i = 0; i < MEM_TAG_COUNT; ++i)
+        {
+            sample.live[i] = MemoryAccounting::GetLive(i);
+        }
+        memory.push_back(sample);
+    }
+    ++framesCaptured;
+    if (--framesLeft <= 0)
+    {
+        Finish();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread, at the end of a Submit, the pipeline's workers are idle. A zone still
+// open on another thread is left out.
+void FrameProfiler::Finish()
+{
+    recording = false;
+    endTicks = FrameProfileTicks();
+    endTime = std::chrono::steady_clock::now();
+    captured.clear();
+    dropped = 0;
+    std::lock_guard<std::mutex> guard(bufferLock);
+    for (size_t i = 0; i < buffers.size(); ++i)
+    {
+        FrameProfileBuffer &buffer = *buffers[i];
+        uint64_t head = buffer.head.load(std::memory_order_acquire);
+        uint64_t first = std::max(buffer.captureHead, head > FRAME_PROFILE_RING_SIZE ? head - FRAME_PROFILE_RING_SIZE : 0);
+        dropped += first - buffer.captureHead;
+        for (uint64_t e = first; e < head; ++e)
+        {
+            const FrameProfileEvent &event = buffer.events[e % FRAME_PROFILE_RING_SIZE];
+            if (event.start >= startTicks && event.end <= endTicks)
+            {
+                captured.push_back(std::make_pair(buffer.tid, event));
+            }
+        }
+    }
+    ready = true;
+}
+
+// -----------------------------------------------------------------------------------
+// Complete ("X") events in microseconds from the start of the capture, the ticks are
+// converted with the rate measured over the capture.
+std::string FrameProfiler::GetTrace()
+{
+    if (!ready)
+    {
+        return "";
+    }
+    double us = std::chrono::duration<double, std::micro>(endTime - startTime).count();
+    double ticksPerUs = us > 0 ? (endTicks - startTicks) / us : 1.0;
+    std::ostringstream out;
+    out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    int threads = 0;
+    for (size_t i = 0; i < captured.size(); ++i)
+    {
+        threads = std::max(threads, captured[i].first + 1);
+    }
+    for (int t = 0; t < threads; ++t)
+    {
+        out << (t ? "," : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t
+            << ",\"args\":{\"name\":\"Thread " << t << "\"}}";
+    }
+    for (size_t i = 0; i < captured.size(); ++i)
+    {
+        const FrameProfileEvent &event = captured[i].second;
+        out << (threads || i ? "," : "") << "{\"name\":\"" << event.name << "\",\"cat\":\"frame\",\"ph\":\"X\",\"pid\":1,\"tid\":" << captured[i].first
+            << ",\"ts\":" << (event.start - startTicks) / ticksPerUs << ",\"dur\":" << (event.end - event.start) / ticksPerUs << "}";
+    }
+    for (size_t i = 0; i < memory.size(); ++i)
+    {
+        out << (threads || captured.size() || i ? "," : "") << "{\"name\":\"Memory\",\"ph\":\"C\",\"pid\":1,\"ts\":"
+            << (memory[i].ticks - startTicks) / ticksPerUs << ",\"args\":{";
+        for (int t = 0; t < MEM_TAG_COUNT; ++t)
+        {
+            out << (t ? "," : "") << "\"" << MemoryAccounting::TagName(t) << "\":" << memory[i].live[t];
+        }
+        out << "}}";
+    }
+    out << "]}";
+    return out.str();
+}
+
+// -----------------------------------------------------------------------------------
+bool FrameProfiler::Save(const std::string &path)
+{
+    if (!ready)
+    {
+        printf("ERROR: FrameProfiler::Save no capture to save\n");
+        return false;
+    }
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+    {
+        printf("ERROR: FrameProfiler::Save can't open %s\n", path.c_str());
+        return false;
+    }
+    std::string trace = GetTrace();
+    bool ok = fwrite(trace.data(), 1, trace.size(), file) == trace.size();
+    fclose(file);
+    return ok;
+}
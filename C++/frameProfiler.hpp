@@ -0,0 +1,168 @@
+/* -----------------------------------------------------------------------------------
+   -- frameProfiler.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __FRAME_PROFILER_HPP__
+#define __FRAME_PROFILER_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "memoryAccounting.hpp"
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+class FrameProfiler;
+typedef boost::shared_ptr<FrameProfiler> FrameProfilerPtr;
+
+// events each thread keeps, the oldest are overwritten
+#define FRAME_PROFILE_RING_SIZE 16384
+
+// -----------------------------------------------------------------------------------
+// The cycle counter where there is one, it is converted to time when the trace is
+// exported.
+inline uint64_t FrameProfileTicks()
+{
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+struct FrameProfileEvent
+{
+    const char     *name;               // a string literal
+    uint64_t        start;              // FrameProfileTicks
+    uint64_t        end;                // ..
+};
+
+// -----------------------------------------------------------------------------------
+// One thread's events. Only the thread writes it, the exporter reads up to head.
+struct FrameProfileBuffer
+{
+    FrameProfileEvent       events[FRAME_PROFILE_RING_SIZE];
+    std::atomic<uint64_t>   head;       // events written, all time
+    uint64_t                captureHead;// .. when the capture started
+    int                     tid;        // the order the threads first recorded in
+    FrameProfileBuffer(int _tid) : head(0), captureHead(0), tid(_tid) {}
+
+    void Push(const char *name, uint64_t start, uint64_t end)
+    {
+        uint64_t at = head.load(std::memory_order_relaxed);
+        FrameProfileEvent &event = events[at % FRAME_PROFILE_RING_SIZE];
+        event.name = name;
+        event.start = start;
+        event.end = end;
+        head.store(at + 1, std::memory_order_release);
+    }
+};
+
+// -----------------------------------------------------------------------------------
+// Times the phases of a frame, on whatever thread they run, for a few frames at a time.
+// A FRAME_ZONE marks the rest of its scope, zones nest and the trace viewer shows them
+// as a tree per thread. While nothing is being captured a zone costs
+// one relaxed load, when capturing it reads the cycle counter on the way in and out
+// and writes an event into the thread's ring, no locks. Capture(n) arms it from python,
+// EndFrame counts the frames on the render thread, and when the n-th ends the events
+// are copied out and can be saved in Chrome's trace_event format, for chrome://tracing
+// or Perfetto. The DamageTracker draws every frame while a capture runs, so an idle
+// scene still ends it. With the MemoryAccounting on, each frame also records the live bytes of
+// every tag, a counter track in the trace.
+//
+// Per frame, on the render thread:
+//      { FRAME_ZONE("Commands") drain the command queue }      the caller's, as renderBench does
+//      pipeline->Kick(...)             Transform and Collect zones on the workers
+//      pipeline->Submit(...)           Render, ends the frame
+class FrameProfiler
+{
+private:
+    static FrameProfilerPtr             instance;
+    static std::atomic<bool>            recording;  // zones write events
+    static std::mutex                   bufferLock; // buffers, a thread's first zone adds it
+    static std::vector< std::unique_ptr<FrameProfileBuffer> > buffers;     // never freed, threads may outlive a capture
+
+    std::atomic<int>    framesLeft;     // frames still to capture
+    int                 framesCaptured; // in the last capture
+    std::atomic<bool>   ready;          // the last capture is complete
+    uint64_t            startTicks;     // the capture, for converting ticks to time
+    uint64_t            endTicks;       // ..
+    std::chrono::steady_clock::time_point startTime;    // ..
+    std::chrono::steady_clock::time_point endTime;      // ..
+    uint64_t            frameStart;     // ticks, the frame being captured began
+    struct MemorySample
+    {
+        uint64_t        ticks;
+        long long       live[MEM_TAG_COUNT];
+    };
+    std::vector<MemorySample> memory;   // per frame, when the MemoryAccounting is on
+    std::vector< std::pair<int, FrameProfileEvent> > captured; // tid and event, for the export
+    long                dropped;        // events overwritten before the capture ended
+
+    void Finish();
+
+public:
+    FrameProfiler();
+    ~FrameProfiler();
+    static void Boost();
+    static void StartInstance();
+    static FrameProfilerPtr GetInstance();
+    static void StopInstance();
+
+    static bool Recording()                         { return recording.load(std::memory_order_relaxed); }
+    static FrameProfileBuffer *ThreadBuffer();      // the calling thread's ring
+
+    void Capture(int frames);                       // python thread, the next frames
+    void EndFrame();                                // render thread, after the frame is submitted
+    std::string GetTrace();                         // the last capture as trace_event JSON
+    bool Save(const std::string &path);             // .. to a file
+
+    bool GetReady()                                 { return ready; }
+    bool GetCapturing()                             { return framesLeft > 0; }
+    int  GetFramesCaptured()                        { return framesCaptured; }
+    long GetEvents()                                { return captured.size(); }
+    long GetDropped()                               { return dropped; }
+};
+
+// -----------------------------------------------------------------------------------
+class FrameProfileZone
+{
+private:
+    FrameProfileBuffer *buffer;
+    const char         *name;
+    uint64_t            start;
+
+public:
+    FrameProfileZone(const char *_name) :
+        buffer(NULL)
+      , name(_name)
+    {
+        if (FrameProfiler::Recording())
+        {
+            buffer = FrameProfiler::ThreadBuffer();
+            start = FrameProfileTicks();
+        }
+    }
+    ~FrameProfileZone()
+    {
+        if (buffer)
+        {
+            buffer->Push(name, start, FrameProfileTicks());
+        }
+    }
+};
+
+#define FRAME_ZONE_CAT2(a, b) a##b
+#define FRAME_ZONE_CAT(a, b) FRAME_ZONE_CAT2(a, b)
+#define FRAME_ZONE(name) FrameProfileZone FRAME_ZONE_CAT(frameZone, __LINE__)(name);
+
+#endif
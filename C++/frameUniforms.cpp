@@ -0,0 +1,132 @@
+/* -----------------------------------------------------------------------------------
+   -- frameUniforms.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <algorithm>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+
+#include "frameUniforms.hpp"
+#include "utils.hpp"
+
+const char * FrameUniforms::BLOCK_GLSL =
+    "layout(std140) uniform ViewBlock\n"
+    "{\n"
+    "    mat4 ProjView;\n"
+    "    mat4 Proj;\n"
+    "    mat4 View;\n"
+    "    vec4 viewport;\n"
+    "};\n";
+
+// -----------------------------------------------------------------------------------
+FrameUniforms::FrameUniforms() :
+    ubo(0)
+  , data()
+  , cameraPosition(0.f)
+  , viewportSize(0.f)
+  , orthoView(0.f)
+  , valid(false)
+  , programs()
+  , updates(0)
+  , frames(0)
+{}
+
+// -----------------------------------------------------------------------------------
+FrameUniforms::~FrameUniforms()
+{}
+
+// -----------------------------------------------------------------------------------
+void FrameUniforms::Boost()
+{
+    class_ < FrameUniforms, FrameUniformsPtr, boost::noncopyable >("FrameUniforms", "The per frame view data shared by the shaders through a uniform buffer", no_init)
+        .add_property("updates", &FrameUniforms::GetUpdates, "Times the view data had to be rewritten")
+        .add_property("frames", &FrameUniforms::GetFrames, "Frames the view data was applied to")
+        .def("ResetStats", &FrameUniforms::ResetStats)
+        .def("Invalidate", &FrameUniforms::Invalidate, "Rewrite the view data next frame")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+bool FrameUniforms::Init()
+{
+    GLFW_THREAD_CHECK();
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(ViewBlockData), NULL, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    GL_CHECK_ERROR("GL Error: FrameUniforms::Init")
+    valid = false;
+    return ubo != 0;
+}
+
+// -----------------------------------------------------------------------------------
+void FrameUniforms::Shutdown()
+{
+    if (ubo != 0)
+    {
+        glDeleteBuffers(1, &ubo);
+        ubo = 0;
+    }
+    programs.clear();
+    valid = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Only needs doing once per program, the binding is part of the program object.
+bool FrameUniforms::AttachProgram(GLuint program)
+{
+    if (std::find(programs.begin(), programs.end(), program) != programs.end())
+    {
+        return true;
+    }
+    GLuint index = glGetUniformBlockIndex(program, "ViewBlock");
+    if (index == GL_INVALID_INDEX)
+    {
+        return false;
+    }
+    glUniformBlockBinding(program, index, VIEW_BLOCK_BINDING);
+    GL_CHECK_ERROR("GL Error: FrameUniforms::AttachProgram")
+    programs.push_back(program);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Builds the same matrices as RenderSettings::CalculateProjView, but only when the
+// view options moved, and leaves the render objects to skip the view projection
+// upload.
+void FrameUniforms::Apply(ViewOptionsPtr opt, RenderSettingsPtr settings)
+{
+    GLFW_THREAD_CHECK();
+    ++frames;
+    glm::vec3 cam = opt->cameraPosition();
+    glm::vec2 viewport(opt->viewportSize().x, opt->viewportSize().y);
+    glm::vec3 ortho(opt->orthoView().x, opt->orthoView().y, opt->orthoView().z);
+    if (!valid || cam != cameraPosition || viewport != viewportSize || ortho != orthoView)
+    {
+        cameraPosition = cam;
+        viewportSize = viewport;
+        orthoView = ortho;
+        data.Proj = glm::perspective(ortho.x * DEG2RAD, viewport.x / viewport.y, ortho.y, ortho.z);
+        data.View = glm::translate(glm::mat4(1.f), -1.0f * cam);
+        data.ProjView = data.Proj * data.View;
+        data.viewport = glm::vec4(viewport.x, viewport.y, 1.f / viewport.x, 1.f / viewport.y);
+
+        glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(ViewBlockData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        valid = true;
+        ++updates;
+    }
+    glBindBufferBase(GL_UNIFORM_BUFFER, VIEW_BLOCK_BINDING, ubo);
+    GL_CHECK_ERROR("GL Error: FrameUniforms::Apply")
+
+    settings->ProjViewMat = data.ProjView;
+    settings->viewportSize = viewportSize;
+    settings->viewBlock = true;
+}
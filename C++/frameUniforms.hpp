@@ -0,0 +1,66 @@
+/* -----------------------------------------------------------------------------------
+   -- frameUniforms.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __FRAME_UNIFORMS_HPP__
+#define __FRAME_UNIFORMS_HPP__
+#include <stdio.h>
+#include <vector>
+#include "sdtGraphics.hpp"
+#include "ro_base.hpp"
+
+class FrameUniforms;
+typedef boost::shared_ptr<FrameUniforms> FrameUniformsPtr;
+
+// the uniform buffer binding point the view block lives on
+#define VIEW_BLOCK_BINDING 0
+
+// -----------------------------------------------------------------------------------
+// std140 layout of the ViewBlock uniform block, see FrameUniforms::BLOCK_GLSL.
+struct ViewBlockData
+{
+    glm::mat4 ProjView;
+    glm::mat4 Proj;
+    glm::mat4 View;
+    glm::vec4 viewport;         // width, height, 1/width, 1/height
+};
+
+// -----------------------------------------------------------------------------------
+// The per frame view data in a uniform buffer shared by every shader that declares
+// the ViewBlock, instead of each object uploading the view projection itself.
+// The buffer is only rewritten when the camera, viewport or ortho view changed, and
+// is bound once per frame. Shaders declare the block with BLOCK_GLSL and are hooked
+// up once with AttachProgram. Render thread only.
+class FrameUniforms
+{
+private:
+    GLuint              ubo;                // the uniform buffer
+    ViewBlockData       data;               // what is in it
+    glm::vec3           cameraPosition;     // the view options the data was built from
+    glm::vec2           viewportSize;       // ..
+    glm::vec3           orthoView;          // ..
+    bool                valid;              // data matches the buffer
+    std::vector<GLuint> programs;           // programs already bound to the block
+    long                updates;            // times the buffer was rewritten
+    long                frames;             // times Apply was called
+
+public:
+    static const char * BLOCK_GLSL;         // the block declaration for the shader source
+
+    FrameUniforms();
+    ~FrameUniforms();
+    static void Boost();
+
+    bool Init();                            // create the buffer, needs a current context
+    void Shutdown();                        // release the buffer
+
+    bool AttachProgram(GLuint program);     // bind the program's ViewBlock, false if it doesn't have one
+    void Apply(ViewOptionsPtr opt, RenderSettingsPtr settings);    // update if the view changed, bind, fill in settings
+    void Invalidate()                       { valid = false; }
+
+    long GetUpdates()                       { return updates; }
+    long GetFrames()                        { return frames; }
+    void ResetStats()                       { updates = frames = 0; }
+};
+
+#endif
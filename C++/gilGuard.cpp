@@ -0,0 +1,55 @@
+/* -----------------------------------------------------------------------------------
+   -- gilGuard.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "gilGuard.hpp"
+
+std::mutex PyReleaseQueue::lock;
+std::vector< boost::shared_ptr<void> > PyReleaseQueue::pending;
+long PyReleaseQueue::released = 0;
+
+// -----------------------------------------------------------------------------------
+void PyReleaseQueue::Boost()
+{
+    class_ < PyReleaseQueue, boost::noncopyable >("PyReleaseQueue", "Drops the references the render thread let go of", no_init)
+        .def("Drain", &PyReleaseQueue::Drain, "Call once per tick")
+        .staticmethod("Drain")
+        .def("GetPending", &PyReleaseQueue::GetPending)
+        .staticmethod("GetPending")
+        .def("GetReleased", &PyReleaseQueue::GetReleased)
+        .staticmethod("GetReleased")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void PyReleaseQueue::Defer(boost::shared_ptr<void> object)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(object);
+}
+
+// -----------------------------------------------------------------------------------
+// Swapped out under the lock, the references are dropped after it, a destructor can
+// run python code.
+int PyReleaseQueue::Drain()
+{
+    std::vector< boost::shared_ptr<void> > dropping;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        dropping.swap(pending);
+    }
+    released += dropping.size();
+    return dropping.size();
+}
+
+// -----------------------------------------------------------------------------------
+int PyReleaseQueue::GetPending()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    return pending.size();
+}
@@ -0,0 +1,78 @@
+/* -----------------------------------------------------------------------------------
+   -- gilGuard.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __GIL_GUARD_HPP__
+#define __GIL_GUARD_HPP__
+#include <stdio.h>
+#include <assert.h>
+#include <mutex>
+#include <vector>
+#include <boost/python.hpp>
+#include <boost/shared_ptr.hpp>
+
+// -----------------------------------------------------------------------------------
+// True if this thread holds the GIL. The render thread never has a python thread
+// state, so it is always false there.
+inline bool PyGILHeld()
+{
+#if PY_VERSION_HEX >= 0x03040000
+    return Py_IsInitialized() && PyGILState_Check();
+#else
+    PyThreadState *state = PyGILState_GetThisThreadState();
+    return state != NULL && state == _PyThreadState_Current;
+#endif
+}
+
+// The frame loop on the GLFW thread must never need the GIL, debug builds check it
+// where GLFW_THREAD_CHECK is.
+#ifndef NDEBUG
+#define GIL_FREE_CHECK() assert(!PyGILHeld() && "the GIL is held in the frame loop")
+#else
+#define GIL_FREE_CHECK()
+#endif
+
+// -----------------------------------------------------------------------------------
+// Lets the other python threads run while a bound call works in C++. Nothing between
+// the constructor and the destructor may touch a python object, that includes
+// dropping the last reference to a shared_ptr that came from python. Does nothing if
+// we don't hold the GIL, so the calls it guards can be nested.
+class ScopedGILRelease
+{
+private:
+    PyThreadState  *state;
+
+public:
+    ScopedGILRelease() : state(PyGILHeld() ? PyEval_SaveThread() : NULL) {}
+    ~ScopedGILRelease()             { Restore(); }
+    void Restore()                  { if (state) PyEval_RestoreThread(state); state = NULL; }    // take it back early
+};
+
+// -----------------------------------------------------------------------------------
+// References the render thread lets go of, dropped on the python thread instead. The
+// last reference to a render object destroys its controller, and a shared_ptr that
+// python handed us releases the python object, both need the GIL. Commands hand their
+// destination over when they are returned off the python thread, Detach its children.
+// Drain is called once per tick on the python thread.
+class PyReleaseQueue
+{
+private:
+    static std::mutex                           lock;
+    static std::vector< boost::shared_ptr<void> > pending;
+    static long                                 released;
+
+public:
+    static void Boost();
+    static void Defer(boost::shared_ptr<void> object);
+    template <typename T>
+    static void Defer(const std::vector< boost::shared_ptr<T> > &objects)
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        pending.insert(pending.end(), objects.begin(), objects.end());
+    }
+    static int  Drain();                // python thread, returns the references dropped
+    static int  GetPending();
+    static long GetReleased()           { return released; }
+};
+
+#endif
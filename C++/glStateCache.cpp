@@ -0,0 +1,164 @@
+/* -----------------------------------------------------------------------------------
+   -- glStateCache.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "glStateCache.hpp"
+#include "utils.hpp"
+#include "renderStats.hpp"
+
+// -----------------------------------------------------------------------------------
+GLStateCache::GLStateCache() :
+    programKnown(false)
+  , program(0)
+  , activeTexture(0)
+  , uniforms()
+  , callsIssued(0)
+  , callsSaved(0)
+  , lastCallsIssued(0)
+  , lastCallsSaved(0)
+{
+    Invalidate();
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::Boost()
+{
+    class_ < GLStateCache, GLStateCachePtr, boost::noncopyable >("GLStateCache", "Filters redundant GL state changes on the render thread", no_init)
+        .add_property("callsIssued", &GLStateCache::GetCallsIssued, "GL calls made through the cache last frame")
+        .add_property("callsSaved", &GLStateCache::GetCallsSaved, "Redundant GL calls skipped last frame")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::BeginFrame()
+{
+    Invalidate();
+    callsIssued = callsSaved = 0;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::EndFrame()
+{
+    lastCallsIssued = callsIssued;
+    lastCallsSaved = callsSaved;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::Invalidate()
+{
+    programKnown = false;
+    activeTexture = 0;
+    for (int i = 0; i < GLSTATE_TEXTURE_UNITS; ++i)
+    {
+        boundTextures[i] = (GLuint)-1;
+    }
+    uniforms.clear();
+}
+
+// -----------------------------------------------------------------------------------
+GLuint GLStateCache::GetProgram()
+{
+    if (!programKnown)
+    {
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        program = current;
+        programKnown = true;
+        ++callsIssued;
+    }
+    return program;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::UseProgram(GLuint prog)
+{
+    if (programKnown && prog == program)
+    {
+        ++callsSaved;
+        return;
+    }
+    glUseProgram(prog);
+    program = prog;
+    programKnown = true;
+    ++callsIssued;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::ActiveTexture(GLenum unit)
+{
+    if (unit == activeTexture)
+    {
+        ++callsSaved;
+        return;
+    }
+    glActiveTexture(unit);
+    activeTexture = unit;
+    ++callsIssued;
+}
+
+// -----------------------------------------------------------------------------------
+void GLStateCache::BindTexture2D(GLuint texture)
+{
+    int unit = activeTexture - GL_TEXTURE0;
+    if (activeTexture == 0 || unit < 0 || unit >= GLSTATE_TEXTURE_UNITS)
+    {
+        // unit unknown or untracked, just pass it on.
+        glBindTexture(GL_TEXTURE_2D, texture);
+        ++callsIssued;
+        RENDER_STAT_INC(RS_TEXTURE_BINDS)
+        return;
+    }
+    if (boundTextures[unit] == texture)
+    {
+        ++callsSaved;
+        return;
+    }
+    glBindTexture(GL_TEXTURE_2D, texture);
+    boundTextures[unit] = texture;
+    ++callsIssued;
+    RENDER_STAT_INC(RS_TEXTURE_BINDS)
+}
+
+// -----------------------------------------------------------------------------------
+// Uniform values belong to the program, so they are tracked per program.
+// There are only ever a few matrix uniforms so a linear search is fine.
+void GLStateCache::UniformMatrix4(GLint location, const glm::mat4 &m)
+{
+    if (!programKnown)
+    {
+        GetProgram();
+    }
+    GLuint prog = program;
+    for (std::vector<UniformMat4>::iterator it = uniforms.begin(); it != uniforms.end(); ++it)
+    {
+        if (it->program == prog && it->location == location)
+        {
+            if (it->value == m)
+            {
+                ++callsSaved;
+                return;
+            }
+            it->value = m;
+            glUniformMatrix4fv(location, 1, GL_FALSE, &(m[0][0]));
+            ++callsIssued;
+            RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+            return;
+        }
+    }
+    UniformMat4 u;
+    u.program = prog;
+    u.location = location;
+    u.value = m;
+    uniforms.push_back(u);
+    glUniformMatrix4fv(location, 1, GL_FALSE, &(m[0][0]));
+    ++callsIssued;
+    RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+}
@@ -0,0 +1,58 @@
+/* -----------------------------------------------------------------------------------
+   -- glStateCache.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __GL_STATE_CACHE_HPP__
+#define __GL_STATE_CACHE_HPP__
+#include <stdio.h>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "sdtGraphics.hpp"
+
+#define GLSTATE_TEXTURE_UNITS 8
+
+class GLStateCache;
+typedef boost::shared_ptr<GLStateCache> GLStateCachePtr;
+
+// -----------------------------------------------------------------------------------
+// Shadows the bits of GL state the render objects touch, so redundant calls never
+// reach the driver. Anything that changes GL state without going through the cache
+// must call Invalidate() afterwards. Render thread only.
+class GLStateCache
+{
+private:
+    struct UniformMat4
+    {
+        GLuint      program;
+        GLint       location;
+        glm::mat4   value;
+    };
+
+    bool        programKnown;                               // false until the program has been queried or set
+    GLuint      program;                                    // the bound program
+    GLenum      activeTexture;                              // the active texture unit
+    GLuint      boundTextures[GLSTATE_TEXTURE_UNITS];       // the 2D texture bound on each unit
+    std::vector<UniformMat4> uniforms;                      // the last value uploaded to each matrix uniform
+
+    long        callsIssued, callsSaved;                    // counts for the current frame
+    long        lastCallsIssued, lastCallsSaved;            // counts for the last completed frame
+
+public:
+    GLStateCache();
+    static void Boost();
+
+    void BeginFrame();                                      // forget everything, start counting the frame
+    void EndFrame();                                        // publish the frame counts
+    void Invalidate();                                      // forget everything, GL was changed behind our back
+
+    GLuint GetProgram();                                    // the bound program, queried at most once
+    void UseProgram(GLuint prog);
+    void ActiveTexture(GLenum unit);
+    void BindTexture2D(GLuint texture);                     // bind on the active unit
+    void UniformMatrix4(GLint location, const glm::mat4 &m);    // upload to the bound program
+
+    long GetCallsIssued()                                   { return lastCallsIssued; }
+    long GetCallsSaved()                                    { return lastCallsSaved; }
+};
+
+#endif
@@ -0,0 +1,103 @@
+/* -----------------------------------------------------------------------------------
+   -- lazyMaterializer.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "lazyMaterializer.hpp"
+
+LazyMaterializerPtr LazyMaterializer::instance;
+
+// -----------------------------------------------------------------------------------
+LazyMaterializer::LazyMaterializer(int _nodeBudget) :
+    requests()
+  , nodeBudget(_nodeBudget)
+  , materialized(0)
+  , nodesBuilt(0)
+{}
+
+// -----------------------------------------------------------------------------------
+LazyMaterializer::~LazyMaterializer()
+{}
+
+// -----------------------------------------------------------------------------------
+void LazyMaterializer::Boost()
+{
+    class_ < LazyMaterializer, LazyMaterializerPtr, boost::noncopyable >("LazyMaterializer", "Builds the lazy scene subtrees once they are collected", no_init)
+        .def("GetInstance", &LazyMaterializer::GetInstance)
+        .staticmethod("GetInstance")
+        .def("Process", &LazyMaterializer::Process, "Build the requested subtrees, up to the node budget. Call once per tick")
+        .add_property("nodeBudget", &LazyMaterializer::GetNodeBudget, &LazyMaterializer::SetNodeBudget, "Objects Process may make per call")
+        .add_property("pending", &LazyMaterializer::GetPending, "Subtrees waiting to be built")
+        .add_property("materialized", &LazyMaterializer::GetMaterialized)
+        .add_property("nodesBuilt", &LazyMaterializer::GetNodesBuilt)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void LazyMaterializer::StartInstance(int nodeBudget)
+{
+    if (!instance)
+    {
+        instance = LazyMaterializerPtr(new LazyMaterializer(nodeBudget));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+LazyMaterializerPtr LazyMaterializer::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void LazyMaterializer::StopInstance()
+{
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+void LazyMaterializer::Request(RO_LazyPtr lazy)
+{
+    std::lock_guard<std::mutex> guard(requestLock);
+    requests.push_back(lazy);
+}
+
+// -----------------------------------------------------------------------------------
+int LazyMaterializer::GetPending()
+{
+    std::lock_guard<std::mutex> guard(requestLock);
+    return requests.size();
+}
+
+// -----------------------------------------------------------------------------------
+// At least one subtree is built per call, however big, so nothing waits forever.
+int LazyMaterializer::Process()
+{
+    int count = 0;
+    int built = 0;
+    while (built < nodeBudget || count == 0)
+    {
+        RO_LazyPtr lazy;
+        {
+            std::lock_guard<std::mutex> guard(requestLock);
+            if (requests.empty())
+            {
+                break;
+            }
+            lazy = requests.front();
+            requests.pop_front();
+        }
+        int made = lazy->Materialize();
+        if (made > 0)
+        {
+            built += made;
+            ++count;
+        }
+    }
+    materialized += count;
+    nodesBuilt += built;
+    return count;
+}
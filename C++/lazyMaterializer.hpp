@@ -0,0 +1,49 @@
+/* -----------------------------------------------------------------------------------
+   -- lazyMaterializer.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __LAZY_MATERIALIZER_HPP__
+#define __LAZY_MATERIALIZER_HPP__
+#include <stdio.h>
+#include <deque>
+#include <mutex>
+#include "ro_lazy.hpp"
+
+class LazyMaterializer;
+typedef boost::shared_ptr<LazyMaterializer> LazyMaterializerPtr;
+
+// -----------------------------------------------------------------------------------
+// Builds the RO_Lazy subtrees that have been collected. The requests come from the
+// render thread and the frame pipeline's workers, the building has to be done on the
+// python thread, so the scene calls Process once per tick. Each call builds up to the
+// node budget, a layer that was switched on comes in over a few ticks, a level at a
+// time, instead of stalling the one it was switched on in.
+class LazyMaterializer
+{
+private:
+    static LazyMaterializerPtr  instance;       // the singleton instance.
+    std::deque<RO_LazyPtr>      requests;       // waiting to be built
+    std::mutex                  requestLock;    // guards requests
+    int                         nodeBudget;     // objects Process may make per call
+    long                        materialized;   // stats, subtrees built
+    long                        nodesBuilt;     // .. objects made for them
+
+public:
+    LazyMaterializer(int _nodeBudget);
+    ~LazyMaterializer();
+    static void Boost();
+    static void StartInstance(int nodeBudget = 2000);  // Static Instance interface
+    static LazyMaterializerPtr GetInstance();          // ..
+    static void StopInstance();                        // ..
+
+    void Request(RO_LazyPtr lazy);              // any thread
+    int  Process();                             // python thread, returns the subtrees built
+
+    int  GetNodeBudget()                        { return nodeBudget; }
+    void SetNodeBudget(int n)                   { nodeBudget = n; }
+    int  GetPending();
+    long GetMaterialized()                      { return materialized; }
+    long GetNodesBuilt()                        { return nodesBuilt; }
+};
+
+#endif
@@ -0,0 +1,130 @@
+/* -----------------------------------------------------------------------------------
+   -- memoryAccounting.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "memoryAccounting.hpp"
+
+std::atomic<bool> MemoryAccounting::enabled(false);
+MemoryAccounting::Counters MemoryAccounting::counters[MEM_TAG_COUNT];
+long long MemoryAccounting::sampledAllocs[MEM_TAG_COUNT];
+long long MemoryAccounting::sampledBytes[MEM_TAG_COUNT];
+std::chrono::steady_clock::time_point MemoryAccounting::sampledAt = std::chrono::steady_clock::now();
+
+// -----------------------------------------------------------------------------------
+void MemoryAccounting::Boost()
+{
+    class_ < MemoryAccounting, boost::noncopyable >("MemoryAccounting", "Live and peak bytes by subsystem", no_init)
+        .def("GetEnabled", &MemoryAccounting::Enabled)
+        .staticmethod("GetEnabled")
+        .def("SetEnabled", &MemoryAccounting::SetEnabled, "Count from now, what was made before isn't counted")
+        .staticmethod("SetEnabled")
+        .def("Report", &MemoryAccounting::Report, "{tag: {live, peak, allocs, frees, allocsPerSec, bytesPerSec}}, the rates since the last Report")
+        .staticmethod("Report")
+        .def("ResetPeaks", &MemoryAccounting::ResetPeaks)
+        .staticmethod("ResetPeaks")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+// The peak can miss a race between two threads allocating at once, by one allocation.
+void MemoryAccounting::Count(MemoryTag tag, long long bytes)
+{
+    Counters &c = counters[tag];
+    long long live = c.live.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    c.allocs.fetch_add(1, std::memory_order_relaxed);
+    c.allocated.fetch_add(bytes, std::memory_order_relaxed);
+    long long peak = c.peak.load(std::memory_order_relaxed);
+    while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+    {}
+}
+
+// -----------------------------------------------------------------------------------
+// Once off, the next Resize lets go of what was counted.
+void MemoryAccounting::Resize(MemoryTag tag, long long &accounted, long long bytes)
+{
+    if (accounted == 0 || !Enabled() || bytes <= 0)
+    {
+        Free(tag, accounted);
+        accounted = Alloc(tag, bytes);
+        return;
+    }
+    long long delta = bytes - accounted;
+    if (delta == 0)
+    {
+        return;
+    }
+    Counters &c = counters[tag];
+    long long live = c.live.fetch_add(delta, std::memory_order_relaxed) + delta;
+    if (delta > 0)
+    {
+        c.allocated.fetch_add(delta, std::memory_order_relaxed);
+        long long peak = c.peak.load(std::memory_order_relaxed);
+        while (live > peak && !c.peak.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {}
+    }
+    accounted = bytes;
+}
+
+// -----------------------------------------------------------------------------------
+const char *MemoryAccounting::TagName(int tag)
+{
+    static const char *names[MEM_TAG_COUNT] = { "commands", "commandData", "renderObjects", "renderSets", "textures", "sceneData" };
+    return tag >= 0 && tag < MEM_TAG_COUNT ? names[tag] : "unknown";
+}
+
+// -----------------------------------------------------------------------------------
+long long MemoryAccounting::GetLive(int tag)
+{
+    return counters[tag].live.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------
+long long MemoryAccounting::GetPeak(int tag)
+{
+    return counters[tag].peak.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------
+long long MemoryAccounting::GetAllocs(int tag)
+{
+    return counters[tag].allocs.load(std::memory_order_relaxed);
+}
+
+// -----------------------------------------------------------------------------------
+void MemoryAccounting::ResetPeaks()
+{
+    for (int i = 0; i < MEM_TAG_COUNT; ++i)
+    {
+        counters[i].peak = counters[i].live.load();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+dict MemoryAccounting::Report()
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    double seconds = std::chrono::duration<double>(now - sampledAt).count();
+    sampledAt = now;
+    dict report;
+    for (int i = 0; i < MEM_TAG_COUNT; ++i)
+    {
+        long long allocs = counters[i].allocs.load(std::memory_order_relaxed);
+        long long bytes = counters[i].allocated.load(std::memory_order_relaxed);
+        dict tag;
+        tag["live"] = GetLive(i);
+        tag["peak"] = GetPeak(i);
+        tag["allocs"] = allocs;
+        tag["frees"] = counters[i].frees.load(std::memory_order_relaxed);
+        tag["allocsPerSec"] = seconds > 0 ? (allocs - sampledAllocs[i]) / seconds : 0.0;
+        tag["bytesPerSec"] = seconds > 0 ? (bytes - sampledBytes[i]) / seconds : 0.0;
+        report[TagName(i)] = tag;
+        sampledAllocs[i] = allocs;
+        sampledBytes[i] = bytes;
+    }
+    return report;
+}
@@ -0,0 +1,109 @@
+/* -----------------------------------------------------------------------------------
+   -- memoryAccounting.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __MEMORY_ACCOUNTING_HPP__
+#define __MEMORY_ACCOUNTING_HPP__
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <boost/python.hpp>
+
+// -----------------------------------------------------------------------------------
+enum MemoryTag
+{
+    MEM_COMMANDS,           // CommandObjects, cached or in flight
+    MEM_COMMAND_DATA,       // .. their boost::any payloads
+    MEM_RENDER_OBJECTS,     // render object nodes, matrices included
+    MEM_RENDER_SETS,        // .. their render set strings
+    MEM_TEXTURES,           // GPU texture storage, streamed textures and atlas pages
+    MEM_SCENE_DATA,         // YAML text being parsed or kept for reloads, compiled scenes
+    MEM_TAG_COUNT
+};
+
+// -----------------------------------------------------------------------------------
+// Where the memory goes, by subsystem: live and peak bytes and how many allocations.
+// The owners report their own sizes, so this is what they hold rather than what the
+// allocator handed out, heap overhead isn't counted and sizes the code can't see
+// (the nodes of a YAML tree) are estimated from what it can.
+//
+// Off by default, then Alloc is one relaxed load and a branch. Alloc returns the bytes
+// it counted, 0 while off, and the owner keeps that and gives the same back to Free,
+// so it can be switched at any time: objects made while it was off are never counted.
+// Live bytes are then what was allocated since it was turned on.
+//
+//      accounted = MemoryAccounting::Alloc(MEM_TEXTURES, bytes);
+//      ...
+//      MemoryAccounting::Free(MEM_TEXTURES, accounted);
+//
+// Something that changes size keeps the one accounted value and passes it to Resize.
+class MemoryAccounting
+{
+private:
+    struct Counters
+    {
+        std::atomic<long long>  live;
+        std::atomic<long long>  peak;
+        std::atomic<long long>  allocs;
+        std::atomic<long long>  frees;
+        std::atomic<long long>  allocated;  // bytes, all time
+    };
+    static std::atomic<bool>    enabled;
+    static Counters             counters[MEM_TAG_COUNT];
+    static long long            sampledAllocs[MEM_TAG_COUNT];      // at the last Report, for the rates
+    static long long            sampledBytes[MEM_TAG_COUNT];       // ..
+    static std::chrono::steady_clock::time_point sampledAt;       // ..
+
+    static void Count(MemoryTag tag, long long bytes);
+
+public:
+    static void Boost();
+    static bool Enabled()                       { return enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool e)              { enabled = e; }
+
+    static long long Alloc(MemoryTag tag, long long bytes)
+    {
+        if (!Enabled() || bytes <= 0)
+        {
+            return 0;
+        }
+        Count(tag, bytes);
+        return bytes;
+    }
+    static void Free(MemoryTag tag, long long accounted)
+    {
+        if (accounted > 0)
+        {
+            counters[tag].live.fetch_sub(accounted, std::memory_order_relaxed);
+            counters[tag].frees.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    static void Resize(MemoryTag tag, long long &accounted, long long bytes);  // the owner grew or shrank, not a new allocation
+    static long long StringBytes(const std::string &s)     // on the heap, past the small string buffer
+    {
+        return s.capacity() > 15 ? (long long)s.capacity() + 1 : 0;
+    }
+
+    static const char *TagName(int tag);
+    static long long GetLive(int tag);
+    static long long GetPeak(int tag);
+    static long long GetAllocs(int tag);
+    static void ResetPeaks();                   // peaks from now
+    static boost::python::dict Report();        // {tag: {live, peak, allocs, frees, allocsPerSec, bytesPerSec}}, rates since the last Report
+};
+
+// -----------------------------------------------------------------------------------
+// Counts a buffer that only lives for a scope, a parse for example.
+class MemoryScope
+{
+private:
+    MemoryTag   tag;
+    long long   accounted;
+
+public:
+    MemoryScope(MemoryTag _tag, long long bytes) : tag(_tag), accounted(MemoryAccounting::Alloc(_tag, bytes)) {}
+    ~MemoryScope()                              { MemoryAccounting::Free(tag, accounted); }
+};
+
+#endif
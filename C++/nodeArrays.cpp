@@ -0,0 +1,283 @@
+/* -----------------------------------------------------------------------------------
+   -- nodeArrays.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <string.h>
+
+using namespace boost::python;
+using namespace std;
+
+#include "nodeArrays.hpp"
+#include "nodeBatch.hpp"
+#include "commandProperty.hpp"      // StaticQueueCommand
+
+// floats per node in the shadow: position, rotation, scaleX, scaleY, alpha
+#define SHADOW_FLOATS 7
+
+// -----------------------------------------------------------------------------------
+// The python object handed out for each array, it only exports the buffer. It holds
+// the NodeArrays' python object, so the storage outlives every view of it.
+namespace
+{
+    struct ArrayView
+    {
+        PyObject_HEAD
+        PyObject   *owner;
+        float      *data;
+        Py_ssize_t  count;          // floats
+        int         ndim;
+        Py_ssize_t  shape[3];
+        Py_ssize_t  strides[3];
+        int         readonly;
+    };
+
+    PyTypeObject    arrayViewType = { PyVarObject_HEAD_INIT(NULL, 0) };
+    PyBufferProcs   arrayViewBuffer;
+
+    // -----------------------------------------------------------------------------------
+    int ArrayView_GetBuffer(PyObject *obj, Py_buffer *view, int flags)
+    {
+        ArrayView *self = (ArrayView *)obj;
+        if ((flags & PyBUF_WRITABLE) && self->readonly)
+        {
+            PyErr_SetString(PyExc_BufferError, "NodeArrays: this array is read only");
+            view->obj = NULL;
+            return -1;
+        }
+        view->buf = self->data;
+        view->obj = obj;
+        Py_INCREF(obj);
+        view->len = self->count * sizeof(float);
+        view->itemsize = sizeof(float);
+        view->readonly = self->readonly;
+        view->ndim = self->ndim;
+        view->format = (flags & PyBUF_FORMAT) ? (char *)"f" : NULL;
+        view->shape = (flags & PyBUF_ND) == PyBUF_ND ? self->shape : NULL;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? self->strides : NULL;
+        view->suboffsets = NULL;
+        view->internal = NULL;
+        return 0;
+    }
+
+    // -----------------------------------------------------------------------------------
+    void ArrayView_Dealloc(PyObject *obj)
+    {
+        Py_XDECREF(((ArrayView *)obj)->owner);
+        PyObject_Del(obj);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+NodeArrays::NodeArrays(RO_BaseVector _nodes) : BaseCommandObject()
+  , nodes(_nodes)
+  , positions(nodes.size() * 3)
+  , rotations(nodes.size())
+  , scales(nodes.size() * 2)
+  , alphas(nodes.size())
+  , world(nodes.size() * 16)
+  , aabbs(nodes.size() * 6)
+  , shadow(nodes.size() * SHADOW_FLOATS)
+{}
+
+// -----------------------------------------------------------------------------------
+NodeArrays::~NodeArrays()
+{}
+
+// -----------------------------------------------------------------------------------
+// Refresh queues a command to us, so it can't run until we are owned.
+NodeArraysPtr NodeArrays::Create(RO_IteratorPtr itr)
+{
+    NodeArraysPtr arrays(new NodeArrays(itr ? itr->items : RO_BaseVector()));
+    arrays->Refresh();
+    return arrays;
+}
+
+// -----------------------------------------------------------------------------------
+void NodeArrays::Boost()
+{
+    arrayViewBuffer.bf_getbuffer = ArrayView_GetBuffer;
+    arrayViewType.tp_name = "NodeArrayView";
+    arrayViewType.tp_basicsize = sizeof(ArrayView);
+    arrayViewType.tp_dealloc = ArrayView_Dealloc;
+    arrayViewType.tp_as_buffer = &arrayViewBuffer;
+    arrayViewType.tp_flags = Py_TPFLAGS_DEFAULT;
+#ifdef Py_TPFLAGS_HAVE_NEWBUFFER
+    arrayViewType.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+    arrayViewType.tp_doc = "A float array of a NodeArrays, use it through numpy.asarray or memoryview";
+    if (PyType_Ready(&arrayViewType) < 0)
+    {
+        throw_error_already_set();
+    }
+
+    class_ < NodeArrays, NodeArraysPtr, bases<BaseCommandObject>, boost::noncopyable >("NodeArrays", "The transforms of many render objects as arrays numpy can use without copying", no_init)
+        .def("__init__", make_constructor(&NodeArrays::Create))
+        .def("__len__", &NodeArrays::GetCount)
+        .def("__getitem__", &NodeArrays::GetNode)
+        .def("Refresh", &NodeArrays::Refresh, "Gather the current values into the arrays, world and aabbs follow once the render thread catches up")
+        .def("Commit", &NodeArrays::Commit, "Send the changes made to the positions, rotations, scales and alphas since the last Refresh or Commit as one batched update")
+        .add_property("positions", &NodeArrays::GetPositions, "(n, 3) float32, writable")
+        .add_property("rotations", &NodeArrays::GetRotations, "(n,) float32 degrees, writable")
+        .add_property("scales", &NodeArrays::GetScales, "(n, 2) float32 scaleX, scaleY, writable")
+        .add_property("alphas", &NodeArrays::GetAlphas, "(n,) float32, writable")
+        .add_property("world", &NodeArrays::GetWorld, "(n, 4, 4) float32 column major world matrices, read only, current after sm.WaitForRender()")
+        .add_property("aabbs", &NodeArrays::GetAABBs, "(n, 2, 3) float32 min and max, read only, current after sm.WaitForRender()")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::View(object self, float *data, int ndim, int d1, int d2, bool writable)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    ArrayView *view = PyObject_New(ArrayView, &arrayViewType);
+    if (!view)
+    {
+        throw_error_already_set();
+    }
+    view->owner = self.ptr();
+    Py_INCREF(view->owner);
+    view->data = data;
+    view->ndim = ndim;
+    view->shape[0] = arrays.nodes.size();
+    view->shape[1] = d1;
+    view->shape[2] = d2;
+    view->strides[ndim - 1] = sizeof(float);
+    for (int i = ndim - 2; i >= 0; --i)
+    {
+        view->strides[i] = view->strides[i + 1] * view->shape[i + 1];
+    }
+    view->count = view->shape[0] * (ndim > 1 ? d1 : 1) * (ndim > 2 ? d2 : 1);
+    view->readonly = !writable;
+    return object(handle<>((PyObject *)view));
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetPositions(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.positions.data(), 2, 3, 0, true);
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetRotations(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.rotations.data(), 1, 0, 0, true);
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetScales(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.scales.data(), 2, 2, 0, true);
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetAlphas(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.alphas.data(), 1, 0, 0, true);
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetWorld(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.world.data(), 3, 4, 4, false);
+}
+
+// -----------------------------------------------------------------------------------
+object NodeArrays::GetAABBs(object self)
+{
+    NodeArrays &arrays = extract<NodeArrays &>(self);
+    return View(self, arrays.aabbs.data(), 3, 2, 3, false);
+}
+
+// -----------------------------------------------------------------------------------
+// The python side values, what the render thread will have once the queue drains.
+// Read holding the GIL. The matrices and boxes are the render thread's, it copies them
+// in when it gets to the command queued here.
+void NodeArrays::Refresh()
+{
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        RO_Base *node = nodes[i].get();
+        glm::vec3 position = node->position.pyGet();
+        positions[i * 3 + 0] = position.x;
+        positions[i * 3 + 1] = position.y;
+        positions[i * 3 + 2] = position.z;
+        rotations[i] = node->rotation.pyGet();
+        scales[i * 2 + 0] = node->scaleX.pyGet();
+        scales[i * 2 + 1] = node->scaleY.pyGet();
+        alphas[i] = node->alpha.pyGet();
+
+        float *was = &shadow[i * SHADOW_FLOATS];
+        memcpy(was, &positions[i * 3], 3 * sizeof(float));
+        was[3] = rotations[i];
+        memcpy(was + 4, &scales[i * 2], 2 * sizeof(float));
+        was[6] = alphas[i];
+    }
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    StaticQueueCommand(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread, between frames, so nothing is transforming the nodes. No python here.
+void NodeArrays::ApplyCommand(CommandObjectPtr cmd)
+{
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        RO_Base *node = nodes[i].get();
+        memcpy(&world[i * 16], &node->currentTransform[0][0], 16 * sizeof(float));
+        memcpy(&aabbs[i * 6 + 0], &node->aabb.min[0], 3 * sizeof(float));
+        memcpy(&aabbs[i * 6 + 3], &node->aabb.max[0], 3 * sizeof(float));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Compared with the copy Refresh, or the last Commit, kept, so only the values the
+// caller changed in the arrays are sent. A node changed some other way since keeps
+// those changes unless the caller overwrote the same value. The GIL is held
+// throughout, the batch writes the python side values.
+int NodeArrays::Commit()
+{
+    NodeBatchPtr batch(new NodeBatch());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        float *was = &shadow[i * SHADOW_FLOATS];
+        NodeUpdate update(nodes[i]);
+        if (memcmp(was, &positions[i * 3], 3 * sizeof(float)) != 0)
+        {
+            update.fields |= NUF_POSITION;
+            update.position = glm::vec3(positions[i * 3 + 0], positions[i * 3 + 1], positions[i * 3 + 2]);
+            memcpy(was, &positions[i * 3], 3 * sizeof(float));
+        }
+        if (rotations[i] != was[3])
+        {
+            update.fields |= NUF_ROTATION;
+            update.rotation = was[3] = rotations[i];
+        }
+        if (scales[i * 2 + 0] != was[4])
+        {
+            update.fields |= NUF_SCALEX;
+            update.scaleX = was[4] = scales[i * 2 + 0];
+        }
+        if (scales[i * 2 + 1] != was[5])
+        {
+            update.fields |= NUF_SCALEY;
+            update.scaleY = was[5] = scales[i * 2 + 1];
+        }
+        if (alphas[i] != was[6])
+        {
+            update.fields |= NUF_ALPHA;
+            update.alpha = was[6] = alphas[i];
+        }
+        if (update.fields)
+        {
+            batch->Add(update);
+        }
+    }
+    return batch->Queue();
+}
@@ -0,0 +1,67 @@
+/* -----------------------------------------------------------------------------------
+   -- nodeArrays.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __NODE_ARRAYS_HPP__
+#define __NODE_ARRAYS_HPP__
+#include <stdio.h>
+#include <vector>
+#include "ro_base.hpp"
+
+class NodeArrays;
+typedef boost::shared_ptr<NodeArrays> NodeArraysPtr;
+
+// -----------------------------------------------------------------------------------
+// The transforms and properties of a set of render objects, as contiguous float arrays
+// python can use as NumPy arrays without copying: numpy.asarray(arrays.positions) is a
+// view on our storage, through the buffer protocol. Refresh gathers the python side
+// values of every node in one pass and keeps a copy, Commit sends the entries that
+// differ from that copy, the ones the caller changed, to the render thread as one
+// NodeBatch.
+//
+//      positions   (n, 3)      rotations   (n,)        scales  (n, 2)
+//      alphas      (n,)        world       (n, 4, 4)   aabbs   (n, 2, 3) min, max
+//
+// world and aabbs are read only. The render thread rewrites the matrices and boxes
+// every frame, so Refresh doesn't read them itself, it queues a command and the
+// render thread copies them in when it applies it, between frames. They are current
+// once the render thread caught up, after sm.WaitForRender(). The storage is sized
+// once for the nodes we were made with, so a view stays valid for as long as it is
+// held, it holds us.
+class NodeArrays : public BaseCommandObject
+{
+private:
+    RO_BaseVector       nodes;
+    std::vector<float>  positions;
+    std::vector<float>  rotations;
+    std::vector<float>  scales;
+    std::vector<float>  alphas;
+    std::vector<float>  world;
+    std::vector<float>  aabbs;
+    std::vector<float>  shadow;         // positions, rotations, scales and alphas as Refresh or Commit left them
+
+    static object View(object self, float *data, int ndim, int d1, int d2, bool writable);
+
+public:
+    NodeArrays(RO_BaseVector _nodes);
+    ~NodeArrays();
+    static NodeArraysPtr Create(RO_IteratorPtr itr);    // python's constructor
+    static void Boost();
+
+    void Refresh();                     // gather the values from the nodes, python thread
+    int  Commit();                      // send what changed in the writable arrays, returns the nodes updated
+    int  GetCount()                     { return nodes.size(); }
+    RO_BasePtr GetNode(int n)           { return nodes[n]; }
+
+    static object GetPositions(object self);
+    static object GetRotations(object self);
+    static object GetScales(object self);
+    static object GetAlphas(object self);
+    static object GetWorld(object self);
+    static object GetAABBs(object self);
+
+public:                             // BaseCommandObject
+    virtual void ApplyCommand(CommandObjectPtr cmd);     // the world and aabbs snapshot, render thread
+};
+
+#endif
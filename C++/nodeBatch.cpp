@@ -0,0 +1,57 @@
+/* -----------------------------------------------------------------------------------
+   -- nodeBatch.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "nodeBatch.hpp"
+#include "gilGuard.hpp"
+
+// -----------------------------------------------------------------------------------
+NodeBatch::NodeBatch() : BaseCommandObject()
+    , updates()
+    , queued(false)
+{}
+
+// -----------------------------------------------------------------------------------
+NodeBatch::~NodeBatch()
+{}
+
+// -----------------------------------------------------------------------------------
+void NodeBatch::Add(const NodeUpdate &update)
+{
+    assert(!queued && "NodeBatch::Add after the batch was queued");
+    update.node->StageUpdate(update);
+    updates.push_back(update);
+}
+
+// -----------------------------------------------------------------------------------
+// An empty batch isn't sent.
+int NodeBatch::Queue()
+{
+    if (queued || updates.empty())
+    {
+        return 0;
+    }
+    queued = true;
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    StaticQueueCommand(cmd);
+    return updates.size();
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread. Each object reports its own damage, as if it had the commands. The
+// updates are kept, they go with the batch when the command lets go of it, see
+// PyReleaseQueue.
+void NodeBatch::ApplyCommand(CommandObjectPtr cmd)
+{
+    for (NodeUpdateVector::iterator it = updates.begin(); it != updates.end(); ++it)
+    {
+        it->node->ApplyUpdate(*it);
+        it->node->CommandApplied();
+    }
+}
@@ -0,0 +1,79 @@
+/* -----------------------------------------------------------------------------------
+   -- nodeBatch.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __NODE_BATCH_HPP__
+#define __NODE_BATCH_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "ro_base.hpp"
+
+class NodeBatch;
+typedef boost::shared_ptr<NodeBatch> NodeBatchPtr;
+
+// -----------------------------------------------------------------------------------
+// Which values of a NodeUpdate are set.
+enum NodeUpdateField
+{
+    NUF_ENABLED         = 1 << 0,
+    NUF_ROTATION        = 1 << 1,
+    NUF_SCALEX          = 1 << 2,
+    NUF_SCALEY          = 1 << 3,
+    NUF_POSITION        = 1 << 4,
+    NUF_ALPHA           = 1 << 5,
+    NUF_VISIBLESTATE    = 1 << 6,
+};
+
+// -----------------------------------------------------------------------------------
+// New property values for one render object, see RO_Base::StageUpdate and ApplyUpdate.
+struct NodeUpdate
+{
+    RO_BasePtr      node;
+    uint32_t        fields;         // NodeUpdateField bits
+    int             enabled;
+    float           rotation;
+    float           scaleX;
+    float           scaleY;
+    glm::vec3       position;
+    float           alpha;
+    std::string     visibleState;
+
+    NodeUpdate(RO_BasePtr _node) :
+        node(_node)
+      , fields(0)
+      , enabled(1)
+      , rotation(0.f)
+      , scaleX(1.f)
+      , scaleY(1.f)
+      , position()
+      , alpha(1.f)
+      , visibleState()
+    {}
+};
+typedef std::vector<NodeUpdate> NodeUpdateVector;
+
+// -----------------------------------------------------------------------------------
+// Property updates for many render objects that go to the render thread as one
+// command, instead of one command per property. The python side of each update is
+// written when it is added, like pySet does, and the C side when the command is
+// applied. A batch is used once: Add the updates, then Queue it.
+class NodeBatch : public BaseCommandObject
+{
+private:
+    NodeUpdateVector    updates;
+    bool                queued;
+
+public:
+    NodeBatch();
+    ~NodeBatch();
+
+    void Add(const NodeUpdate &update); // python thread, writes the python side
+    int  Queue();                       // .. send the batch, returns the number of updates
+    int  GetCount()                     { return updates.size(); }
+
+public:                             // BaseCommandObject
+    virtual void ApplyCommand(CommandObjectPtr cmd);
+};
+
+#endif
@@ -0,0 +1,73 @@
+/* -----------------------------------------------------------------------------------
+   -- renderCore.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "renderCore.hpp"
+#include "commandObject.hpp"
+#include "commandFence.hpp"
+#include "damageTracker.hpp"
+#include "deltaStream.hpp"
+#include "framePipeline.hpp"
+#include "frameProfiler.hpp"
+#include "frameUniforms.hpp"
+#include "gilGuard.hpp"
+#include "glStateCache.hpp"
+#include "lazyMaterializer.hpp"
+#include "memoryAccounting.hpp"
+#include "nodeArrays.hpp"
+#include "renderList.hpp"
+#include "renderStats.hpp"
+#include "ro_lazy.hpp"
+#include "sceneBinary.hpp"
+#include "sceneLoader.hpp"
+#include "sceneReloader.hpp"
+#include "spriteBatcher.hpp"
+#include "textureAtlas.hpp"
+#include "textureCache.hpp"
+#include "textureStreamer.hpp"
+
+// -----------------------------------------------------------------------------------
+// The bases go first, a class_ with bases<> needs them registered. BaseCommandObject
+// is normally in by now, RO_Base needs it too.
+void BoostRenderCore()
+{
+    static bool registered = false;
+    if (registered)
+    {
+        return;
+    }
+    registered = true;
+
+    if (converter::registry::query(type_id<BaseCommandObject>()) == NULL)
+    {
+        BaseCommandObject::Boost();
+    }
+    CommandFence::Boost();
+    NodeArrays::Boost();
+    TextureAtlas::Boost();
+    RO_Lazy::Boost();
+
+    DamageTracker::Boost();
+    DeltaStream::Boost();
+    FramePipeline::Boost();
+    FrameProfiler::Boost();
+    FrameUniforms::Boost();
+    PyReleaseQueue::Boost();
+    GLStateCache::Boost();
+    LazyMaterializer::Boost();
+    MemoryAccounting::Boost();
+    RenderListCache::Boost();
+    RenderListSorter::Boost();
+    RenderStats::Boost();
+    SceneBinary::Boost();
+    SceneLoader::Boost();
+    SceneReloader::Boost();
+    SpriteBatcher::Boost();
+    TextureCache::Boost();
+    TextureStreamer::Boost();
+}
@@ -0,0 +1,15 @@
+/* -----------------------------------------------------------------------------------
+   -- renderCore.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __RENDER_CORE_HPP__
+#define __RENDER_CORE_HPP__
+
+// -----------------------------------------------------------------------------------
+// Registers the python side of the render core classes: the loaders, the frame
+// pipeline, the texture streaming and the stats. Called at the end of RO_Base::Boost,
+// as RO_Lazy derives from RO_Base and a few others from BaseCommandObject. Only the
+// first call registers, the rest return.
+void BoostRenderCore();
+
+#endif
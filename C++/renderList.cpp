@@ -0,0 +1,213 @@
+/* -----------------------------------------------------------------------------------
+   -- renderList.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "renderList.hpp"
+
+// there are only ever a handful of renderSet combinations in use, if we have more
+// than this something is generating them, so start again rather than grow forever.
+#define MAX_CACHED_LISTS 32
+
+// how far back, in groups, the sorter looks for a matching group by default.
+#define SORT_WINDOW 16
+
+// -----------------------------------------------------------------------------------
+RenderListCache::RenderListCache() :
+    lists()
+  , lastRoot()
+  , rebuilds(0)
+  , reuses(0)
+{}
+
+// -----------------------------------------------------------------------------------
+RenderListCache::~RenderListCache()
+{
+    Invalidate();
+}
+
+// -----------------------------------------------------------------------------------
+void RenderListCache::Boost()
+{
+    class_ < RenderListCache, RenderListCachePtr, boost::noncopyable >("RenderListCache", "The cached render lists, per renderSet combination", no_init)
+        .add_property("rebuilds", &RenderListCache::GetRebuilds, "Number of times a render list was collected from the scene tree")
+        .add_property("reuses", &RenderListCache::GetReuses, "Number of frames that reused a cached render list")
+        .add_property("numLists", &RenderListCache::GetNumLists, "Number of renderSet combinations currently cached")
+        .def("ResetStats", &RenderListCache::ResetStats)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void RenderListSorter::Boost()
+{
+    class_ < RenderListSorter, RenderListSorterPtr, boost::noncopyable >("RenderListSorter", "Groups the render list by shader and texture, keeping overlapping objects in order", no_init)
+        .add_property("window", &RenderListSorter::GetWindow, &RenderListSorter::SetWindow, "How many groups back an object may be moved")
+        .add_property("keyChangesBefore", &RenderListSorter::GetKeyChangesBefore, "State changes the last list had before sorting")
+        .add_property("keyChangesAfter", &RenderListSorter::GetKeyChangesAfter, "State changes the last list had after sorting")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+std::string RenderListCache::MakeKey(stringList &renderSet)
+{
+    std::string key;
+    for (stringList::const_iterator it = renderSet.begin(); it != renderSet.end(); ++it)
+    {
+        key += *it;
+        key += '\x1f';
+    }
+    return key;
+}
+
+// -----------------------------------------------------------------------------------
+void RenderListCache::Invalidate()
+{
+    lists.clear();
+    lastRoot.reset();
+}
+
+// -----------------------------------------------------------------------------------
+// Return the render list for this renderSet, collecting it only if the scene
+// structure changed since the last time it was built.
+RenderObjectVectorPtr RenderListCache::Collect(RO_BasePtr root, stringList &renderSet)
+{
+    if (root != lastRoot)
+    {
+        Invalidate();
+        lastRoot = root;
+    }
+
+    unsigned long version = RO_Base::GetStructureVersion();
+    std::string key = MakeKey(renderSet);
+    CachedListMap::iterator it = lists.find(key);
+    if (it != lists.end() && it->second.version == version)
+    {
+        ++reuses;
+        return &(it->second.renderables);
+    }
+
+    if (it == lists.end())
+    {
+        if (lists.size() >= MAX_CACHED_LISTS)
+        {
+            lists.clear();
+        }
+        it = lists.insert(std::make_pair(key, CachedList())).first;
+    }
+
+    CachedList &cached = it->second;
+    cached.renderables.clear();     // keeps the capacity from the last build
+    if (root)
+    {
+        root->CollectRenderables(&cached.renderables, renderSet);
+    }
+    cached.version = version;
+    ++rebuilds;
+    return &cached.renderables;
+}
+
+// -----------------------------------------------------------------------------------
+// -----------------------------------------------------------------------------------
+static inline bool RectsOverlap(const glm::vec4 &a, const glm::vec4 &b)
+{
+    return a.x <= b.z && b.x <= a.z && a.y <= b.w && b.y <= a.w;
+}
+
+// -----------------------------------------------------------------------------------
+RenderListSorter::RenderListSorter() :
+    groups()
+  , groupOf()
+  , sorted()
+  , window(SORT_WINDOW)
+  , keyChangesBefore(0)
+  , keyChangesAfter(0)
+{}
+
+// -----------------------------------------------------------------------------------
+RenderObjectVectorPtr RenderListSorter::Sort(RenderObjectVectorPtr renderables, const glm::mat4 &projView)
+{
+    size_t n = renderables->size();
+    groups.clear();
+    groupOf.resize(n);
+    keyChangesBefore = 0;
+
+    unsigned long long lastKey = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        RO_Base *obj = (*renderables)[i];
+        unsigned long long key = obj->RenderKey();
+        if (i == 0 || key != lastKey)
+        {
+            ++keyChangesBefore;
+            lastKey = key;
+        }
+
+        glm::vec4 rect;
+        bool hasRect = obj->GetScreenRect(projView, rect);
+
+        // walk back from the newest group, we can join a group with our key as
+        // long as we didn't have to pass anything we overlap to get there.
+        int found = -1;
+        if (hasRect)
+        {
+            int stop = (int)groups.size() - window;
+            for (int g = (int)groups.size() - 1; g >= 0 && g >= stop; --g)
+            {
+                Group &grp = groups[g];
+                if (!grp.barrier && grp.key == key)
+                {
+                    found = g;
+                    break;
+                }
+                if (grp.barrier || RectsOverlap(grp.rect, rect))
+                {
+                    break;
+                }
+            }
+        }
+
+        if (found >= 0)
+        {
+            Group &grp = groups[found];
+            grp.rect = glm::vec4(glm::min(grp.rect.x, rect.x), glm::min(grp.rect.y, rect.y), glm::max(grp.rect.z, rect.z), glm::max(grp.rect.w, rect.w));
+            ++grp.count;
+        }
+        else
+        {
+            Group grp;
+            grp.key = key;
+            grp.rect = rect;
+            grp.barrier = !hasRect;
+            grp.count = 1;
+            groups.push_back(grp);
+            found = groups.size() - 1;
+        }
+        groupOf[i] = found;
+    }
+
+    // counting sort by group, which keeps the original order inside each group
+    keyChangesAfter = 0;
+    lastKey = 0;
+    int offset = 0;
+    for (size_t g = 0; g < groups.size(); ++g)
+    {
+        int count = groups[g].count;
+        groups[g].count = offset;
+        offset += count;
+        if (g == 0 || groups[g].key != lastKey)
+        {
+            ++keyChangesAfter;
+            lastKey = groups[g].key;
+        }
+    }
+    sorted.resize(n);
+    for (size_t i = 0; i < n; ++i)
+    {
+        sorted[groups[groupOf[i]].count++] = (*renderables)[i];
+    }
+    return &sorted;
+}
@@ -0,0 +1,87 @@
+/* -----------------------------------------------------------------------------------
+   -- renderList.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __RENDER_LIST_HPP__
+#define __RENDER_LIST_HPP__
+#include <stdio.h>
+#include <string>
+#include <map>
+#include "ro_base.hpp"
+
+class RenderListCache;
+typedef boost::shared_ptr<RenderListCache> RenderListCachePtr;
+
+// -----------------------------------------------------------------------------------
+// Keeps the collected render list for every renderSet combination the scene renders
+// with. A list is only rebuilt when RO_Base::GetStructureVersion() has moved on since
+// it was collected, so frames without structural changes skip the tree walk entirely.
+// It is used wherever the collect runs, a FramePipeline keeps one per root for the
+// worker preparing it. Not shared between threads.
+class RenderListCache
+{
+private:
+    struct CachedList
+    {
+        unsigned long       version;        // structure version the list was built at
+        RenderObjectVector  renderables;    // the collected objects, in draw order
+    };
+    typedef std::map<std::string, CachedList> CachedListMap;
+
+    CachedListMap   lists;                  // keyed by the joined renderSet names
+    RO_BasePtr      lastRoot;               // a different root invalidates everything
+    long            rebuilds;               // number of lists collected from the tree
+    long            reuses;                 // number of frames that reused a list
+
+    static std::string MakeKey(stringList &renderSet);
+
+public:
+    RenderListCache();
+    ~RenderListCache();
+    static void Boost();
+
+    RenderObjectVectorPtr Collect(RO_BasePtr root, stringList &renderSet);   // get the up to date list for this renderSet
+    void Invalidate();                                                        // drop all cached lists
+
+    long GetRebuilds()  { return rebuilds; }
+    long GetReuses()    { return reuses; }
+    int  GetNumLists()  { return lists.size(); }
+    void ResetStats()   { rebuilds = reuses = 0; }
+};
+
+// -----------------------------------------------------------------------------------
+// Reorders a render list so draws sharing a (shader, texture) key are next to each
+// other, without changing the result. An object only moves ahead of the objects
+// between it and its group when it overlaps none of them on screen, so anything
+// that overlaps keeps its painter order. Objects with no screen rect are barriers.
+// Run it every frame after the transforms, the screen rects move with the objects.
+class RenderListSorter
+{
+private:
+    struct Group
+    {
+        unsigned long long key;         // the state key shared by the group
+        glm::vec4 rect;                 // screen rect covering everything in the group
+        bool barrier;                   // nothing can be moved past this group
+        int count;                      // objects in the group
+    };
+    std::vector<Group>      groups;     // scratch, kept to avoid reallocating
+    std::vector<int>        groupOf;    // ..
+    RenderObjectVector      sorted;     // the output list
+    int                     window;     // how many groups back an object may move
+    long                    keyChangesBefore, keyChangesAfter;     // stats for the last sort
+
+public:
+    RenderListSorter();
+    static void Boost();
+
+    RenderObjectVectorPtr Sort(RenderObjectVectorPtr renderables, const glm::mat4 &projView);
+
+    int  GetWindow()                    { return window; }
+    void SetWindow(int w)               { window = w < 1 ? 1 : w; }
+    long GetKeyChangesBefore()          { return keyChangesBefore; }
+    long GetKeyChangesAfter()           { return keyChangesAfter; }
+};
+typedef boost::shared_ptr<RenderListSorter> RenderListSorterPtr;
+
+#endif
@@ -0,0 +1,257 @@
+/* -----------------------------------------------------------------------------------
+   -- renderStats.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <algorithm>
+
+using namespace boost::python;
+using namespace std;
+
+#include "renderStats.hpp"
+
+std::atomic<bool> RenderStats::enabled(false);
+std::atomic<bool> RenderStats::overlay(false);
+std::atomic<bool> RenderStats::resync(false);
+RenderStatBlock RenderStats::blocks[RENDER_STATS_MAX_THREADS];
+RenderStatBlock RenderStats::sharedBlock(true);
+std::atomic<int> RenderStats::blockCount(0);
+uint64_t RenderStats::lastTotals[RS_COUNT];
+RenderStats::Frame RenderStats::history[RENDER_STATS_HISTORY];
+std::atomic<uint64_t> RenderStats::frames(0);
+std::atomic<uint64_t> RenderStats::firstFrame(0);
+std::chrono::steady_clock::time_point RenderStats::frameStart;
+
+// -----------------------------------------------------------------------------------
+void RenderStats::Boost()
+{
+    class_ < RenderStats, boost::noncopyable >("RenderStats", "Per frame render counters and phase times", no_init)
+        .def("GetEnabled", &RenderStats::Enabled)
+        .staticmethod("GetEnabled")
+        .def("SetEnabled", &RenderStats::SetEnabled, "Count from the next frame")
+        .staticmethod("SetEnabled")
+        .def("GetOverlay", &RenderStats::GetOverlay)
+        .staticmethod("GetOverlay")
+        .def("SetOverlay", &RenderStats::SetOverlay, "Draw the phase times of the history on screen, needs SetEnabled")
+        .staticmethod("SetOverlay")
+        .def("GetLast", &RenderStats::GetLast, "The last frame, {stat: value}, the phases in ms")
+        .staticmethod("GetLast")
+        .def("GetHistory", &RenderStats::GetHistory, "GetHistory(count) the last count frames oldest first, 0 for all that are kept")
+        .staticmethod("GetHistory")
+        .def("GetAverage", &RenderStats::GetAverage, "GetAverage(count) the last count frames averaged, 0 for all that are kept")
+        .staticmethod("GetAverage")
+        .def("Reset", &RenderStats::Reset, "Forget the history")
+        .staticmethod("Reset")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+// The totals keep running while off, so EndFrame takes them again before the first
+// frame it keeps.
+void RenderStats::SetEnabled(bool e)
+{
+    if (e && !Enabled())
+    {
+        resync = true;
+    }
+    enabled = e;
+}
+
+// -----------------------------------------------------------------------------------
+// Once per thread. The slots are never given back, threads come and go rarely.
+RenderStatBlock *RenderStats::TakeBlock()
+{
+    int index = blockCount.fetch_add(1, std::memory_order_acq_rel);
+    if (index >= RENDER_STATS_MAX_THREADS)
+    {
+        return &sharedBlock;
+    }
+    return &blocks[index];
+}
+
+// -----------------------------------------------------------------------------------
+void RenderStats::Totals(uint64_t *totals)
+{
+    int count = std::min(blockCount.load(std::memory_order_acquire), RENDER_STATS_MAX_THREADS);
+    for (int s = 0; s < RS_COUNT; ++s)
+    {
+        totals[s] = sharedBlock.values[s].load(std::memory_order_relaxed);
+        for (int i = 0; i < count; ++i)
+        {
+            totals[s] += blocks[i].values[s].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// The frame time is measured here rather than counted, from the last EndFrame.
+void RenderStats::EndFrame()
+{
+    if (!Enabled())
+    {
+        return;
+    }
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    uint64_t totals[RS_COUNT];
+    Totals(totals);
+    if (resync.exchange(false))
+    {
+        std::copy(totals, totals + RS_COUNT, lastTotals);
+        frameStart = now;
+        return;
+    }
+
+    uint64_t frame = frames.load(std::memory_order_relaxed);
+    Frame &slot = history[frame % RENDER_STATS_HISTORY];
+    uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+    slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.frame.store(frame, std::memory_order_relaxed);
+    for (int s = 0; s < RS_COUNT; ++s)
+    {
+        slot.values[s].store(totals[s] - lastTotals[s], std::memory_order_relaxed);
+        lastTotals[s] = totals[s];
+    }
+    slot.values[RS_PHASE_FRAME].store(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart).count(), std::memory_order_relaxed);
+    slot.sequence.store(sequence + 2, std::memory_order_release);
+    frameStart = now;
+    frames.store(frame + 1, std::memory_order_release);
+}
+
+// -----------------------------------------------------------------------------------
+// False if the slot has moved on to a newer frame since.
+bool RenderStats::ReadFrame(uint64_t frame, uint64_t *values)
+{
+    Frame &slot = history[frame % RENDER_STATS_HISTORY];
+    while (true)
+    {
+        uint32_t before = slot.sequence.load(std::memory_order_acquire);
+        if (before & 1)
+        {
+            continue;
+        }
+        uint64_t held = slot.frame.load(std::memory_order_relaxed);
+        for (int s = 0; s < RS_COUNT; ++s)
+        {
+            values[s] = slot.values[s].load(std::memory_order_relaxed);
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.sequence.load(std::memory_order_relaxed) == before)
+        {
+            return held == frame;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+int RenderStats::GetFrameCount()
+{
+    uint64_t count = frames.load(std::memory_order_acquire) - firstFrame.load(std::memory_order_relaxed);
+    return std::min<uint64_t>(count, RENDER_STATS_HISTORY);
+}
+
+// -----------------------------------------------------------------------------------
+bool RenderStats::GetFrame(int age, uint64_t *values)
+{
+    if (age < 0 || age >= GetFrameCount())
+    {
+        return false;
+    }
+    return ReadFrame(frames.load(std::memory_order_acquire) - 1 - age, values);
+}
+
+// -----------------------------------------------------------------------------------
+const char *RenderStats::StatName(int stat)
+{
+    static const char *names[RS_COUNT] = {
+        "nodesVisited", "collected", "culled", "drawCalls", "textureBinds", "uniformUploads", "commands",
+        "commandsMs", "transformMs", "collectMs", "buildMs", "waitMs", "renderMs", "frameMs" };
+    return stat >= 0 && stat < RS_COUNT ? names[stat] : "unknown";
+}
+
+// -----------------------------------------------------------------------------------
+dict RenderStats::FrameDict(const uint64_t *values, uint64_t frame)
+{
+    dict d;
+    d["frame"] = frame;
+    for (int s = 0; s < RS_COUNT; ++s)
+    {
+        if (s >= RS_FIRST_PHASE)
+        {
+            d[StatName(s)] = values[s] / 1000000.0;
+        }
+        else
+        {
+            d[StatName(s)] = values[s];
+        }
+    }
+    return d;
+}
+
+// -----------------------------------------------------------------------------------
+dict RenderStats::GetLast()
+{
+    list last = GetHistory(1);
+    return len(last) ? dict(last[0]) : dict();
+}
+
+// -----------------------------------------------------------------------------------
+// Frames overwritten while we read are left out.
+list RenderStats::GetHistory(int count)
+{
+    uint64_t end = frames.load(std::memory_order_acquire);
+    int kept = GetFrameCount();
+    if (count <= 0 || count > kept)
+    {
+        count = kept;
+    }
+    list result;
+    uint64_t values[RS_COUNT];
+    for (uint64_t frame = end - count; frame < end; ++frame)
+    {
+        if (ReadFrame(frame, values))
+        {
+            result.append(FrameDict(values, frame));
+        }
+    }
+    return result;
+}
+
+// -----------------------------------------------------------------------------------
+dict RenderStats::GetAverage(int count)
+{
+    uint64_t end = frames.load(std::memory_order_acquire);
+    int kept = GetFrameCount();
+    if (count <= 0 || count > kept)
+    {
+        count = kept;
+    }
+    double sums[RS_COUNT] = {0};
+    int read = 0;
+    uint64_t values[RS_COUNT];
+    for (uint64_t frame = end - count; frame < end; ++frame)
+    {
+        if (ReadFrame(frame, values))
+        {
+            for (int s = 0; s < RS_COUNT; ++s)
+            {
+                sums[s] += values[s];
+            }
+            ++read;
+        }
+    }
+    dict d;
+    d["frames"] = read;
+    for (int s = 0; s < RS_COUNT; ++s)
+    {
+        double average = read > 0 ? sums[s] / read : 0.0;
+        d[StatName(s)] = s >= RS_FIRST_PHASE ? average / 1000000.0 : average;
+    }
+    return d;
+}
+
+// -----------------------------------------------------------------------------------
+void RenderStats::Reset()
+{
+    firstFrame = frames.load(std::memory_order_acquire);
+}
@@ -0,0 +1,179 @@
+/* -----------------------------------------------------------------------------------
+   -- renderStats.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __RENDER_STATS_HPP__
+#define __RENDER_STATS_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <chrono>
+#include <boost/python.hpp>
+
+// threads that get their own counters, the rest share one
+#define RENDER_STATS_MAX_THREADS 32
+// frames kept in the history
+#define RENDER_STATS_HISTORY 120
+
+// -----------------------------------------------------------------------------------
+// The counters and phase times of a frame. The phases are nanoseconds, the worker
+// phases are summed over the workers, so they can add up to more than the frame.
+enum RenderStat
+{
+    RS_NODES_VISITED,       // objects CollectRenderables was called on
+    RS_COLLECTED,           // .. that went into the render list
+    RS_CULLED,              // collected but outside the view
+    RS_DRAW_CALLS,          // glDrawElements and glDrawElementsInstanced
+    RS_TEXTURE_BINDS,       // glBindTexture reaching the driver
+    RS_UNIFORM_UPLOADS,     // glUniform* reaching the driver
+    RS_COMMANDS,            // CommandObjects applied
+    RS_PHASE_COMMANDS,      // draining the command queue
+    RS_PHASE_TRANSFORM,     // workers
+    RS_PHASE_COLLECT,       // ..
+    RS_PHASE_BUILD,         // .. culling and building the packets
+    RS_PHASE_WAIT,          // render thread, waiting on the workers
+    RS_PHASE_RENDER,        // .. drawing
+    RS_PHASE_FRAME,         // .. from the end of the last frame to the end of this one
+    RS_COUNT
+};
+#define RS_FIRST_PHASE RS_PHASE_COMMANDS
+
+// -----------------------------------------------------------------------------------
+// One thread's running totals. Only the thread writes them, so an add is a relaxed
+// load and store rather than a locked add; EndFrame reads them from the render
+// thread. The block threads share when they run out uses real atomic adds. Blocks
+// are a cache line apart.
+struct alignas(64) RenderStatBlock
+{
+    std::atomic<uint64_t>   values[RS_COUNT];
+    bool                    shared;
+    RenderStatBlock(bool _shared = false) : shared(_shared)
+    {
+        for (int i = 0; i < RS_COUNT; ++i)
+        {
+            values[i] = 0;
+        }
+    }
+
+    void Add(RenderStat stat, uint64_t n)
+    {
+        if (shared)
+        {
+            values[stat].fetch_add(n, std::memory_order_relaxed);
+            return;
+        }
+        values[stat].store(values[stat].load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+};
+
+// -----------------------------------------------------------------------------------
+// Per frame counters for the render loop, where the time goes and how much work
+// reached the driver. Counting is off by default, then RENDER_STAT_INC is one relaxed
+// load and a branch. When on, each thread adds to its own block, taken the first time
+// it counts, so the workers collecting in parallel never share a cache line or a lock.
+//
+// EndFrame, on the render thread once the frame is submitted, sums the blocks and
+// keeps the difference from the last frame in a ring of the last
+// RENDER_STATS_HISTORY frames. Python reads the ring with GetHistory, each slot has a
+// sequence number so a frame being written while it is read is read again.
+//
+//      RENDER_STAT_INC(RS_DRAW_CALLS)
+//      { RENDER_PHASE(RS_PHASE_COMMANDS) drain the command queue }
+//
+// A counter added on a worker after EndFrame read it lands in the next frame.
+class RenderStats
+{
+private:
+    struct Frame
+    {
+        std::atomic<uint32_t>   sequence;   // odd while being written
+        std::atomic<uint64_t>   frame;      // the frame number
+        std::atomic<uint64_t>   values[RS_COUNT];
+    };
+    static std::atomic<bool>    enabled;
+    static std::atomic<bool>    overlay;    // RenderStatsOverlay draws
+    static std::atomic<bool>    resync;     // turned on, EndFrame starts counting from now
+    static RenderStatBlock      blocks[RENDER_STATS_MAX_THREADS];
+    static RenderStatBlock      sharedBlock;// for the threads past those
+    static std::atomic<int>     blockCount; // blocks taken
+    static uint64_t             lastTotals[RS_COUNT];  // render thread, the sums at the last EndFrame
+    static Frame                history[RENDER_STATS_HISTORY];
+    static std::atomic<uint64_t> frames;    // frames ended, all time
+    static std::atomic<uint64_t> firstFrame;// the oldest frame the history reports, moved by Reset
+    static std::chrono::steady_clock::time_point frameStart;   // render thread
+
+    static RenderStatBlock *TakeBlock();
+    static void Totals(uint64_t *totals);
+    static bool ReadFrame(uint64_t frame, uint64_t *values);
+    static boost::python::dict FrameDict(const uint64_t *values, uint64_t frame);
+
+public:
+    static void Boost();
+    static bool Enabled()                       { return enabled.load(std::memory_order_relaxed); }
+    static void SetEnabled(bool e);
+    static bool GetOverlay()                    { return overlay.load(std::memory_order_relaxed); }
+    static void SetOverlay(bool o)              { overlay = o; }
+
+    static RenderStatBlock *ThreadBlock()       // the calling thread's counters
+    {
+        static thread_local RenderStatBlock *block = NULL;
+        if (!block)
+        {
+            block = TakeBlock();
+        }
+        return block;
+    }
+    static void Add(RenderStat stat, uint64_t n)
+    {
+        if (Enabled())
+        {
+            ThreadBlock()->Add(stat, n);
+        }
+    }
+
+    static void EndFrame();                     // render thread, after the frame is submitted
+    static int  GetFrameCount();                // frames in the history
+    static bool GetFrame(int age, uint64_t *values);    // 0 the last frame, render thread for the overlay
+    static const char *StatName(int stat);
+
+    static boost::python::dict GetLast();               // the last frame, python
+    static boost::python::list GetHistory(int count);   // .. the last count frames, oldest first. 0 for all
+    static boost::python::dict GetAverage(int count);   // .. averaged
+    static void Reset();
+};
+
+// -----------------------------------------------------------------------------------
+// Adds the time to the end of its scope to a phase.
+class RenderPhaseTimer
+{
+private:
+    RenderStat  phase;
+    bool        timing;
+    std::chrono::steady_clock::time_point start;
+
+public:
+    RenderPhaseTimer(RenderStat _phase) :
+        phase(_phase)
+      , timing(RenderStats::Enabled())
+    {
+        if (timing)
+        {
+            start = std::chrono::steady_clock::now();
+        }
+    }
+    ~RenderPhaseTimer()
+    {
+        if (timing)
+        {
+            RenderStats::Add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+        }
+    }
+};
+
+#define RENDER_STAT_ADD(stat, n) RenderStats::Add(stat, n);
+#define RENDER_STAT_INC(stat) RenderStats::Add(stat, 1);
+#define RENDER_PHASE_CAT2(a, b) a##b
+#define RENDER_PHASE_CAT(a, b) RENDER_PHASE_CAT2(a, b)
+#define RENDER_PHASE(phase) RenderPhaseTimer RENDER_PHASE_CAT(renderPhase, __LINE__)(phase);
+
+#endif
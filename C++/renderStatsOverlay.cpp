@@ -0,0 +1,240 @@
+/* -----------------------------------------------------------------------------------
+   -- renderStatsOverlay.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <algorithm>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "renderStatsOverlay.hpp"
+#include "utils.hpp"
+
+// where the graph goes, in NDC, and the frame time at the top of it
+#define OVERLAY_LEFT        -0.98f
+#define OVERLAY_BOTTOM      -0.98f
+#define OVERLAY_WIDTH       0.6f
+#define OVERLAY_HEIGHT      0.3f
+#define OVERLAY_TOP_MS      40.f
+
+#define OVERLAY_FLOATS_PER_VERTEX 6
+
+static const char * overlayVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 vertPosition;\n"
+    "layout(location = 1) in vec4 vertColour;\n"
+    "out vec4 fragColour;\n"
+    "void main()\n"
+    "{\n"
+    "    fragColour = vertColour;\n"
+    "    gl_Position = vec4(vertPosition, 0.0, 1.0);\n"
+    "}\n";
+
+static const char * overlayFragmentShader =
+    "#version 330 core\n"
+    "in vec4 fragColour;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    color = fragColour;\n"
+    "}\n";
+
+// the stack, bottom up, then the background and the fps lines
+static const GLfloat commandsColour[4] = { 0.9f, 0.6f, 0.1f, 0.9f };
+static const GLfloat waitColour[4]     = { 0.9f, 0.2f, 0.2f, 0.9f };
+static const GLfloat renderColour[4]   = { 0.2f, 0.7f, 0.3f, 0.9f };
+static const GLfloat otherColour[4]    = { 0.5f, 0.5f, 0.6f, 0.9f };
+static const GLfloat backColour[4]     = { 0.f,  0.f,  0.f,  0.5f };
+static const GLfloat lineColour[4]     = { 1.f,  1.f,  1.f,  0.6f };
+
+// -----------------------------------------------------------------------------------
+static GLuint CompileShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("ERROR: RenderStatsOverlay shader compile failed:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// -----------------------------------------------------------------------------------
+RenderStatsOverlay::RenderStatsOverlay() :
+    program(0)
+  , vaoID(0)
+  , vbo(0)
+  , vertices()
+{
+    vertices.reserve((RENDER_STATS_HISTORY * 4 + 3) * 6 * OVERLAY_FLOATS_PER_VERTEX);
+}
+
+// -----------------------------------------------------------------------------------
+RenderStatsOverlay::~RenderStatsOverlay()
+{
+}
+
+// -----------------------------------------------------------------------------------
+bool RenderStatsOverlay::BuildProgram()
+{
+    GLuint vs = CompileShader(GL_VERTEX_SHADER, overlayVertexShader);
+    GLuint fs = CompileShader(GL_FRAGMENT_SHADER, overlayFragmentShader);
+    if (vs == 0 || fs == 0)
+    {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return false;
+    }
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        printf("ERROR: RenderStatsOverlay shader link failed:\n%s\n", log);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+bool RenderStatsOverlay::Init()
+{
+    GLFW_THREAD_CHECK();
+    if (!BuildProgram())
+    {
+        return false;
+    }
+    GLint sceneVAO = 0;
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &sceneVAO);
+    glGenVertexArrays(1, &vaoID);
+    glBindVertexArray(vaoID);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.capacity() * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, OVERLAY_FLOATS_PER_VERTEX * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, OVERLAY_FLOATS_PER_VERTEX * sizeof(GLfloat), (void*)(2 * sizeof(GLfloat)));
+    glBindVertexArray(sceneVAO);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GL_CHECK_ERROR("GL Error: RenderStatsOverlay::Init")
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+void RenderStatsOverlay::Shutdown()
+{
+    if (vbo) glDeleteBuffers(1, &vbo);
+    if (vaoID) glDeleteVertexArrays(1, &vaoID);
+    if (program) glDeleteProgram(program);
+    vbo = vaoID = program = 0;
+}
+
+// -----------------------------------------------------------------------------------
+void RenderStatsOverlay::Quad(float x0, float y0, float x1, float y1, const GLfloat *colour)
+{
+    const float corners[6][2] = { {x0, y0}, {x1, y0}, {x1, y1}, {x1, y1}, {x0, y1}, {x0, y0} };
+    for (int i = 0; i < 6; ++i)
+    {
+        vertices.push_back(corners[i][0]);
+        vertices.push_back(corners[i][1]);
+        vertices.insert(vertices.end(), colour, colour + 4);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Bars past the top are clipped, the frame they belong to was over OVERLAY_TOP_MS.
+void RenderStatsOverlay::Draw()
+{
+    if (program == 0 || !RenderStats::GetOverlay() || !RenderStats::Enabled())
+    {
+        return;
+    }
+    GLFW_THREAD_CHECK();
+    const float barWidth = OVERLAY_WIDTH / RENDER_STATS_HISTORY;
+    const float scale = OVERLAY_HEIGHT / (OVERLAY_TOP_MS * 1000000.f);
+    const float top = OVERLAY_BOTTOM + OVERLAY_HEIGHT;
+
+    vertices.clear();
+    Quad(OVERLAY_LEFT, OVERLAY_BOTTOM, OVERLAY_LEFT + OVERLAY_WIDTH, top, backColour);
+    uint64_t values[RS_COUNT];
+    int count = RenderStats::GetFrameCount();
+    for (int age = 0; age < count; ++age)
+    {
+        if (!RenderStats::GetFrame(age, values))
+        {
+            continue;
+        }
+        float x1 = OVERLAY_LEFT + OVERLAY_WIDTH - age * barWidth;
+        float x0 = x1 - barWidth * 0.8f;
+        const RenderStat stack[3] = { RS_PHASE_COMMANDS, RS_PHASE_WAIT, RS_PHASE_RENDER };
+        const GLfloat *colours[3] = { commandsColour, waitColour, renderColour };
+        float y = OVERLAY_BOTTOM;
+        uint64_t stacked = 0;
+        for (int i = 0; i < 3 && y < top; ++i)
+        {
+            float y1 = std::min(top, y + values[stack[i]] * scale);
+            Quad(x0, y, x1, y1, colours[i]);
+            stacked += values[stack[i]];
+            y = y1;
+        }
+        if (values[RS_PHASE_FRAME] > stacked && y < top)
+        {
+            Quad(x0, y, x1, std::min(top, y + (values[RS_PHASE_FRAME] - stacked) * scale), otherColour);
+        }
+    }
+    const float lineMs[2] = { 1000.f / 60.f, 1000.f / 30.f };
+    for (int i = 0; i < 2; ++i)
+    {
+        float y = OVERLAY_BOTTOM + lineMs[i] * 1000000.f * scale;
+        Quad(OVERLAY_LEFT, y, OVERLAY_LEFT + OVERLAY_WIDTH, y + 0.003f, lineColour);
+    }
+
+    GLint sceneProgram = 0, sceneVAO = 0;
+    glGetIntegerv(GL_CURRENT_PROGRAM, &sceneProgram);
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &sceneVAO);
+    GLboolean blend = glIsEnabled(GL_BLEND);
+    GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+    GLint blendSrc = GL_ONE, blendDst = GL_ZERO;
+    glGetIntegerv(GL_BLEND_SRC_RGB, &blendSrc);
+    glGetIntegerv(GL_BLEND_DST_RGB, &blendDst);
+
+    glUseProgram(program);
+    glBindVertexArray(vaoID);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, vertices.capacity() * sizeof(GLfloat), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(GLfloat), &vertices[0]);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glDisable(GL_DEPTH_TEST);
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / OVERLAY_FLOATS_PER_VERTEX);
+    GL_CHECK_ERROR("GL Error: RenderStatsOverlay::Draw")
+
+    glBlendFunc(blendSrc, blendDst);
+    if (!blend) glDisable(GL_BLEND);
+    if (depthTest) glEnable(GL_DEPTH_TEST);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(sceneVAO);
+    glUseProgram(sceneProgram);
+}
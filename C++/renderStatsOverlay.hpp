@@ -0,0 +1,46 @@
+/* -----------------------------------------------------------------------------------
+   -- renderStatsOverlay.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __RENDER_STATS_OVERLAY_HPP__
+#define __RENDER_STATS_OVERLAY_HPP__
+#include <stdio.h>
+#include <vector>
+#include "sdtGraphics.hpp"
+#include "renderStats.hpp"
+
+class RenderStatsOverlay;
+typedef boost::shared_ptr<RenderStatsOverlay> RenderStatsOverlayPtr;
+
+// -----------------------------------------------------------------------------------
+// Draws the RenderStats history in the bottom left of the screen, a bar per frame,
+// newest on the right, stacked from the render thread's phases: commands, waiting on
+// the workers, drawing, and the rest of the frame. The lines mark 60 and 30 fps.
+// Only draws while RenderStats has the overlay on. Its own draws aren't counted.
+//
+// Per frame, on the render thread:
+//      pipeline->Submit(batcher, &settings)
+//      overlay->Draw()
+//
+// The program, vertex array and blending are put back as they were, so a
+// GLStateCache stays valid. Render thread only.
+class RenderStatsOverlay
+{
+private:
+    GLuint  program;                    // flat coloured triangles, in NDC
+    GLuint  vaoID, vbo;
+    std::vector<GLfloat> vertices;      // x, y, r, g, b, a
+
+    bool    BuildProgram();
+    void    Quad(float x0, float y0, float x1, float y1, const GLfloat *colour);
+
+public:
+    RenderStatsOverlay();
+    ~RenderStatsOverlay();
+
+    bool Init();                        // create the GL objects, needs a current context
+    void Shutdown();                    // release the GL objects
+    void Draw();                        // after the frame is submitted
+};
+
+#endif
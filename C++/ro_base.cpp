@@ -23,6 +23,14 @@ using namespace std;
 #include "viewManager.hpp"
 #include "commandObject.hpp"
 #include "utils.hpp"
+#include "damageTracker.hpp"
+#include "sceneBinary.hpp"
+#include "nodeBatch.hpp"
+#include "nodeArrays.hpp"
+#include "gilGuard.hpp"
+#include "deltaStream.hpp"
+#include "memoryAccounting.hpp"
+#include "renderCore.hpp"
 
 
 // -----------------------------------------------------------------------------------
@@ -54,6 +62,8 @@ static boost::python::object stringList_as_list(stringList const& self)
     return l;
 }
 
+std::atomic<unsigned long> RO_Base::structureVersion(0);
+
 // -----------------------------------------------------------------------------------
 // The scene object that will operate in the render thread, the proxy (def below)
 // will run in the pyhton thread
@@ -70,14 +80,60 @@ RO_Base::RO_Base(Scene * _scene) : BaseCommandObject()
     , INIT_PROP_DEF(alpha, 1.0f)
     , INIT_LIST_DEF(renderSet, stringList(1, "**ALL**"))
     , INIT_PROP_DEF(visibleState, "")
+    , worldAlpha(1.f)
+    , parentNode()
     , aabb()
+    , accountedBytes(MemoryAccounting::Alloc(MEM_RENDER_OBJECTS, sizeof(RO_Base)))
+    , pyRenderSetBytes(0)
+    , cRenderSetBytes(0)
 
 {
     renderSet.SetKeepSorted(1);
 }
 // -----------------------------------------------------------------------------------
 RO_Base::~RO_Base()
-{}
+{
+    // any cached render list could still be holding this pointer.
+    MarkStructureDirty();
+    MemoryAccounting::Free(MEM_RENDER_OBJECTS, accountedBytes);
+    MemoryAccounting::Free(MEM_RENDER_SETS, pyRenderSetBytes);
+    MemoryAccounting::Free(MEM_RENDER_SETS, cRenderSetBytes);
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Base::AccountSize(size_t bytes)
+{
+    MemoryAccounting::Resize(MEM_RENDER_OBJECTS, accountedBytes, bytes);
+}
+
+// -----------------------------------------------------------------------------------
+// The list is held twice, the python side and the C side, each is measured and kept
+// on its own, by the thread that owns it. Loads fill the python side, commands the
+// C side.
+void RO_Base::AccountRenderSet(bool pySide)
+{
+    long long &accounted = pySide ? pyRenderSetBytes : cRenderSetBytes;
+    if (!MemoryAccounting::Enabled() && accounted == 0)
+    {
+        return;
+    }
+    long long bytes = 0;
+    if (pySide)
+    {
+        PYFor_const(renderSet, it)
+        {
+            bytes += sizeof(std::string) + MemoryAccounting::StringBytes(*it);
+        }
+    }
+    else
+    {
+        for (renderSetType::const_iterator it = renderSet.cbegin(); it != renderSet.cend(); ++it)
+        {
+            bytes += sizeof(std::string) + MemoryAccounting::StringBytes(*it);
+        }
+    }
+    MemoryAccounting::Resize(MEM_RENDER_SETS, accounted, bytes);
+}
 
 // -----------------------------------------------------------------------------------
 void RO_Base::Boost(void)
@@ -124,6 +180,7 @@ void RO_Base::Boost(void)
     ;
     END_BOOST_DUPLICATE_GUARD()
 
+    BoostRenderCore();
 }
 
 // -----------------------------------------------------------------------------------
@@ -153,19 +210,177 @@ python::object RO_Base::GetSelf()
 }
 
 // -----------------------------------------------------------------------------------
+// Changes that alter what gets collected, or the order it is drawn in, invalidate
+// the cached render lists. Position only counts when the depth changes.
 void RO_Base::ApplyCommand(CommandObjectPtr cmd)
 {
-    if (enabled.ApplyCommand(cmd) == 1){} else
+    if ((cmd->GetID() == attachID || cmd->GetID() == detachID || cmd->GetID() == arrangeID) && cmd->GetCmd() == CMD_STD_UPDATE)
+    {
+        RO_BaseVector children = cmd->Get1<RO_BaseVector>();
+        for (RO_BaseVector::iterator it = children.begin(); it != children.end(); ++it)
+        {
+            if (cmd->GetID() == detachID)
+            {
+                RemoveChild(*it);
+                continue;
+            }
+            if (cmd->GetID() == arrangeID)
+            {
+                RemoveChild(*it);
+            }
+            if (!AddChild(*it))
+            {
+                printf("ERROR: %s doesn't override InsertChild, its children are left as they were\n", name.c_str());
+                break;
+            }
+        }
+        if (cmd->GetID() == detachID)
+        {
+            PyReleaseQueue::Defer(children);    // we may hold the last reference now
+        }
+        MarkStructureDirty();
+        if (DamageTracker::GetInstance())
+        {
+            DamageTracker::GetInstance()->DamageAll();
+        }
+        return;
+    }
+    float oldDepth = position().z;
+    if (enabled.ApplyCommand(cmd) == 1){ MarkStructureDirty(); } else
     if (rotation.ApplyCommand(cmd) == 1){} else
     if (scaleX.ApplyCommand(cmd) == 1){} else
     if (scaleY.ApplyCommand(cmd) == 1){} else
-    if (position.ApplyCommand(cmd) == 1){} else
+    if (position.ApplyCommand(cmd) == 1){ if (position().z != oldDepth) MarkStructureDirty(); } else
     if (alpha.ApplyCommand(cmd) == 1){} else
-    if (renderSet.ApplyCommand(cmd) == 1){} else
+    if (renderSet.ApplyCommand(cmd) == 1){ MarkStructureDirty(); AccountRenderSet(false); } else
     if (visibleState.ApplyCommand(cmd) == 1){} else
     ; // the end of the apply chain.
 }
 
+// -----------------------------------------------------------------------------------
+// Every container adds and removes its children through these, so a cached render
+// list never outlives a membership change.
+bool RO_Base::AddChild(RO_BasePtr child)
+{
+    if (!InsertChild(child))
+    {
+        return false;
+    }
+    Adopt(child);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Base::Adopt(RO_BasePtr child)
+{
+    child->parentNode = shared_from_this();
+    MarkStructureDirty();
+}
+
+// -----------------------------------------------------------------------------------
+bool RO_Base::RemoveChild(RO_BasePtr child)
+{
+    if (!EraseChild(child))
+    {
+        return false;
+    }
+    if (child->GetParent().get() == this)
+    {
+        child->parentNode.reset();
+    }
+    MarkStructureDirty();
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// The children were built under a BulkLoad, so their properties are already on the C
+// side, all that is left is to link them in on the render thread.
+void RO_Base::Attach(RO_BaseVector children)
+{
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    cmd->SetID(attachID);
+    cmd->Set1<RO_BaseVector>(children);
+    StaticQueueCommand(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Base::Detach(RO_BaseVector children)
+{
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    cmd->SetID(detachID);
+    cmd->Set1<RO_BaseVector>(children);
+    StaticQueueCommand(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+// Containers only append, so a child goes to its place by coming out and going back
+// in. Pass everything from the first child out of place on, new children included.
+void RO_Base::Arrange(RO_BaseVector children)
+{
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    cmd->SetID(arrangeID);
+    cmd->Set1<RO_BaseVector>(children);
+    StaticQueueCommand(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Base::StageUpdate(const NodeUpdate &update)
+{
+    if (update.fields & NUF_ENABLED)        enabled.pyStage(update.enabled);
+    if (update.fields & NUF_ROTATION)       rotation.pyStage(update.rotation);
+    if (update.fields & NUF_SCALEX)         scaleX.pyStage(update.scaleX);
+    if (update.fields & NUF_SCALEY)         scaleY.pyStage(update.scaleY);
+    if (update.fields & NUF_POSITION)       position.pyStage(update.position);
+    if (update.fields & NUF_ALPHA)          alpha.pyStage(update.alpha);
+    if (update.fields & NUF_VISIBLESTATE)   visibleState.pyStage(update.visibleState);
+}
+
+// -----------------------------------------------------------------------------------
+// The same invalidation as ApplyCommand, for the values in one update.
+void RO_Base::ApplyUpdate(const NodeUpdate &update)
+{
+    float oldDepth = position().z;
+    if ((update.fields & NUF_ENABLED) && enabled.cApply(update.enabled))
+    {
+        MarkStructureDirty();
+    }
+    if (update.fields & NUF_ROTATION)       rotation.cApply(update.rotation);
+    if (update.fields & NUF_SCALEX)         scaleX.cApply(update.scaleX);
+    if (update.fields & NUF_SCALEY)         scaleY.cApply(update.scaleY);
+    if ((update.fields & NUF_POSITION) && position.cApply(update.position) && position().z != oldDepth)
+    {
+        MarkStructureDirty();
+    }
+    if (update.fields & NUF_ALPHA)          alpha.cApply(update.alpha);
+    if (update.fields & NUF_VISIBLESTATE)   visibleState.cApply(update.visibleState);
+}
+
+// -----------------------------------------------------------------------------------
+// Only a command that really changed a value damages the screen, setting a property
+// to what it already was doesn't.
+void RO_Base::CommandApplied(void)
+{
+    if (DeltaStream::Active() && DeltaStream::GetInstance())
+    {
+        DeltaStream::GetInstance()->Record(this);
+    }
+    if (DamageTracker::GetInstance() && TakeDamage())
+    {
+        DamageTracker::Damage(this);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Every bit is taken, so no short circuit. The change bits are left alone.
+bool RO_Base::TakeDamage()
+{
+    return enabled.takeDamage() | rotation.takeDamage() | scaleX.takeDamage() | scaleY.takeDamage() |
+           position.takeDamage() | alpha.takeDamage() | visibleState.takeDamage();
+}
+
 // -----------------------------------------------------------------------------------
 glm::mat4 RO_Base::Transform(glm::mat4 parentsTransform)
 {
@@ -176,9 +391,43 @@ glm::mat4 RO_Base::Transform(glm::mat4 parentsTransform)
     S = glm::scale(I, glm::vec3(scaleX(), scaleY(), 1.0));
 
     currentTransform = parentsTransform * T * R * S;
+    worldAlpha = ParentAlpha() * alpha();
     return currentTransform;
 }
 
+// -----------------------------------------------------------------------------------
+// The parent is transformed before its children, so its world alpha is this frame's.
+RO_BasePtr RO_Base::GetParent()
+{
+    return boost::static_pointer_cast<RO_Base>(parentNode.lock());
+}
+
+// -----------------------------------------------------------------------------------
+float RO_Base::ParentAlpha()
+{
+    RO_BasePtr parent = GetParent();
+    return parent ? parent->worldAlpha : 1.f;
+}
+
+// -----------------------------------------------------------------------------------
+// For a subtree transformed on its own, a FramePipeline root below the top. Each
+// parent only gets its own transform, not a container's, so their other children are
+// left for their own pass. Render thread, while nothing else is transforming.
+glm::mat4 RO_Base::TransformAncestors()
+{
+    std::vector<RO_Base *> chain;
+    for (RO_BasePtr parent = GetParent(); parent; parent = parent->GetParent())
+    {
+        chain.push_back(parent.get());
+    }
+    glm::mat4 world(1.f);
+    for (std::vector<RO_Base *>::reverse_iterator it = chain.rbegin(); it != chain.rend(); ++it)
+    {
+        world = (*it)->RO_Base::Transform(world);
+    }
+    return world;
+}
+
 // -----------------------------------------------------------------------------------
 void RO_Base::PyTransform(glm::mat4 parentsTransform)
 {
@@ -231,7 +480,10 @@ bool RO_Base::Collectable(stringList &list)
 RO_IteratorPtr RO_Base::Find(std::string searchName)
 {
      RO_Iterator *itr = new RO_Iterator();
-     FindItems(searchName, itr);
+     {
+         ScopedGILRelease unlocked;     // the walk only copies pointers
+         FindItems(searchName, itr);
+     }
      return boost::shared_ptr<RO_Iterator>(itr);
 }
 
@@ -286,10 +538,33 @@ void RO_Base::DecodeYaml(YAML::Node node)
         {
             renderSet.push_back( it->as<string>() );
         }
+        AccountRenderSet(true);
     }
     // renderSet << node;
 }
 
+// -----------------------------------------------------------------------------------
+// Only the fields the YAML had are set, the rest keep their defaults like DecodeYaml.
+void RO_Base::DecodeBinary(SceneBinary &binary, const SceneBinaryNode &node)
+{
+    if (node.fields & SBF_NAME)         name = binary.GetString(node.name);
+    if (node.fields & SBF_ENABLED)      enabled.pySet(node.enabled);
+    if (node.fields & SBF_ROTATION)     rotation.pySet(node.rotation);
+    if (node.fields & SBF_SCALEX)       scaleX.pySet(node.scaleX);
+    if (node.fields & SBF_SCALEY)       scaleY.pySet(node.scaleY);
+    if (node.fields & SBF_POSITION)     position.pySet(glm::vec3(node.position[0], node.position[1], node.position[2]));
+    if (node.fields & SBF_ALPHA)        alpha.pySet(node.alpha);
+    if (node.fields & SBF_VISIBLESTATE) visibleState.pySet(binary.GetString(node.visibleState));
+    if (node.fields & SBF_RENDERSET)
+    {
+        for (uint32_t i = 0; i < node.renderSetCount; ++i)
+        {
+            renderSet.push_back(binary.GetString(binary.GetRef(node.renderSetFirst + i)));
+        }
+        AccountRenderSet(true);
+    }
+}
+
 // -----------------------------------------------------------------------------------
 void RO_Base::DecodeMapYaml(YAML::Node node)
 {
@@ -389,5 +664,119 @@ void RO_Iterator::Boost(void)
         .def("__iter__", boost::python::range(&RO_Iterator::cbegin, &RO_Iterator::cend))
         .def("__len__", &RO_Iterator::size)
         .def("__getitem__", &RO_Iterator::getItem)
+        .def("SetProperty", &RO_Iterator::SetProperty, "Set enabled, rotation, scaleX, scaleY, position, alpha or visibleState on every item")
+        .def("OffsetPositions", &RO_Iterator::OffsetPositions, "Move every item by the offset")
+        .def("SetEnabled", &RO_Iterator::SetEnabled)
+        .def("ToggleEnabled", &RO_Iterator::ToggleEnabled)
+        .def("SetVisibleState", &RO_Iterator::SetVisibleState)
+        .def("Gather", &RO_Iterator::Gather, "positions, rotations, scales, alphas, world or aabbs of the items as an array, see NodeArrays. world and aabbs fill in after sm.WaitForRender()")
     ;
 }
+
+// -----------------------------------------------------------------------------------
+// Items already holding the values are left out, an empty batch isn't sent. The bulk
+// operations keep the GIL, they read and write the python side values, which only the
+// GIL guards, and queue the command.
+int RO_Iterator::Queue(const NodeUpdate &values)
+{
+    NodeBatchPtr batch(new NodeBatch());
+    for (RO_BaseVector::const_iterator it = items.begin(); it != items.end(); ++it)
+    {
+        RO_Base *item = it->get();
+        NodeUpdate update = values;
+        update.node = *it;
+        update.fields = 0;
+        if ((values.fields & NUF_ENABLED) && item->enabled.pyGet() != values.enabled)               update.fields |= NUF_ENABLED;
+        if ((values.fields & NUF_ROTATION) && item->rotation.pyGet() != values.rotation)            update.fields |= NUF_ROTATION;
+        if ((values.fields & NUF_SCALEX) && item->scaleX.pyGet() != values.scaleX)                  update.fields |= NUF_SCALEX;
+        if ((values.fields & NUF_SCALEY) && item->scaleY.pyGet() != values.scaleY)                  update.fields |= NUF_SCALEY;
+        if ((values.fields & NUF_POSITION) && item->position.pyGet() != values.position)            update.fields |= NUF_POSITION;
+        if ((values.fields & NUF_ALPHA) && item->alpha.pyGet() != values.alpha)                     update.fields |= NUF_ALPHA;
+        if ((values.fields & NUF_VISIBLESTATE) && item->visibleState.pyGet() != values.visibleState) update.fields |= NUF_VISIBLESTATE;
+        if (update.fields)
+        {
+            batch->Add(update);
+        }
+    }
+    return batch->Queue();
+}
+
+// -----------------------------------------------------------------------------------
+int RO_Iterator::SetProperty(std::string propName, object value)
+{
+    NodeUpdate values((RO_BasePtr()));
+    if (propName == "enabled")              { values.fields = NUF_ENABLED;      values.enabled = extract<int>(value); }
+    else if (propName == "rotation")        { values.fields = NUF_ROTATION;     values.rotation = extract<float>(value); }
+    else if (propName == "scaleX")          { values.fields = NUF_SCALEX;       values.scaleX = extract<float>(value); }
+    else if (propName == "scaleY")          { values.fields = NUF_SCALEY;       values.scaleY = extract<float>(value); }
+    else if (propName == "position")        { values.fields = NUF_POSITION;     values.position = extract<glm::vec3>(value); }
+    else if (propName == "alpha")           { values.fields = NUF_ALPHA;        values.alpha = extract<float>(value); }
+    else if (propName == "visibleState")    { values.fields = NUF_VISIBLESTATE; values.visibleState = extract<std::string>(value); }
+    else
+    {
+        printf("ERROR: RO_Iterator::SetProperty doesn't know the property '%s'\n", propName.c_str());
+        return 0;
+    }
+    return Queue(values);
+}
+
+// -----------------------------------------------------------------------------------
+int RO_Iterator::OffsetPositions(glm::vec3 offset)
+{
+    NodeBatchPtr batch(new NodeBatch());
+    for (RO_BaseVector::const_iterator it = items.begin(); offset != glm::vec3() && it != items.end(); ++it)
+    {
+        NodeUpdate update(*it);
+        update.fields = NUF_POSITION;
+        update.position = (*it)->position.pyGet() + offset;
+        batch->Add(update);
+    }
+    return batch->Queue();
+}
+
+// -----------------------------------------------------------------------------------
+int RO_Iterator::SetEnabled(int value)
+{
+    NodeUpdate values((RO_BasePtr()));
+    values.fields = NUF_ENABLED;
+    values.enabled = value;
+    return Queue(values);
+}
+
+// -----------------------------------------------------------------------------------
+int RO_Iterator::ToggleEnabled()
+{
+    NodeBatchPtr batch(new NodeBatch());
+    for (RO_BaseVector::const_iterator it = items.begin(); it != items.end(); ++it)
+    {
+        NodeUpdate update(*it);
+        update.fields = NUF_ENABLED;
+        update.enabled = !(*it)->enabled.pyGet();
+        batch->Add(update);
+    }
+    return batch->Queue();
+}
+
+// -----------------------------------------------------------------------------------
+int RO_Iterator::SetVisibleState(std::string stateName)
+{
+    NodeUpdate values((RO_BasePtr()));
+    values.fields = NUF_VISIBLESTATE;
+    values.visibleState = stateName;
+    return Queue(values);
+}
+
+// -----------------------------------------------------------------------------------
+// The array holds its NodeArrays, which is dropped with the last view of it. The world
+// and aabbs arrays are filled in by the render thread, see NodeArrays.
+object RO_Iterator::Gather(RO_IteratorPtr self, std::string arrayName)
+{
+    if (arrayName != "positions" && arrayName != "rotations" && arrayName != "scales" &&
+        arrayName != "alphas" && arrayName != "world" && arrayName != "aabbs")
+    {
+        PyErr_SetString(PyExc_ValueError, ("RO_Iterator::Gather doesn't know the array '" + arrayName + "'").c_str());
+        throw_error_already_set();
+    }
+    object arrays(NodeArrays::Create(self));
+    return arrays.attr(arrayName.c_str());
+}
@@ -10,10 +10,13 @@
 #include <vector>
 #include <map>
 #include <list>
+#include <atomic>
+#include <boost/weak_ptr.hpp>
 #include "commandObject.hpp"
 #include "commandProperty.hpp"
 #include "commandList.hpp"
 #include "axisAlignedBoundingBox.hpp"
+#include "glStateCache.hpp"
 
 #include "yaml-cpp/yaml.h"
 #include "ViewOptions.hpp"
@@ -21,6 +24,10 @@
 class RO_Base;
 class RO_Iterator;
 class Scene;
+class SpriteBatcher;
+class SceneBinary;
+struct SceneBinaryNode;
+struct NodeUpdate;
 
 typedef boost::shared_ptr<RO_Base> RO_BasePtr;
 typedef std::vector< RO_BasePtr > RO_BaseVector;
@@ -45,10 +52,16 @@ struct RenderSettings
     GLint defaultShaderID;
     GLint tokenShaderID;
     glm::mat4 ProjViewMat;
+    glm::vec2 viewportSize;         // in pixels, 0 when unknown
+    bool viewBlock;                 // the shaders read ProjViewMat from the FrameUniforms block, don't upload it
+    GLStateCache *glState;          // optional, when set render objects go through the state cache
 
     // -----
     RenderSettings( void ):
         alpha(1.0f)
+      , viewportSize(0.f, 0.f)
+      , viewBlock(false)
+      , glState(NULL)
     {};
     RenderSettings( ViewOptionsPtr opt, GLint transLoc, GLint _modelLocation, GLint _tsModelLocation, GLint _tsVPLocation, GLint _dsID, GLint _tsID):
         alpha(1.0f)
@@ -57,6 +70,9 @@ struct RenderSettings
       , tsVPLocation(_tsVPLocation)
       , defaultShaderID(_dsID)
       , tokenShaderID(_tsID)
+      , viewportSize(0.f, 0.f)
+      , viewBlock(false)
+      , glState(NULL)
     {
         CalculateProjView(opt, transLoc);
     };
@@ -71,6 +87,8 @@ struct RenderSettings
         defaultShaderID = -1;
         tokenShaderID = -1;
         ProjViewMat = glm::mat4(1.f);
+        viewportSize = glm::vec2(0.f, 0.f);
+        viewBlock = false;
     }
     void CalculateProjView(ViewOptionsPtr opt, GLint transLoc)
     {
@@ -78,12 +96,28 @@ struct RenderSettings
         glm::mat4 VMat = glm::translate(glm::mat4(1.f), -1.0f * opt->cameraPosition());
 
         ProjViewMat = PMat * VMat;
+        viewportSize = glm::vec2(opt->viewportSize().x, opt->viewportSize().y);
         vpLocation = transLoc;
     }
 };
 
 typedef RenderSettings *RenderSettingsPtr;
 
+// -----------------------------------------------------------------------------------
+// What a worker thread prepares for one object to be drawn, see FramePipeline.
+// The model and alpha are filled in by BuildPacket on the worker, the texture and
+// uv rect by ResolvePacket on the render thread.
+struct DrawPacket
+{
+    RO_Base    *object;         // the object this came from
+    glm::mat4   model;          // its transform for this frame
+    float       alpha;          // the frame's alpha times the object's world alpha, parents included
+    bool        built;          // false if the object can't build packets, it is drawn with RenderObject
+    GLuint      texture;        // set by ResolvePacket
+    glm::vec4   uvRect;         // ..
+};
+typedef std::vector<DrawPacket> DrawPacketVector;
+
 // -----------------------------------------------------------------------------------
 class RO_Base : public BaseCommandObject
 {
@@ -96,17 +130,32 @@ protected:
     DEF_PROP(float,         alpha,      6)
     DEF_LIST(std::string,   renderSet,  7)
     DEF_PROP(std::string,   visibleState, 8)
+    static const int attachID = 9;          // the CMD_STD_UPDATE carrying an Attach
+    static const int detachID = 10;         // .. a Detach
+    static const int arrangeID = 11;        // .. an Arrange
 
 
     friend class RO_Iterator;
+    friend class NodeArrays;
+    friend class DeltaStream;
 
 protected:              // Common variables for the hierarchy
     Scene          *scene;              // which scene are we part of! This is a naked C pointer, so no reference counting problems.
     glm::mat4       currentTransform;   // The current transformation, from the last transform call.
+    float           worldAlpha;         // alpha() times the parents' world alpha, from the last transform call.
+    boost::weak_ptr<BaseCommandObject> parentNode;  // the container AddChild put us in
     object          controller;
     glm::mat4 T, R, S, I;
 
 private:
+    static std::atomic<unsigned long> structureVersion;     // bumped whenever the collectable set or draw order may have changed
+    long long       accountedBytes;     // MemoryAccounting, the object
+    long long       pyRenderSetBytes;   // .. its render set, the python side. Python thread only
+    long long       cRenderSetBytes;    // .. the C side. Render thread only, once published
+
+protected:
+    void AccountSize(size_t bytes);     // a derived class' size, from its constructor
+    void AccountRenderSet(bool pySide); // recount the side of the render set just changed, from that side's thread
 
 
 public:
@@ -124,23 +173,59 @@ public:
 
     virtual void DecodeYaml(YAML::Node node);
     virtual void DecodeMapYaml(YAML::Node node);
+    virtual void DecodeBinary(SceneBinary &binary, const SceneBinaryNode &node);   // the compiled form of DecodeYaml
+    bool AddChild(RO_BasePtr child);            // link a child in, false if we don't hold children. Bumps the structure version
+    bool RemoveChild(RO_BasePtr child);         // .. take one out, false if it isn't one of ours
+    void Attach(RO_BaseVector children);        // hand a bulk loaded subtree to the render thread as one command
+    void Detach(RO_BaseVector children);        // take children out on the render thread, one command
+    void Arrange(RO_BaseVector children);       // move children to the end in this order, adding the ones we don't hold yet, one command
+    void StageUpdate(const NodeUpdate &update);     // python thread, the python side of a NodeBatch update
+    void ApplyUpdate(const NodeUpdate &update);     // render thread, the C side
 
     virtual void SetState(std::string renderSetName, std::string stateName);
     virtual void SetState(std::string stateName);
 
 public:                             // BaseCommandObject
     virtual void ApplyCommand(CommandObjectPtr cmd); // Apply a command
+    virtual void CommandApplied(void);               // report the damage to the DamageTracker
+
+protected:
+    // Every container has to override both, on top of its own list of children: link
+    // the child into that list and return true, or take it out and return true if it
+    // was there. Without them AddChild fails, so Attach, Detach and Arrange print an
+    // error and change nothing, and a SceneBinary can't build children under it. A
+    // container that also adds children by its own path, its DecodeYaml, calls Adopt
+    // for each so the child sees its parent, ParentAlpha and TransformAncestors need it.
+    virtual bool InsertChild(RO_BasePtr child) { return false; }      // a container's own add, through AddChild only
+    virtual bool EraseChild(RO_BasePtr child) { return false; }       // .. remove, through RemoveChild only
+    void Adopt(RO_BasePtr child);       // record us as the child's parent, AddChild does it
+    virtual bool TakeDamage();          // true if an update really changed a property since the last call
 
 protected:                          // the shared interface for render objects
     bool Intersects(stringList &list);
     virtual bool Collectable(stringList &list);
 
+public:                             // Render list invalidation
+    static void MarkStructureDirty() { ++structureVersion; }     // call on enabled/renderSet/membership/draw order changes, AddChild and RemoveChild do
+    static unsigned long GetStructureVersion() { return structureVersion; }
+
 public:                             // RO_Base
     std::string     name;               // name of this render object! NOTE: Only usable on python side, doesn't support thread safety!
     virtual glm::mat4 Transform(glm::mat4 parentsTransform);
     virtual void PyTransform(glm::mat4 parentsTransform);
+    RO_BasePtr GetParent();             // the container we were added to, if it is still around
+    float ParentAlpha();                // its world alpha from the last transform, 1 at the top
+    glm::mat4 TransformAncestors();     // bring the parents up to date, top down, without their other children. Returns the parent's world matrix
+    float GetWorldAlpha()               { return worldAlpha; }
+    Scene *GetScene()                   { return scene; }
     virtual void CollectRenderables(RenderObjectVectorPtr renderables, stringList &renderSet) = 0;
     virtual void RenderObject(RenderSettingsPtr settings) = 0;
+    virtual bool BatchObject(SpriteBatcher *batcher, RenderSettingsPtr settings) { return false; }  // add to the batch instead of RenderObject, false if not supported
+    virtual unsigned long long RenderKey() { return 0; }                                            // program in the high 32 bits, texture in the low 32, 0 for either not set by the object. Groups draws by state
+    virtual bool GetScreenRect(const glm::mat4 &projView, glm::vec4 &rect) { return false; }       // NDC (minX, minY, maxX, maxY) of what we draw, false if unknown
+    virtual bool IsOpaque(RenderSettingsPtr settings) { return false; }                           // covers every pixel it draws, can go in the depth tested pass
+    virtual bool BuildPacket(DrawPacket &packet, RenderSettingsPtr settings) { return false; }      // worker thread, no GL or python. false if not supported
+    virtual bool ResolvePacket(DrawPacket &packet, RenderSettingsPtr settings) { return false; }    // render thread, fill in the GL state. false to skip it
     virtual RO_IteratorPtr Find(std::string);  // Return a iterator
     virtual void FindItems(std::string searchName, RO_Iterator * itr) {}; // If the derived object supports children then this will add any found items.
 
@@ -167,6 +252,7 @@ public:                             // public access for command properties. Wil
 // -----------------------------------------------------------------------------------
 class RO_Iterator
 {
+    friend class NodeArrays;
 private:            // The internal storage
     RO_BaseVector                   items;
 
@@ -174,11 +260,20 @@ private:            // The internal storage
     inline RO_BaseVector::const_iterator cend() const {return items.cend();};
     inline RO_BaseVector::size_type size() const {return items.size();};
     inline RO_BasePtr getItem(int n) const {return items[n];};
+    int Queue(const NodeUpdate &values);    // one batch setting the values on every item that differs
 public:             // The public exposed objects.
     RO_Iterator( void );        // Construct
     ~RO_Iterator( void );       // Construct
     void Add(RO_BasePtr itm);   // Add a item to the iterator
     static void Boost(void);    // Boost it!
 
+public:             // Bulk operations, each is one batched command. They return the items changed
+    int SetProperty(std::string propName, object value);
+    int OffsetPositions(glm::vec3 offset);
+    int SetEnabled(int value);
+    int ToggleEnabled();
+    int SetVisibleState(std::string stateName);
+    static object Gather(RO_IteratorPtr self, std::string arrayName);  // a NodeArrays array of the items
+
 };
 #endif
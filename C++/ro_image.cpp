@@ -22,30 +22,58 @@ using namespace std;
 #include "scene.hpp"
 #include "viewManager.hpp"
 #include "ro_image.hpp"
+#include "spriteBatcher.hpp"
+#include "textureAtlas.hpp"
+#include "textureStreamer.hpp"
+#include "textureCache.hpp"
+#include "damageTracker.hpp"
+#include "sceneBinary.hpp"
+#include "renderStats.hpp"
 
 // -----------------------------------------------------------------------------------
 RO_Image::RO_Image(Scene * _scene):
     RO_Base(_scene)
   , textureID(0)
+  , atlasTexture(0)
+  , atlasUV(0.f, 0.f, 1.f, 1.f)
+  , atlasVersion(0)
+  , streamed()
+  , streamedKey()
+  , acquiredKey()
+  , textureLod(0)
+  , sourceWidth(0)
+  , textureOpaque(false)
   , INIT_PROP(resPath)
   // , INIT_PROP_DEF(size, glm::vec3(64, 64, 0))
   , INIT_PROP_DEF(size, glm::vec3(-1, -1, 0))
   , INIT_PROP_DEF(visionRange, 0.0f)
 {
+    AccountSize(sizeof(RO_Image));
 }
 RO_Image::RO_Image(Scene * _scene, string _resPath):
     RO_Base(_scene)
   , textureID(0)
+  , atlasTexture(0)
+  , atlasUV(0.f, 0.f, 1.f, 1.f)
+  , atlasVersion(0)
+  , streamed()
+  , streamedKey()
+  , acquiredKey()
+  , textureLod(0)
+  , sourceWidth(0)
+  , textureOpaque(false)
   , INIT_PROP_DEF(resPath, _resPath)
   // , INIT_PROP_DEF(size, glm::vec3(64, 64, 0))
   , INIT_PROP_DEF(size, glm::vec3(-1, -1, 0))
   , INIT_PROP_DEF(visionRange, 0.0f)
 {
+    AccountSize(sizeof(RO_Image));
 }
 
 // -----------------------------------------------------------------------------------
 RO_Image::~RO_Image()
 {
+    ReleaseTexture();
 }
 
 // -----------------------------------------------------------------------------------
@@ -99,9 +127,15 @@ glm::mat4 RO_Image::Transform(glm::mat4 parentsTransform)
 
     T = glm::translate(I, position());
     R = glm::rotate(I, rotation() * 0.0174532925f, glm::vec3(0.0f, 0.0f, 1.0f));
-    S = glm::scale(I, glm::vec3((size().x / BASEQUADSIDELENGTH) * scaleX(), (size().y / BASEQUADSIDELENGTH) * scaleY(), 1.0));
+    // until the texture is loaded the size may still be unset, use the old default size
+    // so the placeholder has something sensible to draw.
+    glm::vec3 sz = size();
+    if (sz.x < 0) sz.x = 64;
+    if (sz.y < 0) sz.y = 64;
+    S = glm::scale(I, glm::vec3((sz.x / BASEQUADSIDELENGTH) * scaleX(), (sz.y / BASEQUADSIDELENGTH) * scaleY(), 1.0));
 
     currentTransform = parentsTransform * T * R * S;
+    worldAlpha = ParentAlpha() * alpha();
     return currentTransform;
 }
 // -----------------------------------------------------------------------------------
@@ -114,14 +148,26 @@ void RO_Image::PyTransform(glm::mat4 parentsTransform)
 }
 
 // -----------------------------------------------------------------------------------
-void RO_Image::RenderObject(RenderSettingsPtr settings)
+// When the texture streamer is running the texture is loaded in the background and
+// the placeholder is drawn until it arrives, otherwise the scene loads it right now.
+bool RO_Image::ResolveTexture()
 {
+    if (streamed)
+    {
+        return PollStream();
+    }
     if (textureID == 0)
     {
+        TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+        if (streamer && streamer->HasDecoder())
+        {
+            RequestTexture(textureLod);
+            return PollStream();
+        }
         if (scene == NULL)
         {
             printf("ERROR: Scene not Set for Render, skipping! (%s) %s\n", name.c_str(), resPath().c_str());
-            return;
+            return false;
         }
         textureID = scene->GetTexture(resPath());
         // if we have the default size, then get the resource native size.
@@ -136,6 +182,165 @@ void RO_Image::RenderObject(RenderSettingsPtr settings)
         }
 
     }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Replaces any variant already on the way, the one we are drawing stays until the
+// new one is ready.
+void RO_Image::RequestTexture(int lod)
+{
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    TextureCachePtr cache = TextureCache::GetInstance();
+    StreamedTexturePtr next = cache ? cache->Acquire(resPath(), lod) : streamer->Request(resPath(), lod);
+    DropVariant(streamedKey);
+    streamed = next;
+    streamedKey = next->key;
+}
+
+// -----------------------------------------------------------------------------------
+// Without a cache the streamer counts the users itself, either way a variant nobody
+// holds any more can go.
+void RO_Image::DropVariant(std::string &key)
+{
+    if (key.empty())
+    {
+        return;
+    }
+    TextureCachePtr cache = TextureCache::GetInstance();
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    if (cache)
+    {
+        cache->Release(key);
+    }
+    else if (streamer)
+    {
+        streamer->Release(key);
+    }
+    key.clear();
+}
+
+// -----------------------------------------------------------------------------------
+// Let go of the texture, the next ResolveTexture picks up the one for resPath.
+void RO_Image::ReleaseTexture()
+{
+    DropVariant(acquiredKey);
+    DropVariant(streamedKey);
+    streamed.reset();
+    textureID = 0;
+    textureLod = 0;
+    sourceWidth = 0;
+    textureOpaque = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Once the streamed variant is ready it replaces the one we were drawing.
+bool RO_Image::PollStream()
+{
+    int state = streamed->state;
+    if (state == STREAM_READY)
+    {
+        DropVariant(acquiredKey);
+        acquiredKey = streamedKey;
+        streamedKey.clear();
+        textureID = streamed->texture;
+        textureLod = streamed->lod;
+        sourceWidth = streamed->sourceWidth;
+        textureOpaque = streamed->opaque;
+        if (size.pyGet().x < 0 || size.pyGet().y < 0)
+        {
+            // the size is that of the source, whatever variant we got
+            size.pySet(glm::vec3(streamed->sourceWidth, streamed->sourceHeight, 0));
+        }
+        streamed.reset();
+        DamageTracker::Damage(this);    // drawn with the new texture from the next frame on
+        return true;
+    }
+
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    GLuint placeholder = streamer ? streamer->GetPlaceholder() : 0;
+    bool drawing = textureID != 0 && textureID != placeholder;     // an older variant is up
+    if (state == STREAM_FAILED)
+    {
+        DropVariant(streamedKey);
+        streamed.reset();
+        if (!drawing)
+        {
+            textureID = placeholder;    // keep the placeholder, don't keep asking
+        }
+        return textureID != 0;
+    }
+    if (!drawing)
+    {
+        textureID = placeholder;
+    }
+    return textureID != 0;
+}
+
+// -----------------------------------------------------------------------------------
+// Picks the variant from how many pixels we cover compared to the full resolution
+// image, each lod halves the image. The thresholds overlap so an image sitting on a
+// boundary doesn't flip back and forth between variants.
+void RO_Image::SelectTextureLod(RenderSettingsPtr settings, const glm::mat4 &model)
+{
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    if (!streamer || !streamer->HasDecoder() || settings->viewportSize.x <= 0.f)
+    {
+        return;
+    }
+    float fullWidth = sourceWidth > 0 ? (float)sourceWidth : size().x;
+    glm::vec4 rect;
+    if (fullWidth <= 0.f || !ProjectQuad(settings->ProjViewMat * model, rect))
+    {
+        return;
+    }
+    float pixels = glm::max((rect.z - rect.x) * 0.5f * settings->viewportSize.x, 1.f);
+    float ratio = fullWidth / pixels;
+
+    int current = streamed ? streamed->lod : textureLod;
+    int lod = current;
+    while (lod < MAX_TEXTURE_LOD && ratio >= (float)(2 << lod) * 1.25f)
+    {
+        ++lod;
+    }
+    while (lod > 0 && ratio < (float)(1 << lod) * 0.8f)
+    {
+        --lod;
+    }
+    if (lod == current)
+    {
+        return;
+    }
+    if (streamed && lod == textureLod && !acquiredKey.empty())
+    {
+        // back to what we are drawing, stop loading the other one
+        DropVariant(streamedKey);
+        streamed.reset();
+        return;
+    }
+    if (streamed || textureID != 0)
+    {
+        RequestTexture(lod);
+    }
+    else
+    {
+        textureLod = lod;   // nothing loaded yet, ResolveTexture asks for this one
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Image::RenderObject(RenderSettingsPtr settings)
+{
+    SelectTextureLod(settings, currentTransform);
+    if (!ResolveTexture())
+    {
+        return;
+    }
+    if (settings->glState != NULL)
+    {
+        RenderCached(settings);
+        return;
+    }
     GL_CHECK_ERROR("GL Error: Start Render Object")
     GLint currentShaderProgram = 0;
     glGetIntegerv(GL_CURRENT_PROGRAM, &currentShaderProgram);
@@ -144,16 +349,26 @@ void RO_Image::RenderObject(RenderSettingsPtr settings)
     {
         glUniformMatrix4fv(settings->modelLocation, 1, GL_FALSE, &(currentTransform[0][0]));
         GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: modelLocation")
-        glUniformMatrix4fv(settings->vpLocation, 1, GL_FALSE, &(settings->ProjViewMat[0][0]));
-        GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: vpLocation")
+        RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+        if (!settings->viewBlock)
+        {
+            glUniformMatrix4fv(settings->vpLocation, 1, GL_FALSE, &(settings->ProjViewMat[0][0]));
+            GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: vpLocation")
+            RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+        }
 
     }
     else if (currentShaderProgram == settings->tokenShaderID)
     {
         glUniformMatrix4fv(settings->tsModelLocation, 1, GL_FALSE, &(currentTransform[0][0]));
         GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: tsModelLocation")
-        glUniformMatrix4fv(settings->tsVPLocation, 1, GL_FALSE, &(settings->ProjViewMat[0][0]));
-        GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: tsVPLocation")
+        RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+        if (!settings->viewBlock)
+        {
+            glUniformMatrix4fv(settings->tsVPLocation, 1, GL_FALSE, &(settings->ProjViewMat[0][0]));
+            GL_CHECK_ERROR("GL Error: glUniformMatrix4fv: tsVPLocation")
+            RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+        }
     }
 
     glActiveTexture(GL_TEXTURE0);
@@ -164,26 +379,189 @@ void RO_Image::RenderObject(RenderSettingsPtr settings)
     GL_CHECK_ERROR("GL Error: glDrawElements:")
     glBindTexture(GL_TEXTURE_2D, 0);
     GL_CHECK_ERROR("GL Error: glBindTexture:")
+    RENDER_STAT_ADD(RS_TEXTURE_BINDS, 2)
+    RENDER_STAT_INC(RS_DRAW_CALLS)
+}
+
+// -----------------------------------------------------------------------------------
+// The same as RenderObject, but the program is not queried from the driver, the view
+// projection only goes up once per program per frame, and the texture stays bound
+// so the next object using it doesn't have to bind it again.
+void RO_Image::RenderCached(RenderSettingsPtr settings)
+{
+    GLStateCache *gl = settings->glState;
+    GLint currentShaderProgram = gl->GetProgram();
+    if (currentShaderProgram == settings->defaultShaderID)
+    {
+        gl->UniformMatrix4(settings->modelLocation, currentTransform);
+        if (!settings->viewBlock)
+        {
+            gl->UniformMatrix4(settings->vpLocation, settings->ProjViewMat);
+        }
+    }
+    else if (currentShaderProgram == settings->tokenShaderID)
+    {
+        gl->UniformMatrix4(settings->tsModelLocation, currentTransform);
+        if (!settings->viewBlock)
+        {
+            gl->UniformMatrix4(settings->tsVPLocation, settings->ProjViewMat);
+        }
+    }
+    GL_CHECK_ERROR("GL Error: RenderCached uniforms")
+
+    gl->ActiveTexture(GL_TEXTURE0);
+    gl->BindTexture2D(textureID);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    GL_CHECK_ERROR("GL Error: RenderCached glDrawElements:")
+    RENDER_STAT_INC(RS_DRAW_CALLS)
+}
+
+// -----------------------------------------------------------------------------------
+// Images are drawn with whatever shader the pass has bound, so the program half is
+// left 0 and only the texture counts.
+unsigned long long RO_Image::RenderKey()
+{
+    return atlasTexture != 0 ? atlasTexture : textureID;
+}
+
+// -----------------------------------------------------------------------------------
+bool RO_Image::GetScreenRect(const glm::mat4 &projView, glm::vec4 &rect)
+{
+    return ProjectQuad(projView * currentTransform, rect);
+}
+
+// -----------------------------------------------------------------------------------
+bool RO_Image::ProjectQuad(const glm::mat4 &mvp, glm::vec4 &rect)
+{
+    const float L = BASEQUADSIDELENGTH;
+    glm::vec4 corners[4] = { glm::vec4(0.f, 0.f, 0.f, 1.f), glm::vec4(L, 0.f, 0.f, 1.f), glm::vec4(L, L, 0.f, 1.f), glm::vec4(0.f, L, 0.f, 1.f) };
+    for (int i = 0; i < 4; ++i)
+    {
+        glm::vec4 c = mvp * corners[i];
+        if (c.w <= 0.f)
+        {
+            return false;   // behind the camera, can't say where it lands
+        }
+        float x = c.x / c.w;
+        float y = c.y / c.w;
+        if (i == 0)
+        {
+            rect = glm::vec4(x, y, x, y);
+        }
+        else
+        {
+            rect = glm::vec4(glm::min(rect.x, x), glm::min(rect.y, y), glm::max(rect.z, x), glm::max(rect.w, y));
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// The atlas is only used when batching, RenderObject draws with shaders that
+// sample the whole texture.
+bool RO_Image::ResolveAtlas()
+{
+    TextureAtlasPtr atlas = TextureAtlas::GetInstance();
+    if (!atlas)
+    {
+        return false;
+    }
+    if (atlasVersion != atlas->GetVersion())
+    {
+        atlasVersion = atlas->GetVersion();
+        if (!atlas->Lookup(resPath(), atlasTexture, atlasUV))
+        {
+            atlasTexture = 0;
+        }
+    }
+    return atlasTexture != 0;
+}
+
+// -----------------------------------------------------------------------------------
+// The alpha is the world alpha, parents included, the same as BuildPacket. A texture
+// that isn't resolved yet is left to RenderObject like ResolvePacket does.
+bool RO_Image::BatchObject(SpriteBatcher *batcher, RenderSettingsPtr settings)
+{
+    if (ResolveAtlas() && size().x >= 0 && size().y >= 0)
+    {
+        batcher->Add(atlasTexture, currentTransform, settings->alpha * worldAlpha, atlasUV);
+        return true;
+    }
+    SelectTextureLod(settings, currentTransform);
+    if (!ResolveTexture())
+    {
+        return false;
+    }
+    batcher->Add(textureID, currentTransform, settings->alpha * worldAlpha, glm::vec4(0.f, 0.f, 1.f, 1.f));
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Only textures analysed by the streamer are known to be opaque, the atlas pages
+// and the scene's own textures are taken as translucent. The world alpha, so an image
+// under a faded parent stays in the blended pass.
+bool RO_Image::IsOpaque(RenderSettingsPtr settings)
+{
+    return textureOpaque && atlasTexture == 0 && worldAlpha >= 1.f && settings->alpha >= 1.f;
+}
+
+// -----------------------------------------------------------------------------------
+// Only reads what the transform pass wrote, the texture is left to ResolvePacket.
+bool RO_Image::BuildPacket(DrawPacket &packet, RenderSettingsPtr settings)
+{
+    packet.model = currentTransform;
+    packet.alpha = settings->alpha * worldAlpha;
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// The same choice BatchObject makes, but with the transform from the packet, the
+// workers may already be writing currentTransform for the next frame.
+bool RO_Image::ResolvePacket(DrawPacket &packet, RenderSettingsPtr settings)
+{
+    if (ResolveAtlas() && size().x >= 0 && size().y >= 0)
+    {
+        packet.texture = atlasTexture;
+        packet.uvRect = atlasUV;
+        return true;
+    }
+    SelectTextureLod(settings, packet.model);
+    if (!ResolveTexture())
+    {
+        return false;
+    }
+    packet.texture = textureID;
+    packet.uvRect = glm::vec4(0.f, 0.f, 1.f, 1.f);
+    return true;
 }
 
 // -----------------------------------------------------------------------------------
 void RO_Image::CollectRenderables(RenderObjectVectorPtr renderables, stringList &renderSet)
 {
+    RENDER_STAT_INC(RS_NODES_VISITED)
     if (Collectable(renderSet))
     {
         renderables->push_back(this);//shared_from_this());
+        RENDER_STAT_INC(RS_COLLECTED)
     }
 }
 
 // -----------------------------------------------------------------------------------
 void RO_Image::ApplyCommand(CommandObjectPtr cmd)
 {
-    if (resPath.ApplyCommand(cmd) == 1){} else
+    if (resPath.ApplyCommand(cmd) == 1){ atlasVersion = 0; ReleaseTexture(); } else
     if (size.ApplyCommand(cmd) == 1){} else
     if (visionRange.ApplyCommand(cmd) == 1){} else
     RO_Base::ApplyCommand(cmd);
 }
 
+// -----------------------------------------------------------------------------------
+bool RO_Image::TakeDamage()
+{
+    bool damaged = resPath.takeDamage() | size.takeDamage() | visionRange.takeDamage();
+    return RO_Base::TakeDamage() | damaged;
+}
+
 // -----------------------------------------------------------------------------------
 void RO_Image::Debug(void)
 {
@@ -230,6 +608,14 @@ void RO_Image::DecodeYaml(YAML::Node node)
     if (node["size"]) size << node;
 }
 
+// -----------------------------------------------------------------------------------
+void RO_Image::DecodeBinary(SceneBinary &binary, const SceneBinaryNode &node)
+{
+    RO_Base::DecodeBinary(binary, node);
+    if (node.fields & SBF_RESPATH)  resPath.pySet(binary.GetString(node.resPath));
+    if (node.fields & SBF_SIZE)     size.pySet(glm::vec3(node.size[0], node.size[1], node.size[2]));
+}
+
 // -----------------------------------------------------------------------------------
 void RO_Image::ComputeAABB(glm::mat4 parentsTransform)
 {
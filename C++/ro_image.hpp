@@ -16,6 +16,7 @@
 #include "ro_base.hpp"
 #include "ro_list.hpp"
 #include "ro_state.hpp"
+#include "textureStreamer.hpp"
 
 
 // -----------------------------------------------------------------------------------
@@ -33,25 +34,53 @@ class RO_Image: public RO_Base
 
 private:                // internal variables
     GLuint textureID, vaoID, vboID;           // the openGL texture for this object
+    GLuint atlasTexture;                      // the atlas page holding our image, 0 if not in the atlas
+    glm::vec4 atlasUV;                        // where in the atlas page our image is
+    unsigned long atlasVersion;               // the atlas build the above was looked up in
+    StreamedTexturePtr streamed;              // the texture while it is being streamed in
+    std::string streamedKey;                  // the variant key we hold for streamed
+    std::string acquiredKey;                  // the variant key we hold for textureID
+    int textureLod;                           // the variant textureID is, see TextureStreamer
+    int sourceWidth;                          // full resolution width of our image, 0 until known
+    bool textureOpaque;                       // the streamed texture has no transparent pixels
     void BuildGraphics();
+    bool ResolveTexture();      // make sure the texture is loaded, false if it can't be
+    bool PollStream();          // pick up the streamed texture once it is ready
+    void ReleaseTexture();      // drop our texture and any cache reference
+    void SelectTextureLod(RenderSettingsPtr settings, const glm::mat4 &model);  // stream the variant that suits our size on screen
+    static bool ProjectQuad(const glm::mat4 &mvp, glm::vec4 &rect);             // NDC rect of the base quad
+    void RequestTexture(int lod);                       // start streaming a variant
+    void DropVariant(std::string &key);                 // let go of a variant we hold, through the cache if there is one
+    bool ResolveAtlas();        // look up our image in the texture atlas, false if it isn't there
     // glm::vec4 * GetCurrentVerts();
     // void UpdateVBO(glm::vec4 * CurrentVerts);
     void DrawQuad();            // Draw a quad with this texture on it.
+    void RenderCached(RenderSettingsPtr settings);  // RenderObject through the GL state cache
 
 public:
     virtual void CollectRenderables(RenderObjectVectorPtr renderables, stringList &renderSet);
     virtual void RenderObject(RenderSettingsPtr settings);
+    virtual bool BatchObject(SpriteBatcher *batcher, RenderSettingsPtr settings);
+    virtual unsigned long long RenderKey();
+    virtual bool GetScreenRect(const glm::mat4 &projView, glm::vec4 &rect);
+    virtual bool IsOpaque(RenderSettingsPtr settings);
+    virtual bool BuildPacket(DrawPacket &packet, RenderSettingsPtr settings);
+    virtual bool ResolvePacket(DrawPacket &packet, RenderSettingsPtr settings);
     virtual glm::mat4 Transform(glm::mat4 parentsTransform);
     virtual void PyTransform(glm::mat4 parentsTransform);
     inline float GetVisionRange() {return visionRange();}
     inline glm::vec3 GetPosition() {return position();}
     void ApplyCommand(CommandObjectPtr cmd);
+protected:
+    virtual bool TakeDamage();
+public:
 
     void Debug(void);
     virtual void DumpNode(int indent) { printf("%*sImage(%u) %-30s\t(%6.1f,%6.1f,%6.1f)\t%6.1f°\t[%3.1f,%3.1f]\t {%6.1f,%6.1f}\n", indent, " ", textureID, resPath().c_str(), position.pyGet().x, position.pyGet().y, position.pyGet().z, rotation.pyGet(), scaleX.pyGet(), scaleY.pyGet(), size.pyGet().x, size.pyGet().y);}
     virtual std::string __repr__();
 
     virtual void DecodeYaml(YAML::Node node);
+    virtual void DecodeBinary(SceneBinary &binary, const SceneBinaryNode &node);
 public:                            // AABB caculation
     virtual void ComputeAABB(glm::mat4 parentsTransform);
 
@@ -0,0 +1,174 @@
+/* -----------------------------------------------------------------------------------
+   -- ro_lazy.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "ro_lazy.hpp"
+#include "lazyMaterializer.hpp"
+#include "renderStats.hpp"
+
+// -----------------------------------------------------------------------------------
+// Only what Collectable looks at is decoded, the subtree's own object gets the rest.
+// Written directly, a command would need shared_from_this, which a constructor can't.
+RO_Lazy::RO_Lazy(Scene * _scene, SceneBinaryPtr _binary, uint32_t _index, SceneNodeFactory _factory):
+    RO_Base(_scene)
+  , binary(_binary)
+  , index(_index)
+  , factory(_factory)
+  , pyChild()
+  , child()
+  , requested(false)
+{
+    BulkLoad bulk(this);
+    const SceneBinaryNode &node = binary->GetNode(index);
+    name = node.fields & SBF_NAME ? binary->GetString(node.name) : "lazy";
+    if (node.fields & SBF_ENABLED)
+    {
+        enabled.pySet(node.enabled);
+    }
+    for (uint32_t i = 0; (node.fields & SBF_RENDERSET) && i < node.renderSetCount; ++i)
+    {
+        renderSet.push_back(binary->GetString(binary->GetRef(node.renderSetFirst + i)));
+    }
+    AccountSize(sizeof(RO_Lazy));
+    AccountRenderSet(true);
+}
+
+// -----------------------------------------------------------------------------------
+RO_Lazy::~RO_Lazy()
+{}
+
+// -----------------------------------------------------------------------------------
+void RO_Lazy::Boost(void)
+{
+    class_ < RO_Lazy, bases<RO_Base>, RO_LazyPtr >("RO_Lazy", no_init)
+        .add_property("materialized", &RO_Lazy::IsMaterialized)
+        .def("Materialize", &RO_Lazy::Materialize, "Build the subtree now instead of when it is first collected")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+std::string RO_Lazy::__repr__()
+{
+    std::ostringstream stringStream;
+    stringStream << "Lazy " << name << ": ";
+    stringStream << " Enabled: " << (enabled() ? "T" : "F");
+    stringStream << " Materialized: " << (pyChild ? "T" : "F");
+    return stringStream.str();
+}
+
+// -----------------------------------------------------------------------------------
+python::object RO_Lazy::GetSelf()
+{
+    return python::object(GetThis<RO_Lazy>());
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Lazy::DumpNode(int indent)
+{
+    printf("%*sLazy %-30s\t%s\n", indent, " ", name.c_str(), pyChild ? "materialized" : "not built");
+    if (pyChild)
+    {
+        pyChild->DumpNode(indent + 2);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// The nested subtrees hold the SceneBinary too, it is let go once the last is built.
+int RO_Lazy::Materialize()
+{
+    if (pyChild || !binary)
+    {
+        return 0;
+    }
+    int built = 0;
+    pyChild = binary->BuildNode(scene, factory, index, built);
+    if (!pyChild)
+    {
+        // ask again the next time we are collected, the cached render lists have to be
+        // walked again for that
+        requested = false;
+        MarkStructureDirty();
+        return 0;
+    }
+    binary.reset();
+    Attach(RO_BaseVector(1, pyChild));
+    return built;
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread, from the Attach.
+bool RO_Lazy::InsertChild(RO_BasePtr _child)
+{
+    child = _child;
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Render thread, from a RemoveChild. The subtree is gone for good, it isn't built again.
+bool RO_Lazy::EraseChild(RO_BasePtr _child)
+{
+    if (!child || child != _child)
+    {
+        return false;
+    }
+    child.reset();
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Python thread like the rest of ComputeAABB, the built subtree's box once there is one.
+void RO_Lazy::ComputeAABB(glm::mat4 parentsTransform)
+{
+    if (pyChild)
+    {
+        pyChild->ComputeAABB(parentsTransform);
+        aabb = pyChild->GetAABB(true);
+        return;
+    }
+    RO_Base::ComputeAABB(parentsTransform);
+}
+
+// -----------------------------------------------------------------------------------
+glm::mat4 RO_Lazy::Transform(glm::mat4 parentsTransform)
+{
+    currentTransform = parentsTransform;
+    worldAlpha = ParentAlpha() * alpha();
+    if (child)
+    {
+        child->Transform(parentsTransform);
+    }
+    return currentTransform;
+}
+
+// -----------------------------------------------------------------------------------
+// This can run on the frame pipeline's workers, the request only queues us.
+void RO_Lazy::CollectRenderables(RenderObjectVectorPtr renderables, stringList &renderSet)
+{
+    RENDER_STAT_INC(RS_NODES_VISITED)
+    if (!Collectable(renderSet))
+    {
+        return;
+    }
+    if (child)
+    {
+        child->CollectRenderables(renderables, renderSet);
+    }
+    else if (LazyMaterializer::GetInstance() && !requested.exchange(true))
+    {
+        LazyMaterializer::GetInstance()->Request(GetThis<RO_Lazy>());
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void RO_Lazy::FindItems(std::string searchName, RO_Iterator * itr)
+{
+    if (pyChild)
+    {
+        pyChild->FindItems(searchName, itr);
+    }
+}
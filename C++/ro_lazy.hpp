@@ -0,0 +1,53 @@
+/* -----------------------------------------------------------------------------------
+   -- ro_lazy.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __RO_LAZY_HPP__
+#define __RO_LAZY_HPP__
+#include <stdio.h>
+#include <string>
+#include <atomic>
+#include "ro_base.hpp"
+#include "sceneBinary.hpp"
+
+// -----------------------------------------------------------------------------------
+class RO_Lazy;
+
+typedef boost::shared_ptr<RO_Lazy> RO_LazyPtr;
+
+// -----------------------------------------------------------------------------------
+// Stands in for a subtree of a compiled scene that hasn't been built. Only the node's
+// enabled flag and render sets are kept, the rest stays in the SceneBinary until the
+// first time we would be collected. Then we ask the LazyMaterializer to build it on the
+// python thread, and the built object is attached under us and drawn from then on.
+// We keep the enabled flag, so turning the layer off and on again is still us.
+class RO_Lazy: public RO_Base
+{
+private:
+    SceneBinaryPtr      binary;         // where the subtree is described
+    uint32_t            index;          // .. the node
+    SceneNodeFactory    factory;        // makes the objects, the same as the load used
+    RO_BasePtr          pyChild;        // the built subtree, python thread
+    RO_BasePtr          child;          // .. render thread, set by the Attach
+    std::atomic<bool>   requested;      // we have asked to be built
+
+public:
+    RO_Lazy(Scene * _scene, SceneBinaryPtr _binary, uint32_t _index, SceneNodeFactory _factory);
+    ~RO_Lazy();
+    static void Boost(void);
+    virtual std::string __repr__();
+    virtual python::object GetSelf();
+
+    int  Materialize();                 // build the subtree now, python thread. Returns the objects made
+    bool IsMaterialized()               { return pyChild != NULL; }
+
+    virtual void DumpNode(int indent);
+    virtual bool InsertChild(RO_BasePtr _child);
+    virtual bool EraseChild(RO_BasePtr _child);
+    virtual void ComputeAABB(glm::mat4 parentsTransform);
+    virtual glm::mat4 Transform(glm::mat4 parentsTransform);
+    virtual void CollectRenderables(RenderObjectVectorPtr renderables, stringList &renderSet);
+    virtual void RenderObject(RenderSettingsPtr settings) {}
+    virtual void FindItems(std::string searchName, RO_Iterator * itr);
+};
+#endif
@@ -0,0 +1,649 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneBinary.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <algorithm>
+#include <deque>
+
+using namespace boost::python;
+using namespace std;
+
+#include "sceneBinary.hpp"
+#include "ro_lazy.hpp"
+#include "gilGuard.hpp"
+#include "memoryAccounting.hpp"
+
+// the keys the converter reads the type and children from
+#define YAML_TYPE_KEY       "__type"
+#define YAML_CHILDREN_KEY   "__children"
+
+// -----------------------------------------------------------------------------------
+SceneBinary::SceneBinary() :
+    path()
+  , owned()
+  , mapped(false)
+  , base(NULL)
+  , length(0)
+  , accounted(0)
+  , header(NULL)
+  , stringOffsets(NULL)
+  , stringBlob(NULL)
+  , refs(NULL)
+  , nodes(NULL)
+{}
+
+// -----------------------------------------------------------------------------------
+SceneBinary::~SceneBinary()
+{
+    Close();
+}
+
+// -----------------------------------------------------------------------------------
+void SceneBinary::Boost()
+{
+    class_ < SceneBinary, SceneBinaryPtr, boost::noncopyable >("SceneBinary", "A compiled scene, mapped into memory")
+        .def("Compile", &SceneBinary::Compile, "Compile(yamlPath, outPath) convert a YAML scene to the binary format")
+        .staticmethod("Compile")
+        .def("Open", &SceneBinary::Open)
+        .def("Close", &SceneBinary::Close)
+        .add_property("isOpen", &SceneBinary::IsOpen)
+        .add_property("numNodes", &SceneBinary::GetNumNodes)
+        .add_property("numRoots", &SceneBinary::GetNumRoots)
+        .add_property("numStrings", &SceneBinary::GetNumStrings)
+    ;
+}
+
+// ===================================================================================
+// The converter
+// ===================================================================================
+namespace
+{
+    struct SceneWriter
+    {
+        std::map<std::string, uint32_t> stringIds;
+        std::vector<std::string>        strings;
+        std::vector<uint32_t>           refs;
+        std::vector<SceneBinaryNode>    nodes;
+        std::set<std::string>           unknownKeys;
+
+        uint32_t Intern(const std::string &s)
+        {
+            std::map<std::string, uint32_t>::iterator it = stringIds.find(s);
+            if (it != stringIds.end())
+            {
+                return it->second;
+            }
+            uint32_t id = strings.size();
+            strings.push_back(s);
+            stringIds[s] = id;
+            return id;
+        }
+
+        // the same fields RO_Base::DecodeYaml and RO_Image::DecodeYaml read.
+        void Fill(SceneBinaryNode &out, const YAML::Node &node)
+        {
+            memset(&out, 0, sizeof(out));
+            out.type = Intern(node[YAML_TYPE_KEY] ? node[YAML_TYPE_KEY].as<std::string>() : std::string());
+            out.visibleState = out.resPath = out.name = SCENE_BINARY_NONE;
+            out.firstChild = SCENE_BINARY_NONE;
+            if (node["enabled"])    { out.fields |= SBF_ENABLED;  out.enabled = node["enabled"].as<int>(); }
+            if (node["rotation"])   { out.fields |= SBF_ROTATION; out.rotation = node["rotation"].as<float>(); }
+            if (node["scaleX"])     { out.fields |= SBF_SCALEX;   out.scaleX = node["scaleX"].as<float>(); }
+            if (node["scaleY"])     { out.fields |= SBF_SCALEY;   out.scaleY = node["scaleY"].as<float>(); }
+            if (node["alpha"])      { out.fields |= SBF_ALPHA;    out.alpha = node["alpha"].as<float>(); }
+            if (node["position"])
+            {
+                out.fields |= SBF_POSITION;
+                for (int i = 0; i < 3; ++i) out.position[i] = node["position"][i].as<float>();
+            }
+            if (node["Attribs"] && node["Attribs"]["VisibleState"])
+            {
+                out.fields |= SBF_VISIBLESTATE;
+                out.visibleState = Intern(node["Attribs"]["VisibleState"].as<std::string>());
+            }
+            if (node["__renderSet"])
+            {
+                out.fields |= SBF_RENDERSET;
+                out.renderSetFirst = refs.size();
+                for (YAML::const_iterator it = node["__renderSet"].begin(); it != node["__renderSet"].end(); ++it)
+                {
+                    refs.push_back(Intern(it->as<std::string>()));
+                }
+                out.renderSetCount = refs.size() - out.renderSetFirst;
+            }
+            if (node["resPath"])    { out.fields |= SBF_RESPATH;  out.resPath = Intern(node["resPath"].as<std::string>()); }
+            if (node["size"])
+            {
+                out.fields |= SBF_SIZE;
+                for (int i = 0; i < 3; ++i) out.size[i] = node["size"][i].as<float>();
+            }
+            if (node["name"])       { out.fields |= SBF_NAME;     out.name = Intern(node["name"].as<std::string>()); }
+
+            static const char *known[] = { YAML_TYPE_KEY, YAML_CHILDREN_KEY, "enabled", "rotation", "scaleX", "scaleY", "alpha",
+                                           "position", "Attribs", "__renderSet", "resPath", "size", "name", NULL };
+            for (YAML::const_iterator it = node.begin(); it != node.end(); ++it)
+            {
+                std::string key = it->first.as<std::string>();
+                int k = 0;
+                while (known[k] != NULL && key != known[k]) ++k;
+                if (known[k] == NULL)
+                {
+                    unknownKeys.insert(key);
+                }
+            }
+            // Attribs is a map of its own, only VisibleState has a field
+            if (node["Attribs"] && node["Attribs"].IsMap())
+            {
+                for (YAML::const_iterator it = node["Attribs"].begin(); it != node["Attribs"].end(); ++it)
+                {
+                    std::string key = it->first.as<std::string>();
+                    if (key != "VisibleState")
+                    {
+                        unknownKeys.insert("Attribs." + key);
+                    }
+                }
+            }
+        }
+
+        // breadth first, so every node's children are next to each other.
+        void Add(const YAML::Node &root)
+        {
+            std::vector<YAML::Node> order;
+            if (root.IsSequence())
+            {
+                for (YAML::const_iterator it = root.begin(); it != root.end(); ++it) order.push_back(*it);
+            }
+            else
+            {
+                order.push_back(root);
+            }
+            for (size_t i = 0; i < order.size(); ++i)
+            {
+                nodes.push_back(SceneBinaryNode());
+                Fill(nodes.back(), order[i]);
+                YAML::Node children = order[i][YAML_CHILDREN_KEY];
+                if (children && children.IsSequence() && children.size() > 0)
+                {
+                    nodes[i].firstChild = order.size();
+                    nodes[i].numChildren = children.size();
+                    for (YAML::const_iterator it = children.begin(); it != children.end(); ++it) order.push_back(*it);
+                }
+            }
+        }
+    };
+
+    uint32_t Align4(uint32_t v) { return (v + 3) & ~3u; }
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneBinary::Compile(const std::string &yamlPath, const std::string &outPath)
+{
+    ScopedGILRelease unlocked;
+    YAML::Node root;
+    try
+    {
+        root = YAML::LoadFile(yamlPath);
+    }
+    catch (std::exception &e)
+    {
+        printf("ERROR: SceneBinary can't load %s: %s\n", yamlPath.c_str(), e.what());
+        return false;
+    }
+    return CompileNode(root, outPath);
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneBinary::CompileNode(const YAML::Node &root, const std::string &outPath)
+{
+    std::vector<char> data;
+    std::set<std::string> unknownKeys;
+    if (!CompileBuffer(root, data, unknownKeys))
+    {
+        return false;
+    }
+    for (std::set<std::string>::iterator it = unknownKeys.begin(); it != unknownKeys.end(); ++it)
+    {
+        printf("WARNING: SceneBinary has no field for '%s', it is left out\n", it->c_str());
+    }
+
+    FILE *f = fopen(outPath.c_str(), "wb");
+    if (f == NULL)
+    {
+        printf("ERROR: SceneBinary can't write %s\n", outPath.c_str());
+        return false;
+    }
+    bool ok = fwrite(&data[0], 1, data.size(), f) == data.size();
+    ok = fclose(f) == 0 && ok;
+    if (!ok)
+    {
+        printf("ERROR: SceneBinary failed writing %s\n", outPath.c_str());
+    }
+    return ok;
+}
+
+// -----------------------------------------------------------------------------------
+// The keys we have no field for are collected rather than printed, so a caller that
+// converts a scene in parts can report them once.
+bool SceneBinary::CompileBuffer(const YAML::Node &root, std::vector<char> &out, std::set<std::string> &unknownKeys)
+{
+    SceneWriter writer;
+    try
+    {
+        writer.Add(root);
+    }
+    catch (std::exception &e)
+    {
+        printf("ERROR: SceneBinary can't convert the scene: %s\n", e.what());
+        return false;
+    }
+    unknownKeys.insert(writer.unknownKeys.begin(), writer.unknownKeys.end());
+
+    SceneBinaryHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = SCENE_BINARY_MAGIC;
+    header.version = SCENE_BINARY_VERSION;
+    header.numRoots = root.IsSequence() ? root.size() : 1;
+
+    std::vector<uint32_t> offsets;
+    std::string blob;
+    for (size_t i = 0; i < writer.strings.size(); ++i)
+    {
+        offsets.push_back(blob.size());
+        blob += writer.strings[i];
+        blob += '\0';
+    }
+    blob.resize(Align4(blob.size()), '\0');
+
+    header.numStrings = offsets.size();
+    header.stringOffsets = sizeof(header);
+    header.stringBlob = header.stringOffsets + offsets.size() * sizeof(uint32_t);
+    header.stringBlobSize = blob.size();
+    header.numRefs = writer.refs.size();
+    header.refs = header.stringBlob + blob.size();
+    header.numNodes = writer.nodes.size();
+    header.nodes = header.refs + writer.refs.size() * sizeof(uint32_t);
+
+    out.resize(header.nodes + writer.nodes.size() * sizeof(SceneBinaryNode));
+    memcpy(&out[0], &header, sizeof(header));
+    if (!offsets.empty())       memcpy(&out[header.stringOffsets], &offsets[0], offsets.size() * sizeof(uint32_t));
+    if (!blob.empty())          memcpy(&out[header.stringBlob], blob.data(), blob.size());
+    if (!writer.refs.empty())   memcpy(&out[header.refs], &writer.refs[0], writer.refs.size() * sizeof(uint32_t));
+    if (!writer.nodes.empty())  memcpy(&out[header.nodes], &writer.nodes[0], writer.nodes.size() * sizeof(SceneBinaryNode));
+    return true;
+}
+
+// ===================================================================================
+// The loader
+// ===================================================================================
+bool SceneBinary::Open(const std::string &_path)
+{
+    Close();
+    int fd = open(_path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        printf("ERROR: SceneBinary can't open %s\n", _path.c_str());
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(SceneBinaryHeader))
+    {
+        close(fd);
+        printf("ERROR: SceneBinary %s is too short\n", _path.c_str());
+        return false;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+    {
+        printf("ERROR: SceneBinary can't map %s\n", _path.c_str());
+        return false;
+    }
+    path = _path;
+    mapped = true;
+    if (!Use((const char *)map, st.st_size))
+    {
+        printf("ERROR: SceneBinary %s is not a valid compiled scene\n", _path.c_str());
+        Close();
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Takes the contents of the buffer, data is left empty.
+bool SceneBinary::OpenBuffer(std::vector<char> &data)
+{
+    Close();
+    owned.swap(data);
+    path = "<memory>";
+    if (owned.size() < sizeof(SceneBinaryHeader) || !Use(&owned[0], owned.size()))
+    {
+        printf("ERROR: SceneBinary buffer is not a valid compiled scene\n");
+        Close();
+        return false;
+    }
+    MemoryAccounting::Resize(MEM_SCENE_DATA, accounted, owned.capacity());
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneBinary::Use(const char *_base, size_t _length)
+{
+    base = _base;
+    length = _length;
+    header = (const SceneBinaryHeader *)base;
+    if (header->magic == SCENE_BINARY_MAGIC && header->version < SCENE_BINARY_VERSION && !Upgrade())
+    {
+        return false;
+    }
+    if (!Validate())
+    {
+        return false;
+    }
+    stringOffsets = (const uint32_t *)(base + header->stringOffsets);
+    stringBlob = base + header->stringBlob;
+    refs = (const uint32_t *)(base + header->refs);
+    nodes = (const SceneBinaryNode *)(base + header->nodes);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+namespace
+{
+    struct SceneBinaryNodeV1            // SceneBinaryNode before the name
+    {
+        uint32_t type;
+        uint32_t fields;
+        int32_t  enabled;
+        float    rotation, scaleX, scaleY;
+        float    position[3];
+        float    alpha;
+        uint32_t visibleState;
+        uint32_t resPath;
+        float    size[3];
+        uint32_t renderSetFirst, renderSetCount;
+        uint32_t firstChild, numChildren;
+    };
+}
+
+// -----------------------------------------------------------------------------------
+// The nodes are last, so everything before them is copied as it is and the nodes are
+// widened. A mapping is let go of, the scene is read from owned after.
+bool SceneBinary::Upgrade()
+{
+    const SceneBinaryHeader &h = *header;
+    if (h.version != 1 || (h.nodes & 3) || h.nodes < sizeof(SceneBinaryHeader) ||
+        h.nodes + (uint64_t)h.numNodes * sizeof(SceneBinaryNodeV1) > length)
+    {
+        return false;
+    }
+    std::vector<char> upgraded(h.nodes + (size_t)h.numNodes * sizeof(SceneBinaryNode));
+    memcpy(&upgraded[0], base, h.nodes);
+    const SceneBinaryNodeV1 *from = (const SceneBinaryNodeV1 *)(base + h.nodes);
+    SceneBinaryNode *to = (SceneBinaryNode *)(&upgraded[0] + h.nodes);
+    for (uint32_t i = 0; i < h.numNodes; ++i)
+    {
+        const SceneBinaryNodeV1 &o = from[i];
+        SceneBinaryNode &n = to[i];
+        n.type = o.type;
+        n.fields = o.fields & ~SBF_NAME;
+        n.enabled = o.enabled;
+        n.rotation = o.rotation;
+        n.scaleX = o.scaleX;
+        n.scaleY = o.scaleY;
+        memcpy(n.position, o.position, sizeof(n.position));
+        n.alpha = o.alpha;
+        n.visibleState = o.visibleState;
+        n.resPath = o.resPath;
+        memcpy(n.size, o.size, sizeof(n.size));
+        n.name = SCENE_BINARY_NONE;
+        n.renderSetFirst = o.renderSetFirst;
+        n.renderSetCount = o.renderSetCount;
+        n.firstChild = o.firstChild;
+        n.numChildren = o.numChildren;
+    }
+    ((SceneBinaryHeader *)&upgraded[0])->version = SCENE_BINARY_VERSION;
+    if (mapped)
+    {
+        munmap((void *)base, length);
+        mapped = false;
+    }
+    owned.swap(upgraded);
+    base = &owned[0];
+    length = owned.size();
+    header = (const SceneBinaryHeader *)base;
+    MemoryAccounting::Resize(MEM_SCENE_DATA, accounted, owned.capacity());
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+void SceneBinary::Close()
+{
+    if (base != NULL && mapped)
+    {
+        munmap((void *)base, length);
+    }
+    owned.clear();
+    MemoryAccounting::Free(MEM_SCENE_DATA, accounted);
+    accounted = 0;
+    mapped = false;
+    base = NULL;
+    length = 0;
+    header = NULL;
+    stringOffsets = NULL;
+    stringBlob = NULL;
+    refs = NULL;
+    nodes = NULL;
+}
+
+// -----------------------------------------------------------------------------------
+// Every offset and id is checked once here, so the accessors don't have to.
+bool SceneBinary::Validate()
+{
+    const SceneBinaryHeader &h = *header;
+    if (h.magic != SCENE_BINARY_MAGIC || h.version != SCENE_BINARY_VERSION)
+    {
+        return false;
+    }
+    uint64_t end = length;
+    if ((h.stringOffsets | h.stringBlob | h.refs | h.nodes) & 3 ||
+        h.stringOffsets + (uint64_t)h.numStrings * 4 > end ||
+        h.stringBlob + (uint64_t)h.stringBlobSize > end ||
+        h.refs + (uint64_t)h.numRefs * 4 > end ||
+        h.nodes + (uint64_t)h.numNodes * sizeof(SceneBinaryNode) > end ||
+        h.numRoots > h.numNodes)
+    {
+        return false;
+    }
+    const uint32_t *offs = (const uint32_t *)(base + h.stringOffsets);
+    const char *blob = base + h.stringBlob;
+    if (h.numStrings > 0 && (h.stringBlobSize == 0 || blob[h.stringBlobSize - 1] != '\0'))
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < h.numStrings; ++i)
+    {
+        if (offs[i] >= h.stringBlobSize) return false;
+    }
+    const uint32_t *r = (const uint32_t *)(base + h.refs);
+    for (uint32_t i = 0; i < h.numRefs; ++i)
+    {
+        if (r[i] >= h.numStrings) return false;
+    }
+    const SceneBinaryNode *n = (const SceneBinaryNode *)(base + h.nodes);
+    uint32_t claimed = h.numRoots;      // the nodes up to here are a root or some node's child
+    for (uint32_t i = 0; i < h.numNodes; ++i)
+    {
+        const SceneBinaryNode &node = n[i];
+        if (node.type >= h.numStrings ||
+            (node.visibleState != SCENE_BINARY_NONE && node.visibleState >= h.numStrings) ||
+            (node.resPath != SCENE_BINARY_NONE && node.resPath >= h.numStrings) ||
+            (node.name != SCENE_BINARY_NONE && node.name >= h.numStrings) ||
+            (uint64_t)node.renderSetFirst + node.renderSetCount > h.numRefs)
+        {
+            return false;
+        }
+        // children always come later, so the tree can't loop
+        if (node.numChildren > 0 && (node.firstChild <= i || (uint64_t)node.firstChild + node.numChildren > h.numNodes))
+        {
+            return false;
+        }
+        // .. and in the order of their parents, so a range that starts before the last
+        // one ended has a node with two parents
+        if (node.numChildren > 0)
+        {
+            if (node.firstChild < claimed)
+            {
+                return false;
+            }
+            claimed = node.firstChild + node.numChildren;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// A subtree the view can't see, disabled or on none of the view's render sets. Like
+// DecodeYaml the listed sets are added to the default "**ALL**", not in place of it.
+bool SceneBinary::Hidden(const SceneBinaryNode &node, const stringList *view)
+{
+    if ((node.fields & SBF_ENABLED) && node.enabled == 0)
+    {
+        return true;
+    }
+    if (std::find(view->begin(), view->end(), "**ALL**") != view->end())
+    {
+        return false;
+    }
+    for (uint32_t i = 0; i < node.renderSetCount; ++i)
+    {
+        if (std::find(view->begin(), view->end(), GetString(GetRef(node.renderSetFirst + i))) != view->end())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+RO_BaseVector SceneBinary::Build(Scene *scene, SceneNodeFactory factory, const stringList *lazyView)
+{
+    std::vector<uint32_t> top;
+    for (uint32_t i = 0; IsOpen() && i < header->numRoots; ++i)
+    {
+        top.push_back(i);
+    }
+    int built = 0;
+    return BuildTree(scene, factory, top, lazyView, false, built);
+}
+
+// -----------------------------------------------------------------------------------
+RO_BasePtr SceneBinary::BuildNode(Scene *scene, SceneNodeFactory factory, uint32_t index, int &built)
+{
+    RO_BaseVector roots = BuildTree(scene, factory, std::vector<uint32_t>(1, index), NULL, true, built);
+    return roots.empty() ? RO_BasePtr() : roots[0];
+}
+
+// -----------------------------------------------------------------------------------
+RO_BaseVector SceneBinary::BuildTracked(Scene *scene, SceneNodeFactory factory, const std::vector<uint32_t> &top,
+                                        std::vector<RO_BasePtr> &objects)
+{
+    objects.resize(IsOpen() ? header->numNodes : 0);
+    int built = 0;
+    return BuildTree(scene, factory, top, NULL, false, built, &objects);
+}
+
+// -----------------------------------------------------------------------------------
+// Breadth first from the top nodes. Nodes the factory doesn't know are skipped along
+// with everything under them. Nothing built here is reachable from the render thread
+// yet, so each node is decoded as a BulkLoad of its own; only the node being decoded
+// skips the commands, never whatever the factory or other python code touches.
+//
+// For a BuildNode the top node's RO_Lazy keeps its enabled flag, so the node itself is
+// left enabled, and every child with children of its own is left lazy. A big layer
+// then comes in a level at a time as the levels are collected.
+RO_BaseVector SceneBinary::BuildTree(Scene *scene, SceneNodeFactory factory, const std::vector<uint32_t> &top,
+                                     const stringList *lazyView, bool lazyChildren, int &built, std::vector<RO_BasePtr> *objects)
+{
+    RO_BaseVector roots;
+    built = 0;
+    if (!IsOpen())
+    {
+        return roots;
+    }
+    std::deque< std::pair<uint32_t, RO_BasePtr> > queue;
+    for (size_t i = 0; i < top.size(); ++i)
+    {
+        queue.push_back(std::make_pair(top[i], RO_BasePtr()));
+    }
+    while (!queue.empty())
+    {
+        uint32_t i = queue.front().first;
+        RO_BasePtr parent = queue.front().second;
+        queue.pop_front();
+
+        const SceneBinaryNode &node = nodes[i];
+        bool lazy = node.numChildren > 0 && (lazyChildren ? (bool)parent : (lazyView != NULL && Hidden(node, lazyView)));
+        RO_BasePtr obj;
+        if (lazy)
+        {
+            obj = RO_BasePtr(new RO_Lazy(scene, shared_from_this(), i, factory));
+        }
+        else
+        {
+            obj = factory(scene, GetString(node.type));
+            if (!obj)
+            {
+                printf("ERROR: SceneBinary has no render object for type '%s'\n", GetString(node.type));
+                continue;
+            }
+            BulkLoad bulk(obj.get());
+            if (lazyChildren && !parent)
+            {
+                SceneBinaryNode own = node;
+                own.fields &= ~SBF_ENABLED;
+                obj->DecodeBinary(*this, own);
+            }
+            else
+            {
+                obj->DecodeBinary(*this, node);
+            }
+            for (uint32_t c = 0; c < node.numChildren; ++c)
+            {
+                queue.push_back(std::make_pair(node.firstChild + c, obj));
+            }
+        }
+        ++built;
+        if (objects != NULL)
+        {
+            (*objects)[i] = obj;
+        }
+        if (!parent)
+        {
+            roots.push_back(obj);
+        }
+        else if (!parent->AddChild(obj))
+        {
+            printf("ERROR: SceneBinary '%s' can't hold children\n", GetString(nodes[i].type));
+        }
+    }
+    return roots;
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneBinary::Load(RO_BasePtr parent, Scene *scene, SceneNodeFactory factory, const stringList *lazyView)
+{
+    RO_BaseVector roots = Build(scene, factory, lazyView);
+    if (roots.empty())
+    {
+        return false;
+    }
+    parent->Attach(roots);
+    return true;
+}
@@ -0,0 +1,140 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneBinary.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __SCENE_BINARY_HPP__
+#define __SCENE_BINARY_HPP__
+#include <stdio.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <set>
+#include <boost/function.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include "yaml-cpp/yaml.h"
+#include "ro_base.hpp"
+
+class SceneBinary;
+typedef boost::shared_ptr<SceneBinary> SceneBinaryPtr;
+
+#define SCENE_BINARY_MAGIC      0x53544453      // "SDTS" read little endian
+#define SCENE_BINARY_VERSION    2
+#define SCENE_BINARY_NONE       0xffffffffu     // no string, no children
+
+// -----------------------------------------------------------------------------------
+// The layout of a compiled scene, everything is little endian and 4 byte aligned so
+// the records can be used straight out of the mapping.
+//
+//      SceneBinaryHeader
+//      uint32_t    string offsets[numStrings]      into the string blob
+//      char        string blob                     NUL terminated, padded to 4
+//      uint32_t    string ids[numRefs]             the render set lists
+//      SceneBinaryNode nodes[numNodes]             breadth first, children contiguous
+//
+// Version 1 nodes had no name, they are copied into the current layout on open.
+// Strings are interned, a resPath shared by a thousand tiles is stored once.
+struct SceneBinaryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t numStrings, stringOffsets, stringBlob, stringBlobSize;
+    uint32_t numRefs, refs;
+    uint32_t numNodes, nodes;
+    uint32_t numRoots;          // the first numRoots nodes are the top level
+};
+
+// which fields of a node were in the YAML, only those are set on load
+enum SceneBinaryField
+{
+    SBF_ENABLED         = 1 << 0,
+    SBF_ROTATION        = 1 << 1,
+    SBF_SCALEX          = 1 << 2,
+    SBF_SCALEY          = 1 << 3,
+    SBF_POSITION        = 1 << 4,
+    SBF_ALPHA           = 1 << 5,
+    SBF_RENDERSET       = 1 << 6,
+    SBF_VISIBLESTATE    = 1 << 7,
+    SBF_RESPATH         = 1 << 8,
+    SBF_SIZE            = 1 << 9,
+    SBF_NAME            = 1 << 10,
+};
+
+struct SceneBinaryNode
+{
+    uint32_t type;              // string id of the node type
+    uint32_t fields;            // SceneBinaryField bits
+    int32_t  enabled;
+    float    rotation, scaleX, scaleY;
+    float    position[3];
+    float    alpha;
+    uint32_t visibleState;      // string id
+    uint32_t resPath;           // string id
+    float    size[3];
+    uint32_t name;              // string id, how a reload finds the node again
+    uint32_t renderSetFirst, renderSetCount;    // into the refs
+    uint32_t firstChild, numChildren;           // node indices
+};
+
+// makes the render object for a node type, the scene's YAML loader has the same
+typedef boost::function<RO_BasePtr (Scene *scene, const std::string &type)> SceneNodeFactory;
+
+// -----------------------------------------------------------------------------------
+// A compiled scene file mapped into memory. Compile converts a YAML scene, Open maps
+// one and Build makes the render objects from it. Create it with a SceneBinaryPtr, lazy
+// subtrees hold on to it. The nodes are read in place, the
+// only work per node is creating the object and setting the fields it has.
+class SceneBinary : public boost::enable_shared_from_this<SceneBinary>
+{
+private:
+    std::string         path;
+    std::vector<char>   owned;          // the data when opened from a buffer
+    bool                mapped;         // base is a file mapping
+    const char         *base;           // the mapping, or owned
+    size_t              length;         // ..
+    long long           accounted;      // MemoryAccounting, owned
+    const SceneBinaryHeader *header;
+    const uint32_t     *stringOffsets;
+    const char         *stringBlob;
+    const uint32_t     *refs;
+    const SceneBinaryNode *nodes;
+
+    bool Validate();
+    bool Upgrade();                     // an older version into the current layout, in owned
+    bool Use(const char *base, size_t length);
+    bool Hidden(const SceneBinaryNode &node, const stringList *view);
+    RO_BaseVector BuildTree(Scene *scene, SceneNodeFactory factory, const std::vector<uint32_t> &top,
+                            const stringList *lazyView, bool lazyChildren, int &built, std::vector<RO_BasePtr> *objects = NULL);
+
+public:
+    SceneBinary();
+    ~SceneBinary();
+    static void Boost();
+
+    static bool Compile(const std::string &yamlPath, const std::string &outPath);  // YAML to binary
+    static bool CompileNode(const YAML::Node &root, const std::string &outPath);    // ..
+    static bool CompileBuffer(const YAML::Node &root, std::vector<char> &out, std::set<std::string> &unknownKeys);  // .. into memory
+
+    bool Open(const std::string &path);         // map the file, false if it isn't a valid scene
+    bool OpenBuffer(std::vector<char> &data);   // use a compiled buffer, takes its contents
+    void Close();
+    bool IsOpen()                               { return base != NULL; }
+
+    int  GetNumNodes()                          { return header ? header->numNodes : 0; }
+    int  GetNumRoots()                          { return header ? header->numRoots : 0; }
+    int  GetNumStrings()                        { return header ? header->numStrings : 0; }
+    const SceneBinaryNode &GetNode(uint32_t i)  { return nodes[i]; }
+    const char *GetString(uint32_t id)          { return id == SCENE_BINARY_NONE ? "" : stringBlob + stringOffsets[id]; }
+    uint32_t GetRef(uint32_t i)                 { return refs[i]; }
+
+    // The top level objects with their children attached. With a lazyView, subtrees that
+    // are disabled or on none of its render sets are left as an RO_Lazy, which keeps
+    // this SceneBinary open and builds them the first time they are collected.
+    RO_BaseVector Build(Scene *scene, SceneNodeFactory factory, const stringList *lazyView = NULL);
+    RO_BasePtr BuildNode(Scene *scene, SceneNodeFactory factory, uint32_t index, int &built);     // one lazy subtree, a level deep
+    RO_BaseVector BuildTracked(Scene *scene, SceneNodeFactory factory, const std::vector<uint32_t> &top,
+                               std::vector<RO_BasePtr> &objects);      // whole subtrees, objects[node] is what each node made
+    bool Load(RO_BasePtr parent, Scene *scene, SceneNodeFactory factory, const stringList *lazyView = NULL);  // Build, then one Attach to the parent
+};
+
+#endif
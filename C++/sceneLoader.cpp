@@ -0,0 +1,267 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneLoader.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <boost/bind.hpp>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <set>
+
+using namespace boost::python;
+using namespace std;
+
+#include "sceneLoader.hpp"
+#include "gilGuard.hpp"
+#include "memoryAccounting.hpp"
+
+// more parts than threads, so one slow layer doesn't leave the other threads idle
+#define PARTS_PER_THREAD    4
+
+// -----------------------------------------------------------------------------------
+SceneLoader::SceneLoader(int numThreads) :
+    pool(new WorkerPool(numThreads))
+  , jobs()
+  , numParts(0)
+  , decodeMs(0)
+  , buildMs(0)
+{}
+
+// -----------------------------------------------------------------------------------
+SceneLoader::SceneLoader(WorkerPoolPtr _pool) :
+    pool(_pool)
+  , jobs()
+  , numParts(0)
+  , decodeMs(0)
+  , buildMs(0)
+{}
+
+// -----------------------------------------------------------------------------------
+SceneLoaderPtr SceneLoader::Create(FramePipelinePtr pipeline)
+{
+    if (!pipeline)
+    {
+        return SceneLoaderPtr(new SceneLoader());
+    }
+    return SceneLoaderPtr(new SceneLoader(pipeline->GetPool()));
+}
+
+// -----------------------------------------------------------------------------------
+void SceneLoader::Boost()
+{
+    class_ < SceneLoader, SceneLoaderPtr, boost::noncopyable >("SceneLoader", "Parses the layers of a YAML scene in parallel", no_init)
+        .def("__init__", make_constructor(&SceneLoader::Create))
+        .def("Load", &SceneLoader::PyLoad, "Load(parent, yamlPath, factory, lazyView) build the scene under parent, factory(type) returns the RO_Base for a node type")
+        .add_property("numThreads", &SceneLoader::GetNumThreads)
+        .add_property("numParts", &SceneLoader::GetNumParts, "Parts the last scene was split into")
+        .add_property("decodeMs", &SceneLoader::GetDecodeMs, "Time the last load spent parsing, on the workers")
+        .add_property("buildMs", &SceneLoader::GetBuildMs, "Time the last load spent making render objects")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+// Only a block sequence at the top level is split, every line in column 0 is then
+// either an entry "- ..." or a comment, and an entry runs until the next one. Each
+// part is a valid block sequence of whole entries. Anything else, a mapping, a flow
+// sequence or several documents, is parsed as one part.
+bool SceneLoader::Split(const std::string &text, int wantParts, std::vector<std::string> &parts)
+{
+    std::vector<size_t> entries;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        char c = text[pos];
+        if (c == '-')
+        {
+            char next = pos + 1 < text.size() ? text[pos + 1] : '\n';
+            if (next != ' ' && next != '\n' && next != '\r')
+            {
+                return false;       // "---" or a scalar at the top
+            }
+            entries.push_back(pos);
+        }
+        else if (c != ' ' && c != '\t' && c != '#' && c != '\n' && c != '\r')
+        {
+            return false;
+        }
+        else if (entries.empty() && (c == ' ' || c == '\t'))
+        {
+            size_t first = text.find_first_not_of(" \t\r", pos);
+            if (first < end && text[first] != '#')
+            {
+                return false;       // indented content before the first entry
+            }
+        }
+        pos = end + 1;
+    }
+    if (entries.size() < 2 || wantParts < 2)
+    {
+        return false;
+    }
+
+    // cut at the entry boundaries nearest an even share of the text
+    parts.clear();
+    size_t start = entries[0];
+    size_t share = (text.size() - start) / wantParts + 1;
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        if (entries[i] - start >= share)
+        {
+            parts.push_back(text.substr(start, entries[i] - start));
+            start = entries[i];
+        }
+    }
+    parts.push_back(text.substr(start));
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+namespace
+{
+    // python thread, what the factory returns if it is a render object
+    RO_BasePtr PyFactory(object make, Scene *scene, const std::string &type)
+    {
+        object obj = make(type);
+        extract<RO_BasePtr> made(obj);
+        return made.check() ? made() : RO_BasePtr();
+    }
+
+    struct DecodedPart
+    {
+        std::vector<char>       data;
+        std::set<std::string>   unknownKeys;
+        bool                    ok;
+    };
+
+    // worker thread, plain data only
+    void DecodePart(const std::string *text, DecodedPart *out)
+    {
+        MemoryScope parsing(MEM_SCENE_DATA, text->size());     // the YAML tree, estimated by its text
+        try
+        {
+            out->ok = SceneBinary::CompileBuffer(YAML::Load(*text), out->data, out->unknownKeys);
+        }
+        catch (std::exception &)
+        {
+            out->ok = false;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Plain data only, so the other python threads run while we parse.
+bool SceneLoader::Decode(const std::string &text, std::vector<SceneBinaryPtr> &parts)
+{
+    ScopedGILRelease unlocked;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    std::vector<std::string> texts;
+    if (!Split(text, pool->GetNumThreads() * PARTS_PER_THREAD, texts))
+    {
+        texts.assign(1, text);
+    }
+    std::vector<DecodedPart> decoded(texts.size());
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        pool->Post(boost::bind(&DecodePart, &texts[i], &decoded[i]), jobs);
+    }
+    pool->Wait(jobs);
+
+    // an alias to an anchor in another part fails to parse on its own, the whole
+    // text is parsed in one piece then so the result never depends on the split.
+    bool ok = true;
+    for (size_t i = 0; i < decoded.size(); ++i)
+    {
+        ok = ok && decoded[i].ok;
+    }
+    if (!ok && texts.size() > 1)
+    {
+        texts.assign(1, text);
+        decoded.assign(1, DecodedPart());
+        DecodePart(&texts[0], &decoded[0]);
+        ok = decoded[0].ok;
+    }
+    if (!ok)
+    {
+        printf("ERROR: SceneLoader can't parse the scene\n");
+        return false;
+    }
+
+    std::set<std::string> unknownKeys;
+    parts.clear();
+    for (size_t i = 0; i < decoded.size(); ++i)
+    {
+        unknownKeys.insert(decoded[i].unknownKeys.begin(), decoded[i].unknownKeys.end());
+        SceneBinaryPtr part(new SceneBinary());
+        if (!part->OpenBuffer(decoded[i].data))
+        {
+            return false;
+        }
+        parts.push_back(part);
+    }
+    for (std::set<std::string>::iterator it = unknownKeys.begin(); it != unknownKeys.end(); ++it)
+    {
+        printf("WARNING: SceneLoader has no field for '%s', it is left out\n", it->c_str());
+    }
+    numParts = parts.size();
+    decodeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// The parts are built in document order, so the objects come out the same on any
+// number of threads.
+RO_BaseVector SceneLoader::LoadYaml(const std::string &path, Scene *scene, SceneNodeFactory factory, const stringList *lazyView)
+{
+    RO_BaseVector roots;
+    std::ifstream file(path.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+    {
+        printf("ERROR: SceneLoader can't open %s\n", path.c_str());
+        return roots;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+
+    std::vector<SceneBinaryPtr> parts;
+    if (!Decode(text.str(), parts))
+    {
+        return roots;
+    }
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < parts.size(); ++i)
+    {
+        RO_BaseVector partRoots = parts[i]->Build(scene, factory, lazyView);
+        roots.insert(roots.end(), partRoots.begin(), partRoots.end());
+    }
+    buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return roots;
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneLoader::Load(RO_BasePtr parent, const std::string &path, Scene *scene, SceneNodeFactory factory, const stringList *lazyView)
+{
+    RO_BaseVector roots = LoadYaml(path, scene, factory, lazyView);
+    if (roots.empty())
+    {
+        return false;
+    }
+    parent->Attach(roots);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneLoader::PyLoad(RO_BasePtr parent, const std::string &path, object factory, stringList lazyView)
+{
+    if (!parent)
+    {
+        printf("ERROR: SceneLoader.Load needs a parent\n");
+        return false;
+    }
+    return Load(parent, path, parent->GetScene(), boost::bind(&PyFactory, factory, _1, _2), lazyView.empty() ? NULL : &lazyView);
+}
@@ -0,0 +1,56 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneLoader.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __SCENE_LOADER_HPP__
+#define __SCENE_LOADER_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sceneBinary.hpp"
+#include "workerPool.hpp"
+#include "framePipeline.hpp"
+
+class SceneLoader;
+typedef boost::shared_ptr<SceneLoader> SceneLoaderPtr;
+
+// -----------------------------------------------------------------------------------
+// Loads a YAML scene on every core. The top level entries of a map are independent
+// layers, so the text is split between them and the parts are parsed and converted to
+// compiled SceneBinary buffers on the worker pool. Only plain data comes off the
+// workers: making a render object touches python, so the objects are built on the
+// calling thread in document order as a BulkLoad, and handed to the render thread
+// with one Attach. A lazyView leaves hidden layers unbuilt, see SceneBinary::Build.
+//
+// Made from a FramePipeline it parses on the pipeline's workers rather than starting
+// its own, a load then slows the frames it overlaps instead of fighting them for cores.
+//      loader = Graphics.SceneLoader(pipeline)
+//      loader.Load(layer, "scene.yaml", MakeNode, [])       MakeNode(type) returns an RO_Base
+class SceneLoader
+{
+private:
+    WorkerPoolPtr pool;             // the parse threads, maybe shared
+    WorkerGroup jobs;               // our jobs in it
+    int         numParts;           // stats for the last load
+    double      decodeMs;           // .. split, parse and convert
+    double      buildMs;            // .. making the render objects
+
+public:
+    SceneLoader(int numThreads = 0);                    // its own workers, 0 picks one less than the number of cores
+    SceneLoader(WorkerPoolPtr _pool);                   // parse on another's workers
+    static SceneLoaderPtr Create(FramePipelinePtr pipeline);    // python, the pipeline's workers, or its own for None
+    static void Boost();
+
+    static bool Split(const std::string &text, int numParts, std::vector<std::string> &parts);  // false if it can't be split
+    bool Decode(const std::string &text, std::vector<SceneBinaryPtr> &parts);  // parse and convert, no render objects
+    RO_BaseVector LoadYaml(const std::string &path, Scene *scene, SceneNodeFactory factory, const stringList *lazyView = NULL);  // python thread
+    bool Load(RO_BasePtr parent, const std::string &path, Scene *scene, SceneNodeFactory factory, const stringList *lazyView = NULL);  // LoadYaml, then one Attach
+    bool PyLoad(RO_BasePtr parent, const std::string &path, boost::python::object factory, stringList lazyView);  // .. into the parent's scene, factory(type) makes the objects. An empty view builds everything
+
+    int    GetNumThreads()                              { return pool->GetNumThreads(); }
+    int    GetNumParts()                                { return numParts; }
+    double GetDecodeMs()                                { return decodeMs; }
+    double GetBuildMs()                                 { return buildMs; }
+};
+
+#endif
@@ -0,0 +1,629 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneReloader.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+using namespace boost::python;
+using namespace std;
+
+#include "sceneReloader.hpp"
+#include "gilGuard.hpp"
+#include "memoryAccounting.hpp"
+
+// -----------------------------------------------------------------------------------
+SceneReloader::SceneReloader(RO_BasePtr _parent, Scene *_scene, SceneNodeFactory _factory) :
+    parent(_parent)
+  , scene(_scene)
+  , factory(_factory)
+  , text()
+  , items()
+  , scanned(true)
+  , roots()
+  , reparsed(0)
+  , updated(0)
+  , added(0)
+  , removed(0)
+  , compileMs(0)
+  , diffMs(0)
+  , accounted(0)
+{}
+
+// -----------------------------------------------------------------------------------
+SceneReloader::~SceneReloader()
+{
+    MemoryAccounting::Free(MEM_SCENE_DATA, accounted);
+}
+
+// -----------------------------------------------------------------------------------
+void SceneReloader::Boost()
+{
+    class_ < SceneReloader, SceneReloaderPtr, boost::noncopyable >("SceneReloader", "Applies the edits to a scene's YAML without reloading it", no_init)
+        .def("Load", &SceneReloader::Load)
+        .def("Reload", &SceneReloader::Reload)
+        .def("ReloadText", &SceneReloader::ReloadText)
+        .add_property("reparsed", &SceneReloader::GetReparsed, "Nodes the last reload had to parse")
+        .add_property("updated", &SceneReloader::GetUpdated, "Properties set by the last reload")
+        .add_property("added", &SceneReloader::GetAdded, "Subtrees built by the last reload")
+        .add_property("removed", &SceneReloader::GetRemoved, "Subtrees detached by the last reload")
+        .add_property("compileMs", &SceneReloader::GetCompileMs, "Time the last reload spent scanning and parsing")
+        .add_property("diffMs", &SceneReloader::GetDiffMs, "Time the last reload spent diffing and applying")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+// Anything already loaded is left where it is, the next load starts from nothing.
+bool SceneReloader::Load(const std::string &yamlPath)
+{
+    text.clear();
+    items.clear();
+    scanned = true;
+    roots.clear();
+    return Reload(yamlPath);
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneReloader::Reload(const std::string &yamlPath)
+{
+    std::ifstream file(yamlPath.c_str(), std::ios::in | std::ios::binary);
+    if (!file)
+    {
+        printf("ERROR: SceneReloader can't open %s\n", yamlPath.c_str());
+        return false;
+    }
+    std::ostringstream text;
+    text << file.rdbuf();
+    return ReloadText(text.str());
+}
+
+// -----------------------------------------------------------------------------------
+// The nodes by indentation: the entries of the top level sequence, and the items of a
+// sequence that is the block value of a node's __children key. An item runs until the
+// next line that is as far out as its "-", blank lines and comments go with the item
+// before them. False if the text isn't a block sequence at the top.
+bool SceneReloader::Scan(const std::string &text, std::vector<Item> &items)
+{
+    struct Open
+    {
+        int     item;
+        int     keyIndent;                  // the column of the node's keys, -1 until seen
+        int     childIndent;                // .. of its children's "-", -1 until seen
+        bool    inChildren;                 // the last key was __children
+    };
+    static const char childrenKey[] = "__children:";
+    const size_t childrenKeyLength = sizeof(childrenKey) - 1;
+
+    items.clear();
+    std::vector<Open> open;
+    size_t pos = 0;
+    while (pos < text.size())
+    {
+        size_t end = text.find('\n', pos);
+        if (end == std::string::npos)
+        {
+            end = text.size();
+        }
+        size_t first = text.find_first_not_of(' ', pos);
+        if (first >= end || text[first] == '#' || text[first] == '\r')
+        {
+            pos = end + 1;                  // blank or a comment
+            continue;
+        }
+        if (text[first] == '\t')
+        {
+            return false;
+        }
+        int indent = first - pos;
+        while (!open.empty() && items[open.back().item].indent >= indent)
+        {
+            items[open.back().item].end = pos;
+            open.pop_back();
+        }
+        bool dash = text[first] == '-' && (first + 1 == end || text[first + 1] == ' ' || text[first + 1] == '\r');
+        size_t key = first;
+        bool node = false;
+        if (open.empty())
+        {
+            if (indent != 0 || !dash)
+            {
+                return false;               // a mapping, "---" or a flow sequence
+            }
+            node = true;
+        }
+        else
+        {
+            Open &o = open.back();
+            if (o.keyIndent < 0)
+            {
+                o.keyIndent = indent;
+            }
+            if (dash && o.inChildren && (o.childIndent < 0 ? indent >= o.keyIndent : indent == o.childIndent))
+            {
+                o.childIndent = indent;
+                node = true;
+            }
+            else if (indent != o.keyIndent || dash)
+            {
+                key = std::string::npos;    // deeper, or an item of some other list
+            }
+        }
+        if (node)
+        {
+            Item item;
+            item.start = pos;
+            item.end = text.size();
+            item.indent = indent;
+            item.parent = open.empty() ? -1 : open.back().item;
+            items.push_back(item);
+            Open o;
+            o.item = items.size() - 1;
+            o.childIndent = -1;
+            o.inChildren = false;
+            key = text.find_first_not_of(' ', first + 1);
+            o.keyIndent = key < end && text[key] != '#' && text[key] != '\r' ? (int)(key - pos) : -1;
+            open.push_back(o);
+        }
+        if (key < end && !open.empty() && (int)(key - pos) == open.back().keyIndent)
+        {
+            // a block __children, nothing but a comment after the colon
+            size_t after = key + childrenKeyLength;
+            bool children = text.compare(key, childrenKeyLength, childrenKey) == 0;
+            size_t rest = children ? text.find_first_not_of(' ', after) : end;
+            open.back().inChildren = children && (rest >= end || text[rest] == '#' || text[rest] == '\r');
+        }
+        pos = end + 1;
+    }
+    return !items.empty();
+}
+
+// -----------------------------------------------------------------------------------
+// -1 for the top level.
+void SceneReloader::Children(const std::vector<Item> &items, int item, std::vector<int> &children)
+{
+    children.clear();
+    size_t stop = item < 0 ? std::string::npos : items[item].end;
+    for (size_t i = item + 1; i < items.size() && items[i].start < stop; ++i)
+    {
+        if (items[i].parent == item)
+        {
+            children.push_back(i);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// An item's text without its children's, everything its own properties come from.
+// The children of an item are contiguous.
+std::string SceneReloader::OwnText(const std::string &text, const std::vector<Item> &items, int item, const std::vector<int> &children)
+{
+    const Item &it = items[item];
+    if (children.empty())
+    {
+        return text.substr(it.start, it.end - it.start);
+    }
+    size_t from = items[children.front()].start;
+    size_t to = items[children.back()].end;
+    return text.substr(it.start, from - it.start) + text.substr(to, it.end - to);
+}
+
+// -----------------------------------------------------------------------------------
+// The text of a run of siblings moved out to column 0, so it parses as a scene of its own.
+std::string SceneReloader::RunText(const std::string &text, const std::vector<Item> &items, const std::vector<int> &children, size_t first, size_t count)
+{
+    std::string out;
+    if (count == 0)
+    {
+        return out;
+    }
+    size_t indent = items[children[first]].indent;
+    size_t pos = items[children[first]].start;
+    size_t stop = items[children[first + count - 1]].end;
+    out.reserve(stop - pos);
+    while (pos < stop)
+    {
+        size_t end = std::min(text.find('\n', pos), stop);
+        size_t skip = 0;
+        while (skip < indent && pos + skip < end && text[pos + skip] == ' ')
+        {
+            ++skip;
+        }
+        out.append(text, pos + skip, end - pos - skip);
+        out += '\n';
+        pos = end + 1;
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------------
+bool SceneReloader::Compile(const std::string &text, SceneBinaryPtr &binary)
+{
+    std::vector<char> data;
+    std::set<std::string> unknownKeys;
+    MemoryScope parsing(MEM_SCENE_DATA, text.size());      // the YAML tree, estimated by its text
+    try
+    {
+        if (!SceneBinary::CompileBuffer(YAML::Load(text), data, unknownKeys))
+        {
+            return false;
+        }
+    }
+    catch (std::exception &)
+    {
+        return false;
+    }
+    binary = SceneBinaryPtr(new SceneBinary());
+    return binary->OpenBuffer(data);
+}
+
+// -----------------------------------------------------------------------------------
+// Moves down while a single node changed and only in its children, then parses the
+// run of siblings that changed, old and new. Only the scan and the parse run without
+// the GIL, the objects are never touched there.
+bool SceneReloader::ReloadText(const std::string &nextText)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    ScopedGILRelease unlocked;
+    std::vector<Item> nextItems;
+    bool nextScanned = Scan(nextText, nextItems);
+    std::vector<int> path;                  // the live siblings, by index, that lead to the run
+    std::vector<int> prevKids, nextKids;
+    size_t first = 0, prevCount = 0, nextCount = 0;
+    bool whole = !scanned || !nextScanned;
+    if (!whole)
+    {
+        const std::vector<Live> *siblings = &roots;
+        Children(items, -1, prevKids);
+        Children(nextItems, -1, nextKids);
+        whole = prevKids.size() != roots.size();
+        while (!whole)
+        {
+            size_t a = 0, b = 0;
+            size_t shorter = std::min(prevKids.size(), nextKids.size());
+            for (; a < shorter; ++a)
+            {
+                const Item &o = items[prevKids[a]], &n = nextItems[nextKids[a]];
+                if (text.compare(o.start, o.end - o.start, nextText, n.start, n.end - n.start) != 0)
+                {
+                    break;
+                }
+            }
+            for (; a + b < shorter; ++b)
+            {
+                const Item &o = items[prevKids[prevKids.size() - 1 - b]], &n = nextItems[nextKids[nextKids.size() - 1 - b]];
+                if (text.compare(o.start, o.end - o.start, nextText, n.start, n.end - n.start) != 0)
+                {
+                    break;
+                }
+            }
+            first = a;
+            prevCount = prevKids.size() - a - b;
+            nextCount = nextKids.size() - a - b;
+            if (prevCount != 1 || nextCount != 1 || !(*siblings)[a].object)
+            {
+                break;
+            }
+            std::vector<int> prevDown, nextDown;
+            Children(items, prevKids[a], prevDown);
+            Children(nextItems, nextKids[a], nextDown);
+            if ((prevDown.empty() && nextDown.empty()) || prevDown.size() != (*siblings)[a].children.size() ||
+                OwnText(text, items, prevKids[a], prevDown) != OwnText(nextText, nextItems, nextKids[a], nextDown))
+            {
+                break;                      // the node itself changed
+            }
+            path.push_back(a);
+            siblings = &(*siblings)[a].children;
+            prevKids.swap(prevDown);
+            nextKids.swap(nextDown);
+        }
+        if (!whole && prevCount == 0 && nextCount == 0)
+        {
+            // only comments or blank lines moved
+            unlocked.Restore();
+            text = nextText;
+            items.swap(nextItems);
+            reparsed = updated = added = removed = 0;
+            compileMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            diffMs = 0;
+            return true;
+        }
+    }
+
+    SceneBinaryPtr prev, next;
+    if (!whole)
+    {
+        // an alias out of the run doesn't parse, and an anchor in it may be used outside
+        std::string nextRun = RunText(nextText, nextItems, nextKids, first, nextCount);
+        std::string prevRun = RunText(text, items, prevKids, first, prevCount);
+        whole = nextRun.find('&') != std::string::npos || prevRun.find('&') != std::string::npos ||
+                (nextCount > 0 && (!Compile(nextRun, next) || next->GetNumRoots() != (int)nextCount)) ||
+                (prevCount > 0 && (!Compile(prevRun, prev) || prev->GetNumRoots() != (int)prevCount));
+    }
+    if (whole)
+    {
+        path.clear();
+        first = 0;
+        prev.reset();
+        next.reset();
+        if (!Compile(nextText, next))
+        {
+            printf("ERROR: SceneReloader can't parse the scene\n");
+            return false;
+        }
+        if (!text.empty() && (!Compile(text, prev) || prev->GetNumRoots() != (int)roots.size()))
+        {
+            prev.reset();                   // can't be diffed, it is replaced
+        }
+        nextCount = next->GetNumRoots();
+        prevCount = prev ? roots.size() : 0;
+    }
+    if (!prev)
+    {
+        prev = SceneBinaryPtr(new SceneBinary());
+    }
+    if (!next)
+    {
+        next = SceneBinaryPtr(new SceneBinary());
+    }
+    unlocked.Restore();
+    std::chrono::steady_clock::time_point compiled = std::chrono::steady_clock::now();
+    compileMs = std::chrono::duration<double, std::milli>(compiled - start).count();
+    reparsed = next->GetNumNodes();
+
+    std::vector<Live> *siblings = &roots;
+    RO_BasePtr live = parent;
+    for (size_t i = 0; i < path.size(); ++i)
+    {
+        live = (*siblings)[path[i]].object;
+        siblings = &(*siblings)[path[i]].children;
+    }
+    std::vector<RO_BasePtr> prevObjects(prev->GetNumNodes()), nextObjects(next->GetNumNodes());
+    for (size_t i = 0; i < prevCount; ++i)
+    {
+        TakeObjects((*siblings)[first + i], *prev, i, prevObjects);
+    }
+    RO_BaseVector after;
+    for (size_t i = first + prevCount; i < siblings->size(); ++i)
+    {
+        if ((*siblings)[i].object)
+        {
+            after.push_back((*siblings)[i].object);
+        }
+    }
+    updated = added = removed = 0;
+    if (whole && prevCount < siblings->size())
+    {
+        parent->Detach(after);
+        removed += after.size();
+        after.clear();
+    }
+    Pass pass = { *next, *prev, prevObjects, nextObjects };
+    MatchChildren(pass, live, 0, nextCount, 0, prevCount, after);
+
+    std::vector<Live> made(nextCount);
+    for (size_t i = 0; i < nextCount; ++i)
+    {
+        MakeLive(*next, nextObjects, i, made[i]);
+    }
+    size_t dropped = whole ? siblings->size() : prevCount;
+    siblings->erase(siblings->begin() + first, siblings->begin() + first + dropped);
+    siblings->insert(siblings->begin() + first, made.begin(), made.end());
+
+    text = nextText;
+    items.swap(nextItems);
+    scanned = nextScanned;
+    MemoryAccounting::Resize(MEM_SCENE_DATA, accounted, text.capacity() + items.capacity() * sizeof(Item));
+    diffMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - compiled).count();
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// The live tree and the binary were made from the same text, so they line up.
+void SceneReloader::TakeObjects(const Live &live, SceneBinary &binary, uint32_t node, std::vector<RO_BasePtr> &objects)
+{
+    objects[node] = live.object;
+    const SceneBinaryNode &n = binary.GetNode(node);
+    for (uint32_t c = 0; c < n.numChildren && c < live.children.size(); ++c)
+    {
+        TakeObjects(live.children[c], binary, n.firstChild + c, objects);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void SceneReloader::MakeLive(SceneBinary &binary, const std::vector<RO_BasePtr> &objects, uint32_t node, Live &live)
+{
+    live.object = objects[node];
+    const SceneBinaryNode &n = binary.GetNode(node);
+    live.children.resize(n.numChildren);
+    for (uint32_t c = 0; c < n.numChildren; ++c)
+    {
+        MakeLive(binary, objects, n.firstChild + c, live.children[c]);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Nodes are the same node if they have the same name, or are both unnamed and the
+// same type.
+std::string SceneReloader::Key(SceneBinary &binary, const SceneBinaryNode &node)
+{
+    if (node.fields & SBF_NAME)
+    {
+        return std::string("n:") + binary.GetString(node.name);
+    }
+    return std::string("t:") + binary.GetString(node.type);
+}
+
+// -----------------------------------------------------------------------------------
+// The fields of the new node that differ from the old one, or that the old one didn't
+// have. Strings are compared by value, the two have their own string tables.
+uint32_t SceneReloader::ChangedFields(Pass &pass, const SceneBinaryNode &n, const SceneBinaryNode &o)
+{
+    uint32_t changed = n.fields & ~o.fields;
+    uint32_t both = n.fields & o.fields;
+    if ((both & SBF_ENABLED) && n.enabled != o.enabled)                                 changed |= SBF_ENABLED;
+    if ((both & SBF_ROTATION) && n.rotation != o.rotation)                              changed |= SBF_ROTATION;
+    if ((both & SBF_SCALEX) && n.scaleX != o.scaleX)                                    changed |= SBF_SCALEX;
+    if ((both & SBF_SCALEY) && n.scaleY != o.scaleY)                                    changed |= SBF_SCALEY;
+    if ((both & SBF_POSITION) && memcmp(n.position, o.position, sizeof(n.position)))    changed |= SBF_POSITION;
+    if ((both & SBF_ALPHA) && n.alpha != o.alpha)                                       changed |= SBF_ALPHA;
+    if ((both & SBF_SIZE) && memcmp(n.size, o.size, sizeof(n.size)))                   changed |= SBF_SIZE;
+    if ((both & SBF_VISIBLESTATE) && strcmp(pass.next.GetString(n.visibleState), pass.prev.GetString(o.visibleState)))
+    {
+        changed |= SBF_VISIBLESTATE;
+    }
+    if ((both & SBF_RESPATH) && strcmp(pass.next.GetString(n.resPath), pass.prev.GetString(o.resPath)))
+    {
+        changed |= SBF_RESPATH;
+    }
+    if (both & SBF_RENDERSET)
+    {
+        bool same = n.renderSetCount == o.renderSetCount;
+        for (uint32_t i = 0; same && i < n.renderSetCount; ++i)
+        {
+            same = strcmp(pass.next.GetString(pass.next.GetRef(n.renderSetFirst + i)), pass.prev.GetString(pass.prev.GetRef(o.renderSetFirst + i))) == 0;
+        }
+        if (!same)
+        {
+            changed |= SBF_RENDERSET;
+        }
+    }
+    return changed;
+}
+
+// -----------------------------------------------------------------------------------
+// Pairs up a run of siblings, diffs the pairs and puts the run in the new order. When
+// the keys line up one for one, which is the usual case for an edit, they are matched
+// in order without building the key map. after are the live siblings that follow the
+// run, they keep their place behind it. The container only appends, so the Arrange
+// takes everything from the first child out of place, new ones included, and adds it
+// again in order.
+void SceneReloader::MatchChildren(Pass &pass, RO_BasePtr live, uint32_t nFirst, uint32_t nCount, uint32_t oFirst, uint32_t oCount, const RO_BaseVector &after)
+{
+    bool inOrder = nCount == oCount;
+    for (uint32_t i = 0; inOrder && i < nCount; ++i)
+    {
+        inOrder = Key(pass.next, pass.next.GetNode(nFirst + i)) == Key(pass.prev, pass.prev.GetNode(oFirst + i));
+    }
+
+    std::vector<int> match(nCount, -1);
+    if (inOrder)
+    {
+        for (uint32_t i = 0; i < nCount; ++i)
+        {
+            match[i] = i;
+        }
+    }
+    else
+    {
+        // by name, or by type and how many unnamed nodes of that type came before
+        std::map<std::string, std::deque<int> > byKey;
+        for (uint32_t j = 0; j < oCount; ++j)
+        {
+            byKey[Key(pass.prev, pass.prev.GetNode(oFirst + j))].push_back(j);
+        }
+        for (uint32_t i = 0; i < nCount; ++i)
+        {
+            std::map<std::string, std::deque<int> >::iterator it = byKey.find(Key(pass.next, pass.next.GetNode(nFirst + i)));
+            if (it != byKey.end() && !it->second.empty())
+            {
+                match[i] = it->second.front();
+                it->second.pop_front();
+            }
+        }
+    }
+
+    std::vector<char> kept(oCount, 0);
+    std::vector<uint32_t> build;
+    for (uint32_t i = 0; i < nCount; ++i)
+    {
+        int j = match[i];
+        RO_BasePtr old = j >= 0 ? pass.prevObjects[oFirst + j] : RO_BasePtr();
+        if (old && Diff(pass, nFirst + i, oFirst + j, old))
+        {
+            kept[j] = 1;
+        }
+        else
+        {
+            build.push_back(nFirst + i);
+        }
+    }
+
+    RO_BaseVector detach, now, wanted;
+    for (uint32_t j = 0; j < oCount; ++j)
+    {
+        RO_BasePtr old = pass.prevObjects[oFirst + j];
+        if (old && kept[j])
+        {
+            now.push_back(old);
+        }
+        else if (old)
+        {
+            detach.push_back(old);
+        }
+    }
+    if (!detach.empty())
+    {
+        live->Detach(detach);
+        removed += detach.size();
+    }
+    if (!build.empty())
+    {
+        added += pass.next.BuildTracked(scene, factory, build, pass.nextObjects).size();
+    }
+    for (uint32_t i = 0; i < nCount; ++i)
+    {
+        if (pass.nextObjects[nFirst + i])
+        {
+            wanted.push_back(pass.nextObjects[nFirst + i]);
+        }
+    }
+    now.insert(now.end(), after.begin(), after.end());
+    wanted.insert(wanted.end(), after.begin(), after.end());
+    size_t k = 0;
+    while (k < now.size() && k < wanted.size() && now[k] == wanted[k])
+    {
+        ++k;
+    }
+    if (k < wanted.size())
+    {
+        live->Arrange(RO_BaseVector(wanted.begin() + k, wanted.end()));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// False if the old object can't be brought in line and has to be replaced. The name
+// is never set, it is python side only and the node was matched by it.
+bool SceneReloader::Diff(Pass &pass, uint32_t n, uint32_t o, RO_BasePtr live)
+{
+    const SceneBinaryNode &nn = pass.next.GetNode(n);
+    const SceneBinaryNode &on = pass.prev.GetNode(o);
+    if (strcmp(pass.next.GetString(nn.type), pass.prev.GetString(on.type)) != 0 || (on.fields & ~nn.fields))
+    {
+        return false;       // a different kind of object, or a property gone back to a default we don't know
+    }
+    uint32_t changed = ChangedFields(pass, nn, on) & ~SBF_NAME;
+    if (changed & SBF_RENDERSET)
+    {
+        return false;       // the render set list can only be added to
+    }
+    pass.nextObjects[n] = live;
+    if (changed)
+    {
+        SceneBinaryNode diff = nn;
+        diff.fields = changed;
+        live->DecodeBinary(pass.next, diff);
+        for (; changed; changed &= changed - 1)
+        {
+            ++updated;
+        }
+    }
+    MatchChildren(pass, live, nn.firstChild, nn.numChildren, on.firstChild, on.numChildren, RO_BaseVector());
+    return true;
+}
@@ -0,0 +1,98 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneReloader.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __SCENE_RELOADER_HPP__
+#define __SCENE_RELOADER_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sceneBinary.hpp"
+
+class SceneReloader;
+typedef boost::shared_ptr<SceneReloader> SceneReloaderPtr;
+
+// -----------------------------------------------------------------------------------
+// Keeps a loaded scene in step with its YAML while it is being edited. The text of a
+// block sequence scene is scanned for its nodes, the top level entries and the items
+// of every __children list, by indentation alone. On a reload the nodes are compared
+// by text from the top down: siblings whose text didn't change are skipped, and while
+// a single node changed only in its children the reload moves down into them. Only the
+// run of siblings left over is parsed, old and new, and diffed, so a one token edit
+// parses the one node it is in rather than its layer.
+//
+// The run is matched under its parent by name, or by type and order for nodes without
+// one. A matched node only gets the properties whose value changed, through the normal
+// command path, so its textures and state stay. New nodes are built as a BulkLoad,
+// nodes that went away are detached, and the run is put in the YAML's order with an
+// Arrange. A node whose type or render sets changed, or that lost a property, is
+// replaced. Children of the parent the reloader didn't make may end up ahead of the
+// run. A run with an anchor or an alias
+// in it, or a scene that isn't a block sequence, is diffed as a whole.
+class SceneReloader
+{
+private:
+    struct Item                             // a node in the text
+    {
+        size_t      start, end;             // from the start of its "- " line to the next line as far out
+        int         indent;                 // .. the column of the "-"
+        int         parent;                 // the item it is a child of, -1 at the top
+    };
+    struct Live                             // what a node made, children in the YAML's order
+    {
+        RO_BasePtr          object;
+        std::vector<Live>   children;
+    };
+    struct Pass                             // a run being diffed against its old self
+    {
+        SceneBinary             &next;
+        SceneBinary             &prev;
+        std::vector<RO_BasePtr> &prevObjects;
+        std::vector<RO_BasePtr> &nextObjects;
+    };
+
+    RO_BasePtr          parent;         // the top level nodes go under this
+    Scene              *scene;
+    SceneNodeFactory    factory;
+    std::string         text;           // the last load
+    std::vector<Item>   items;          // .. its nodes in document order
+    bool                scanned;        // .. items is good, the text is a block sequence
+    std::vector<Live>   roots;          // .. what its top level nodes made
+    long                reparsed;       // stats for the last reload, nodes parsed
+    long                updated;        // .. properties set
+    long                added;          // .. subtrees built
+    long                removed;        // .. subtrees detached
+    double              compileMs;      // .. scanning and parsing
+    double              diffMs;         // .. diffing and issuing the changes
+    long long           accounted;      // MemoryAccounting, the text and items
+
+    static bool Scan(const std::string &text, std::vector<Item> &items);
+    static void Children(const std::vector<Item> &items, int item, std::vector<int> &children);
+    static std::string OwnText(const std::string &text, const std::vector<Item> &items, int item, const std::vector<int> &children);
+    static std::string RunText(const std::string &text, const std::vector<Item> &items, const std::vector<int> &children, size_t first, size_t count);
+    static bool Compile(const std::string &text, SceneBinaryPtr &binary);
+    static std::string Key(SceneBinary &binary, const SceneBinaryNode &node);
+    static void TakeObjects(const Live &live, SceneBinary &binary, uint32_t node, std::vector<RO_BasePtr> &objects);
+    static void MakeLive(SceneBinary &binary, const std::vector<RO_BasePtr> &objects, uint32_t node, Live &live);
+    uint32_t ChangedFields(Pass &pass, const SceneBinaryNode &n, const SceneBinaryNode &o);
+    void MatchChildren(Pass &pass, RO_BasePtr live, uint32_t nFirst, uint32_t nCount, uint32_t oFirst, uint32_t oCount, const RO_BaseVector &after);
+    bool Diff(Pass &pass, uint32_t n, uint32_t o, RO_BasePtr live);
+
+public:
+    SceneReloader(RO_BasePtr _parent, Scene *_scene, SceneNodeFactory _factory);
+    ~SceneReloader();
+    static void Boost();
+
+    bool Load(const std::string &yamlPath);             // the first load, python thread
+    bool Reload(const std::string &yamlPath);           // apply the edits since the last load, python thread
+    bool ReloadText(const std::string &text);           // ..
+
+    long   GetReparsed()                                { return reparsed; }
+    long   GetUpdated()                                 { return updated; }
+    long   GetAdded()                                   { return added; }
+    long   GetRemoved()                                 { return removed; }
+    double GetCompileMs()                               { return compileMs; }
+    double GetDiffMs()                                  { return diffMs; }
+};
+
+#endif
@@ -0,0 +1,652 @@
+/* -----------------------------------------------------------------------------------
+   -- spriteBatcher.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <stddef.h>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "spriteBatcher.hpp"
+#include "utils.hpp"
+#include "renderStats.hpp"
+
+// the most instances we send in one draw, larger runs are split.
+#define MAX_BATCH_INSTANCES 4096
+
+// attribute locations of the instanced sprite shader
+#define ATTR_POSITION   0
+#define ATTR_TEXCOORD   1
+#define ATTR_MODEL      2       // uses 2, 3, 4, 5
+#define ATTR_UVRECT     6
+#define ATTR_ALPHA      7
+#define ATTR_DEPTH      8
+
+// -----------------------------------------------------------------------------------
+// The quad is the same one RO_Image draws with, 0 to BASEQUADSIDELENGTH on each side,
+// so the objects transforms can be used unchanged.
+static const char * spriteVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 vertPosition;\n"
+    "layout(location = 1) in vec2 vertTexCoord;\n"
+    "layout(location = 2) in mat4 instModel;\n"
+    "layout(location = 6) in vec4 instUVRect;\n"
+    "layout(location = 7) in float instAlpha;\n"
+    "layout(location = 8) in float instDepth;\n"
+    "uniform mat4 ProjView;\n"
+    "out vec2 fragTexCoord;\n"
+    "out float fragAlpha;\n"
+    "void main()\n"
+    "{\n"
+    "    fragTexCoord = mix(instUVRect.xy, instUVRect.zw, vertTexCoord);\n"
+    "    fragAlpha = instAlpha;\n"
+    "    gl_Position = ProjView * instModel * vec4(vertPosition, 1.0);\n"
+    "    gl_Position.z = instDepth * gl_Position.w;\n"
+    "}\n";
+
+static const char * spriteFragmentShader =
+    "#version 330 core\n"
+    "uniform sampler2D tex;\n"
+    "in vec2 fragTexCoord;\n"
+    "in float fragAlpha;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    color = texture(tex, fragTexCoord);\n"
+    "    color.a *= fragAlpha;\n"
+    "}\n";
+
+// -----------------------------------------------------------------------------------
+static GLuint CompileShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("ERROR: SpriteBatcher shader compile failed:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// -----------------------------------------------------------------------------------
+SpriteBatcher::SpriteBatcher() :
+    program(0)
+  , vaoID(0)
+  , quadVBO(0)
+  , quadEBO(0)
+  , instanceVBO(0)
+  , vpLocation(-1)
+  , texLocation(-1)
+  , batchTexture(0)
+  , instances()
+  , records()
+  , recording(false)
+  , recordOpaque(false)
+  , recordDepth(0.f)
+  , depthFBO(0)
+  , depthRB(0)
+  , depthFormat(0)
+  , depthRect(0, 0, 0, 0)
+  , sceneFBO(0)
+  , sceneProgram(0)
+  , sceneVAO(0)
+  , ownStateBound(false)
+  , settings(NULL)
+  , enabled(true)
+  , opaquePass(false)
+  , drawCalls(0)
+  , spritesBatched(0)
+  , spritesUnbatched(0)
+  , spritesOpaque(0)
+{
+    instances.reserve(MAX_BATCH_INSTANCES);
+}
+
+// -----------------------------------------------------------------------------------
+SpriteBatcher::~SpriteBatcher()
+{
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::Boost()
+{
+    class_ < SpriteBatcher, SpriteBatcherPtr, boost::noncopyable >("SpriteBatcher", "Instanced drawing of sprites that share a texture", no_init)
+        .add_property("enabled", &SpriteBatcher::GetEnabled, &SpriteBatcher::SetEnabled, "When disabled every object is drawn with its own draw call")
+        .add_property("drawCalls", &SpriteBatcher::GetDrawCalls, "Draw calls issued by the last render")
+        .add_property("spritesBatched", &SpriteBatcher::GetSpritesBatched, "Sprites drawn instanced by the last render")
+        .add_property("spritesUnbatched", &SpriteBatcher::GetSpritesUnbatched, "Objects drawn one at a time by the last render")
+        .add_property("opaquePass", &SpriteBatcher::GetOpaquePass, &SpriteBatcher::SetOpaquePass, "Draw opaque sprites first, front to back with depth testing. Render only, not the FramePipeline's packets")
+        .add_property("spritesOpaque", &SpriteBatcher::GetSpritesOpaque, "Sprites drawn in the opaque pass by the last render")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+bool SpriteBatcher::BuildProgram()
+{
+    GLuint vs = CompileShader(GL_VERTEX_SHADER, spriteVertexShader);
+    GLuint fs = CompileShader(GL_FRAGMENT_SHADER, spriteFragmentShader);
+    if (vs == 0 || fs == 0)
+    {
+        glDeleteShader(vs);
+        glDeleteShader(fs);
+        return false;
+    }
+    program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetProgramInfoLog(program, sizeof(log), NULL, log);
+        printf("ERROR: SpriteBatcher shader link failed:\n%s\n", log);
+        glDeleteProgram(program);
+        program = 0;
+        return false;
+    }
+    vpLocation = glGetUniformLocation(program, "ProjView");
+    texLocation = glGetUniformLocation(program, "tex");
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+bool SpriteBatcher::Init()
+{
+    GLFW_THREAD_CHECK();
+    if (!BuildProgram())
+    {
+        enabled = false;
+        return false;
+    }
+
+    const float L = BASEQUADSIDELENGTH;
+    GLfloat quad[] = {
+    //  x     y     z     u     v
+        0.f,  0.f,  0.f,  0.f,  0.f,
+        L,    0.f,  0.f,  1.f,  0.f,
+        L,    L,    0.f,  1.f,  1.f,
+        0.f,  L,    0.f,  0.f,  1.f,
+    };
+    GLuint indices[] = { 0, 1, 2, 2, 3, 0 };
+
+    glGenVertexArrays(1, &vaoID);
+    glBindVertexArray(vaoID);
+
+    glGenBuffers(1, &quadVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, quadVBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(ATTR_POSITION);
+    glVertexAttribPointer(ATTR_POSITION, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)0);
+    glEnableVertexAttribArray(ATTR_TEXCOORD);
+    glVertexAttribPointer(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(GLfloat), (void*)(3 * sizeof(GLfloat)));
+
+    glGenBuffers(1, &quadEBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, quadEBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &instanceVBO);
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_INSTANCES * sizeof(SpriteInstance), NULL, GL_STREAM_DRAW);
+    for (int i = 0; i < 4; ++i)
+    {
+        glEnableVertexAttribArray(ATTR_MODEL + i);
+        glVertexAttribPointer(ATTR_MODEL + i, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)(offsetof(SpriteInstance, model) + i * sizeof(glm::vec4)));
+        glVertexAttribDivisor(ATTR_MODEL + i, 1);
+    }
+    glEnableVertexAttribArray(ATTR_UVRECT);
+    glVertexAttribPointer(ATTR_UVRECT, 4, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)offsetof(SpriteInstance, uvRect));
+    glVertexAttribDivisor(ATTR_UVRECT, 1);
+    glEnableVertexAttribArray(ATTR_ALPHA);
+    glVertexAttribPointer(ATTR_ALPHA, 1, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)offsetof(SpriteInstance, alpha));
+    glVertexAttribDivisor(ATTR_ALPHA, 1);
+    glEnableVertexAttribArray(ATTR_DEPTH);
+    glVertexAttribPointer(ATTR_DEPTH, 1, GL_FLOAT, GL_FALSE, sizeof(SpriteInstance), (void*)offsetof(SpriteInstance, depth));
+    glVertexAttribDivisor(ATTR_DEPTH, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::Init")
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::Shutdown()
+{
+    if (instanceVBO) glDeleteBuffers(1, &instanceVBO);
+    if (quadEBO) glDeleteBuffers(1, &quadEBO);
+    if (quadVBO) glDeleteBuffers(1, &quadVBO);
+    if (vaoID) glDeleteVertexArrays(1, &vaoID);
+    if (program) glDeleteProgram(program);
+    if (depthFBO) glDeleteFramebuffers(1, &depthFBO);
+    if (depthRB) glDeleteRenderbuffers(1, &depthRB);
+    instanceVBO = quadEBO = quadVBO = vaoID = program = 0;
+    depthFBO = depthRB = 0;
+    depthFormat = 0;
+    instances.clear();
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::BindOwnState()
+{
+    if (ownStateBound)
+    {
+        return;
+    }
+    GLStateCache *gl = settings->glState;
+    if (gl != NULL)
+    {
+        gl->UseProgram(program);
+        gl->UniformMatrix4(vpLocation, settings->ProjViewMat);
+        gl->ActiveTexture(GL_TEXTURE0);
+    }
+    else
+    {
+        glUseProgram(program);
+        glUniformMatrix4fv(vpLocation, 1, GL_FALSE, &(settings->ProjViewMat[0][0]));
+        RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+        glActiveTexture(GL_TEXTURE0);
+    }
+    glBindVertexArray(vaoID);
+    glUniform1i(texLocation, 0);
+    RENDER_STAT_INC(RS_UNIFORM_UPLOADS)
+    ownStateBound = true;
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::BindSceneState()
+{
+    if (!ownStateBound)
+    {
+        return;
+    }
+    if (settings->glState != NULL)
+    {
+        settings->glState->UseProgram(sceneProgram);
+    }
+    else
+    {
+        glUseProgram(sceneProgram);
+    }
+    glBindVertexArray(sceneVAO);
+    ownStateBound = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Draw the render list in order. Only the default shader is batched, anything drawn
+// under another shader (the token shader) goes through RenderObject as before.
+void SpriteBatcher::Render(RenderObjectVectorPtr renderables, RenderSettingsPtr _settings)
+{
+    drawCalls = spritesBatched = spritesUnbatched = 0;
+    settings = _settings;
+
+    if (settings->glState != NULL)
+    {
+        sceneProgram = settings->glState->GetProgram();
+    }
+    else
+    {
+        glGetIntegerv(GL_CURRENT_PROGRAM, &sceneProgram);
+    }
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &sceneVAO);
+    ownStateBound = false;
+
+    bool batching = enabled && program != 0 && sceneProgram == settings->defaultShaderID;
+    spritesOpaque = 0;
+    if (batching && opaquePass)
+    {
+        RenderLayered(renderables);
+        return;
+    }
+
+    for (RenderObjectVector::iterator it = renderables->begin(); it != renderables->end(); ++it)
+    {
+        if (batching && (*it)->BatchObject(this, settings))
+        {
+            ++spritesBatched;
+            continue;
+        }
+        Flush();
+        BindSceneState();
+        (*it)->RenderObject(settings);
+        ++drawCalls;
+        ++spritesUnbatched;
+    }
+    Flush();
+    BindSceneState();
+    if (settings->glState == NULL)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        RENDER_STAT_INC(RS_TEXTURE_BINDS)
+    }
+    settings = NULL;
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::Render")
+}
+
+// -----------------------------------------------------------------------------------
+bool SpriteBatcher::CanBatch(RenderSettingsPtr _settings)
+{
+    if (!enabled || program == 0)
+    {
+        return false;
+    }
+    GLint current = 0;
+    if (_settings->glState != NULL)
+    {
+        current = _settings->glState->GetProgram();
+    }
+    else
+    {
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+    }
+    return current == _settings->defaultShaderID;
+}
+
+// -----------------------------------------------------------------------------------
+// Render for packets built by the FramePipeline, the packet lists are drawn one after
+// the other. Packets that weren't built go through their object's RenderObject. Always
+// in painter order, the opaque pass isn't done here, see the class comment.
+void SpriteBatcher::RenderPackets(const std::vector<DrawPacketVector> &packets, RenderSettingsPtr _settings)
+{
+    drawCalls = spritesBatched = spritesUnbatched = 0;
+    settings = _settings;
+
+    if (settings->glState != NULL)
+    {
+        sceneProgram = settings->glState->GetProgram();
+    }
+    else
+    {
+        glGetIntegerv(GL_CURRENT_PROGRAM, &sceneProgram);
+    }
+    glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &sceneVAO);
+    ownStateBound = false;
+
+    bool batching = enabled && program != 0 && sceneProgram == settings->defaultShaderID;
+
+    for (std::vector<DrawPacketVector>::const_iterator list = packets.begin(); list != packets.end(); ++list)
+    {
+        for (DrawPacketVector::const_iterator it = list->begin(); it != list->end(); ++it)
+        {
+            DrawPacket packet = *it;
+            if (batching && packet.built)
+            {
+                if (packet.object->ResolvePacket(packet, settings))
+                {
+                    Add(packet.texture, packet.model, packet.alpha, packet.uvRect);
+                    ++spritesBatched;
+                }
+                continue;
+            }
+            Flush();
+            BindSceneState();
+            packet.object->RenderObject(settings);
+            ++drawCalls;
+            ++spritesUnbatched;
+        }
+    }
+    Flush();
+    BindSceneState();
+    if (settings->glState == NULL)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        RENDER_STAT_INC(RS_TEXTURE_BINDS)
+    }
+    settings = NULL;
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::RenderPackets")
+}
+
+// -----------------------------------------------------------------------------------
+// The objects are recorded first, there is no telling whether the frame can use the
+// depth test until we know none of them falls back to RenderObject, which draws with
+// the scene's depth. Depth runs from the back (first drawn) to the front.
+void SpriteBatcher::RenderLayered(RenderObjectVectorPtr renderables)
+{
+    records.clear();
+    recording = true;
+    bool fallbacks = false;
+    float count = renderables->size() + 2;
+    for (size_t i = 0; i < renderables->size(); ++i)
+    {
+        RO_Base *obj = (*renderables)[i];
+        recordOpaque = obj->IsOpaque(settings);
+        recordDepth = 1.f - 2.f * (i + 1) / count;
+        if (!obj->BatchObject(this, settings))
+        {
+            records.push_back(Record());
+            records.back().fallback = obj;
+            records.back().opaque = false;
+            fallbacks = true;
+        }
+    }
+    recording = false;
+    recordDepth = 0.f;
+
+    if (fallbacks || !SaveDepth())
+    {
+        // the plain painter order, as Render would have drawn it
+        for (std::vector<Record>::iterator it = records.begin(); it != records.end(); ++it)
+        {
+            if (it->fallback != NULL)
+            {
+                Flush();
+                BindSceneState();
+                it->fallback->RenderObject(settings);
+                ++drawCalls;
+                ++spritesUnbatched;
+                continue;
+            }
+            it->instance.depth = 0.f;
+            AddInstance(it->texture, it->instance);
+            ++spritesBatched;
+        }
+    }
+    else
+    {
+        GLboolean blending = glIsEnabled(GL_BLEND);
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        GLboolean depthWrite = GL_TRUE;
+        GLint depthFunc = GL_LESS;
+        glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrite);
+        glGetIntegerv(GL_DEPTH_FUNC, &depthFunc);
+        glDepthMask(GL_TRUE);
+        glEnable(GL_DEPTH_TEST);
+        glDepthFunc(GL_LESS);
+        glDisable(GL_BLEND);
+        for (std::vector<Record>::reverse_iterator it = records.rbegin(); it != records.rend(); ++it)
+        {
+            if (it->opaque)
+            {
+                AddInstance(it->texture, it->instance);
+                ++spritesOpaque;
+            }
+        }
+        Flush();
+
+        glDepthMask(GL_FALSE);
+        glEnable(GL_BLEND);
+        for (std::vector<Record>::iterator it = records.begin(); it != records.end(); ++it)
+        {
+            if (!it->opaque)
+            {
+                AddInstance(it->texture, it->instance);
+            }
+        }
+        Flush();
+        RestoreDepth();
+        glDepthMask(depthWrite);
+        glDepthFunc(depthFunc);
+        if (!depthTest)
+        {
+            glDisable(GL_DEPTH_TEST);
+        }
+        if (!blending)
+        {
+            glDisable(GL_BLEND);
+        }
+        spritesBatched = records.size();
+    }
+    Flush();
+    BindSceneState();
+    if (settings->glState == NULL)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        RENDER_STAT_INC(RS_TEXTURE_BINDS)
+    }
+    settings = NULL;
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::RenderLayered")
+}
+
+// -----------------------------------------------------------------------------------
+// The passes need a cleared depth buffer, but the scene's depth is still needed by
+// whatever draws after us. It is copied aside over the viewport and put back by
+// RestoreDepth. The copy has to match the scene's depth format for the blit, so it is
+// made again if that changes. False if there is no depth to save, draw without.
+bool SpriteBatcher::SaveDepth()
+{
+    GLint fbo = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &fbo);
+    GLint bits = 0, stencil = 0;
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, fbo == 0 ? GL_DEPTH : GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_DEPTH_SIZE, &bits);
+    glGetFramebufferAttachmentParameteriv(GL_DRAW_FRAMEBUFFER, fbo == 0 ? GL_STENCIL : GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_STENCIL_SIZE, &stencil);
+    GLenum format = bits == 32 ? (stencil > 0 ? GL_DEPTH32F_STENCIL8 : GL_DEPTH_COMPONENT32F)
+                  : bits == 24 ? (stencil > 0 ? GL_DEPTH24_STENCIL8 : GL_DEPTH_COMPONENT24)
+                  : bits == 16 ? GL_DEPTH_COMPONENT16 : 0;
+    if (format == 0 || glGetError() != GL_NO_ERROR)
+    {
+        return false;
+    }
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+    glm::ivec4 rect(viewport[0], viewport[1], viewport[0] + viewport[2], viewport[1] + viewport[3]);
+    if (depthFBO == 0 || format != depthFormat || rect != depthRect)
+    {
+        if (depthFBO == 0)
+        {
+            glGenFramebuffers(1, &depthFBO);
+            glGenRenderbuffers(1, &depthRB);
+        }
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRB);
+        glRenderbufferStorage(GL_RENDERBUFFER, format, rect.z, rect.w);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+        glFramebufferRenderbuffer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRB);
+        bool complete = glCheckFramebufferStatus(GL_DRAW_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        if (!complete)
+        {
+            depthFormat = 0;
+            return false;
+        }
+        depthFormat = format;
+        depthRect = rect;
+    }
+    sceneFBO = fbo;
+    GLint readFBO = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, sceneFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, depthFBO);
+    glBlitFramebuffer(rect.x, rect.y, rect.z, rect.w, rect.x, rect.y, rect.z, rect.w, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFBO);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        return false;
+    }
+    GLboolean depthWrite = GL_TRUE;
+    glGetBooleanv(GL_DEPTH_WRITEMASK, &depthWrite);
+    glDepthMask(GL_TRUE);
+    glClear(GL_DEPTH_BUFFER_BIT);
+    glDepthMask(depthWrite);
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::RestoreDepth()
+{
+    GLint readFBO = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &readFBO);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, depthFBO);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, sceneFBO);
+    glBlitFramebuffer(depthRect.x, depthRect.y, depthRect.z, depthRect.w, depthRect.x, depthRect.y, depthRect.z, depthRect.w, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, readFBO);
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::RestoreDepth")
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::Add(GLuint texture, const glm::mat4 &model, float alpha, const glm::vec4 &uvRect)
+{
+    SpriteInstance inst;
+    inst.model = model;
+    inst.uvRect = uvRect;
+    inst.alpha = alpha;
+    inst.depth = recordDepth;
+    if (recording)
+    {
+        records.push_back(Record());
+        Record &r = records.back();
+        r.texture = texture;
+        r.instance = inst;
+        r.opaque = recordOpaque;
+        r.fallback = NULL;
+        return;
+    }
+    AddInstance(texture, inst);
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::AddInstance(GLuint texture, const SpriteInstance &inst)
+{
+    if (texture != batchTexture || instances.size() >= MAX_BATCH_INSTANCES)
+    {
+        Flush();
+        batchTexture = texture;
+    }
+    instances.push_back(inst);
+}
+
+// -----------------------------------------------------------------------------------
+void SpriteBatcher::Flush()
+{
+    if (instances.empty())
+    {
+        return;
+    }
+    BindOwnState();
+
+    // orphan the buffer so the driver doesn't have to wait on the last draw using it.
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glBufferData(GL_ARRAY_BUFFER, MAX_BATCH_INSTANCES * sizeof(SpriteInstance), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(SpriteInstance), &instances[0]);
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::Flush upload")
+
+    if (settings->glState != NULL)
+    {
+        settings->glState->BindTexture2D(batchTexture);
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, batchTexture);
+        RENDER_STAT_INC(RS_TEXTURE_BINDS)
+    }
+    glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, instances.size());
+    GL_CHECK_ERROR("GL Error: SpriteBatcher::Flush draw")
+    ++drawCalls;
+    RENDER_STAT_INC(RS_DRAW_CALLS)
+    instances.clear();
+}
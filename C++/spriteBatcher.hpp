@@ -0,0 +1,113 @@
+/* -----------------------------------------------------------------------------------
+   -- spriteBatcher.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __SPRITE_BATCHER_HPP__
+#define __SPRITE_BATCHER_HPP__
+#include <stdio.h>
+#include <vector>
+#include "sdtGraphics.hpp"
+#include "ro_base.hpp"
+
+class SpriteBatcher;
+typedef boost::shared_ptr<SpriteBatcher> SpriteBatcherPtr;
+
+// -----------------------------------------------------------------------------------
+// Per instance data streamed to the GPU, the layout matches the attribute pointers
+// set up in SpriteBatcher::Init.
+struct SpriteInstance
+{
+    glm::mat4 model;            // the objects currentTransform
+    glm::vec4 uvRect;           // u0, v0, u1, v1 of the texture to sample
+    float     alpha;            // the final alpha of the sprite
+    float     depth;            // NDC depth in the opaque pass, 0 otherwise
+};
+
+// -----------------------------------------------------------------------------------
+// Draws runs of sprites that share a texture with one instanced draw call.
+// Objects are handed over in draw order, a batch is flushed whenever the texture
+// changes or an object can't be batched, so layering is the same as drawing them
+// one at a time. Objects that don't support batching (RO_Base::BatchObject returns
+// false) are drawn through their own RenderObject with the scene's shader.
+// With the opaque pass on, opaque sprites are drawn first, front to back with depth
+// testing and no blending, then the rest back to front, blended and depth tested
+// against them, so floors hidden under other opaque tiles are never shaded. The depth
+// is the object's place in the draw order, so the picture is the same as painting.
+// The scene's depth buffer is copied aside for the passes and put back afterwards.
+// The opaque pass is Render's only, RenderPackets for the FramePipeline always paints
+// in order: the packets are drawn while the workers transform the next frame, and the
+// opacity reads the object's world alpha.
+// Render thread only.
+class SpriteBatcher
+{
+private:
+    GLuint  program;                    // the instanced sprite shader
+    GLuint  vaoID, quadVBO, quadEBO;    // the base quad
+    GLuint  instanceVBO;                // the streamed instance data
+    GLint   vpLocation;                 // the view projection uniform of our shader
+    GLint   texLocation;                // the sampler uniform of our shader
+    GLuint  batchTexture;               // the texture of the instances pending
+    std::vector<SpriteInstance> instances;      // the pending instances
+
+    struct Record                       // a sprite held back for the opaque pass
+    {
+        GLuint          texture;
+        SpriteInstance  instance;
+        bool            opaque;
+        RO_Base        *fallback;       // drawn with RenderObject instead
+    };
+    std::vector<Record> records;        // the frame, in draw order
+    bool    recording;                  // Add goes to records
+    bool    recordOpaque;               // the object being added is opaque
+    float   recordDepth;                // .. and its depth
+    GLuint  depthFBO, depthRB;          // the scene's depth, kept aside during the opaque pass
+    GLenum  depthFormat;                // .. its format, 0 until made
+    glm::ivec4 depthRect;               // .. the viewport it covers, x0, y0, x1, y1
+    GLint   sceneFBO;                   // the framebuffer the passes draw into
+
+    GLint   sceneProgram;               // the program and vao the scene had bound
+    GLint   sceneVAO;                   //   when Render was called.
+    bool    ownStateBound;              // our program and vao are currently bound
+    RenderSettingsPtr settings;         // the settings for the current Render call
+
+    bool    enabled;                    // fall back to per object drawing when false
+    bool    opaquePass;                 // split opaque and translucent sprites
+    long    drawCalls;                  // stats for the last Render call
+    long    spritesBatched;
+    long    spritesUnbatched;
+    long    spritesOpaque;
+
+    bool    BuildProgram();
+    void    BindOwnState();
+    void    BindSceneState();
+    void    AddInstance(GLuint texture, const SpriteInstance &inst);
+    void    RenderLayered(RenderObjectVectorPtr renderables);
+    bool    SaveDepth();                // copy the scene's depth aside and clear it, false if it can't
+    void    RestoreDepth();             // .. put it back
+
+public:
+    SpriteBatcher();
+    ~SpriteBatcher();
+    static void Boost();
+
+    bool Init();                        // create the GL objects, needs a current context
+    void Shutdown();                    // release the GL objects
+
+    void Render(RenderObjectVectorPtr renderables, RenderSettingsPtr settings);   // draw a collected render list
+    void RenderPackets(const std::vector<DrawPacketVector> &packets, RenderSettingsPtr settings);  // draw prepared packets, in order
+    bool CanBatch(RenderSettingsPtr settings);      // would Render batch under the bound program
+    void Add(GLuint texture, const glm::mat4 &model, float alpha, const glm::vec4 &uvRect);   // queue a sprite
+    void Flush();                       // draw the pending instances
+    void TakePending(std::vector<SpriteInstance> &out) { out.swap(instances); instances.clear(); }  // hand them over undrawn, for checks
+
+    bool GetEnabled()                   { return enabled; }
+    void SetEnabled(bool e)             { enabled = e; }
+    bool GetOpaquePass()                { return opaquePass; }
+    void SetOpaquePass(bool o)          { opaquePass = o; }     // Render only, not RenderPackets
+    long GetSpritesOpaque()             { return spritesOpaque; }
+    long GetDrawCalls()                 { return drawCalls; }
+    long GetSpritesBatched()            { return spritesBatched; }
+    long GetSpritesUnbatched()          { return spritesUnbatched; }
+};
+
+#endif
@@ -0,0 +1,204 @@
+/* -----------------------------------------------------------------------------------
+   -- textureAtlas.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "textureAtlas.hpp"
+#include "graphicsEnums.hpp"
+#include "scene.hpp"
+#include "utils.hpp"
+#include "damageTracker.hpp"
+#include "memoryAccounting.hpp"
+
+// external decleration for the command processor.
+extern void StaticQueueCommand(CommandObjectPtr cmd);
+
+TextureAtlasPtr TextureAtlas::instance;
+
+// -----------------------------------------------------------------------------------
+TextureAtlas::TextureAtlas(Scene *_scene, int pageSize, int padding) : BaseCommandObject()
+  , scene(_scene)
+  , packer(pageSize, pageSize, padding)
+  , pageTextures()
+  , version(0)
+  , accounted(0)
+{}
+
+// -----------------------------------------------------------------------------------
+TextureAtlas::~TextureAtlas()
+{
+    ReleasePages();
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::Boost()
+{
+    class_ < TextureAtlas, TextureAtlasPtr, bases<BaseCommandObject>, boost::noncopyable >("TextureAtlas", "Packs the resource textures into shared pages", no_init)
+        .def("GetInstance", &TextureAtlas::GetInstance)
+        .staticmethod("GetInstance")
+        .def("Build", &TextureAtlas::Build, "Queue a rebuild of the atlas from a stringList of resPaths")
+        .add_property("numPages", &TextureAtlas::GetNumPages)
+        .add_property("numImages", &TextureAtlas::GetNumImages)
+        .add_property("fillEfficiency", &TextureAtlas::GetFillEfficiency, "Fraction of the page area covered by images")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::StartInstance(Scene *_scene, int pageSize, int padding)
+{
+    if (!instance)
+    {
+        instance = TextureAtlasPtr(new TextureAtlas(_scene, pageSize, padding));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+TextureAtlasPtr TextureAtlas::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::StopInstance()
+{
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::ReleasePages()
+{
+    if (!pageTextures.empty())
+    {
+        glDeleteTextures(pageTextures.size(), &pageTextures[0]);
+        pageTextures.clear();
+        MemoryAccounting::Free(MEM_TEXTURES, accounted);
+        accounted = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::Build(stringList resPaths)
+{
+    CommandObjectPtr cmd = CommandObject::GetCommand(CMD_STD_UPDATE);
+    cmd->SetDest(shared_from_this());
+    cmd->Set1<stringList>(resPaths);
+    StaticQueueCommand(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+void TextureAtlas::ApplyCommand(CommandObjectPtr cmd)
+{
+    if (cmd->GetCmd() == CMD_STD_UPDATE)
+    {
+        stringList resPaths = cmd->Get1<stringList>();
+        BuildNow(resPaths);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// The pages are filled on the GPU, each source texture is attached to a read
+// framebuffer and copied into its spot, so nothing is read back to the host.
+int TextureAtlas::BuildNow(stringList &resPaths)
+{
+    GLFW_THREAD_CHECK();
+    ReleasePages();
+    packer.Clear();
+    ++version;
+    if (DamageTracker::GetInstance())
+    {
+        DamageTracker::GetInstance()->DamageAll();     // images move onto the new pages
+    }
+
+    if (scene == NULL)
+    {
+        printf("ERROR: TextureAtlas has no scene, skipping build!\n");
+        return 0;
+    }
+
+    for (stringList::const_iterator it = resPaths.begin(); it != resPaths.end(); ++it)
+    {
+        glm::vec3 size = scene->GetTextureSize(*it);
+        packer.Add(*it, (int)size.x, (int)size.y);
+    }
+    int numPages = packer.Pack();
+    if (numPages == 0)
+    {
+        return 0;
+    }
+
+    GLint oldReadFBO = 0, oldDrawFBO = 0;
+    glGetIntegerv(GL_READ_FRAMEBUFFER_BINDING, &oldReadFBO);
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &oldDrawFBO);
+
+    GLuint fbo = 0;
+    glGenFramebuffers(1, &fbo);
+
+    // allocate and clear the pages, so the padding is transparent
+    pageTextures.resize(numPages);
+    glGenTextures(numPages, &pageTextures[0]);
+    accounted = MemoryAccounting::Alloc(MEM_TEXTURES, (long long)numPages * packer.GetPageWidth() * packer.GetPageHeight() * 4);
+    for (int p = 0; p < numPages; ++p)
+    {
+        glBindTexture(GL_TEXTURE_2D, pageTextures[p]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, packer.GetPageWidth(), packer.GetPageHeight(), 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, fbo);
+        glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, pageTextures[p], 0);
+        glClearColor(0.f, 0.f, 0.f, 0.f);
+        glClear(GL_COLOR_BUFFER_BIT);
+    }
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, oldDrawFBO);
+    GL_CHECK_ERROR("GL Error: TextureAtlas allocate pages")
+
+    // copy every image into its page
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+    const AtlasRegionMap &regions = packer.GetRegions();
+    for (AtlasRegionMap::const_iterator it = regions.begin(); it != regions.end(); ++it)
+    {
+        const AtlasRegion &r = it->second;
+        GLuint source = scene->GetTexture(it->first);
+        glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, source, 0);
+        if (glCheckFramebufferStatus(GL_READ_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            printf("ERROR: TextureAtlas can't read texture %s\n", it->first.c_str());
+            continue;
+        }
+        glBindTexture(GL_TEXTURE_2D, pageTextures[r.page]);
+        glCopyTexSubImage2D(GL_TEXTURE_2D, 0, r.x, r.y, 0, 0, r.width, r.height);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, oldReadFBO);
+    glDeleteFramebuffers(1, &fbo);
+    GL_CHECK_ERROR("GL Error: TextureAtlas copy images")
+
+    printf("TextureAtlas: %d images on %d pages, %4.1f%% filled, %zu too large\n",
+        GetNumImages(), numPages, GetFillEfficiency() * 100.0f, packer.GetRejected().size());
+    return numPages;
+}
+
+// -----------------------------------------------------------------------------------
+// The uv rect is inset by half a texel so linear filtering doesn't pick up the padding.
+bool TextureAtlas::Lookup(const std::string &resPath, GLuint &texture, glm::vec4 &uvRect)
+{
+    AtlasRegion r;
+    if (pageTextures.empty() || !packer.GetRegion(resPath, r))
+    {
+        return false;
+    }
+    float W = packer.GetPageWidth();
+    float H = packer.GetPageHeight();
+    texture = pageTextures[r.page];
+    uvRect = glm::vec4((r.x + 0.5f) / W, (r.y + 0.5f) / H, (r.x + r.width - 0.5f) / W, (r.y + r.height - 0.5f) / H);
+    return true;
+}
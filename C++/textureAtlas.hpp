@@ -0,0 +1,55 @@
+/* -----------------------------------------------------------------------------------
+   -- textureAtlas.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __TEXTURE_ATLAS_HPP__
+#define __TEXTURE_ATLAS_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "sdtGraphics.hpp"
+#include "commandObject.hpp"
+#include "atlasPacker.hpp"
+#include "ro_base.hpp"
+
+class TextureAtlas;
+typedef boost::shared_ptr<TextureAtlas> TextureAtlasPtr;
+
+// -----------------------------------------------------------------------------------
+// Copies the resource pack textures onto a few large pages so sprites with different
+// resPaths can share a texture, and with it a batch in the SpriteBatcher.
+// The pages are built on the render thread, python queues the build with Build().
+class TextureAtlas : public BaseCommandObject
+{
+private:
+    static TextureAtlasPtr  instance;       // the singleton instance.
+    Scene                  *scene;          // where the source textures come from
+    AtlasPacker             packer;         // the layout of the pages
+    std::vector<GLuint>     pageTextures;   // the GL texture of every page
+    unsigned long           version;        // bumped on every build, so cached lookups can be refreshed
+    long long               accounted;      // MemoryAccounting, the pages
+
+    void ReleasePages();
+
+public:
+    TextureAtlas(Scene *_scene, int pageSize, int padding);
+    ~TextureAtlas();
+    static void Boost();
+    static void StartInstance(Scene *_scene, int pageSize = 4096, int padding = 2);    // Static Instance interface
+    static TextureAtlasPtr GetInstance();                                              // ..
+    static void StopInstance();                                                        // ..
+
+    void Build(stringList resPaths);                // queue a build of the atlas from these resPaths
+    int  BuildNow(stringList &resPaths);            // build the atlas, render thread only. Returns the number of pages
+    bool Lookup(const std::string &resPath, GLuint &texture, glm::vec4 &uvRect);    // where is this image in the atlas
+
+    unsigned long GetVersion()          { return version; }
+    int   GetNumPages()                 { return pageTextures.size(); }
+    int   GetNumImages()                { return packer.GetRegions().size(); }
+    float GetFillEfficiency()           { return packer.GetFillEfficiency(); }
+
+public:                             // BaseCommandObject
+    virtual void ApplyCommand(CommandObjectPtr cmd);
+};
+
+#endif
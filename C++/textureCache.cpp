@@ -0,0 +1,181 @@
+/* -----------------------------------------------------------------------------------
+   -- textureCache.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+
+using namespace boost::python;
+using namespace std;
+
+#include "textureCache.hpp"
+#include "utils.hpp"
+
+TextureCachePtr TextureCache::instance;
+
+// -----------------------------------------------------------------------------------
+TextureCache::TextureCache(long long _budgetBytes) :
+    entries()
+  , unusedList()
+  , loading()
+  , pendingReleases()
+  , budgetBytes(_budgetBytes)
+  , residentBytes(0)
+  , hits(0)
+  , misses(0)
+  , evictions(0)
+{}
+
+// -----------------------------------------------------------------------------------
+TextureCache::~TextureCache()
+{}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::Boost()
+{
+    class_ < TextureCache, TextureCachePtr, boost::noncopyable >("TextureCache", "Reference counted textures with LRU eviction under a byte budget", no_init)
+        .def("GetInstance", &TextureCache::GetInstance)
+        .staticmethod("GetInstance")
+        .add_property("budget", &TextureCache::GetBudget, &TextureCache::SetBudget, "Bytes of texture memory before unused textures are evicted")
+        .add_property("residentBytes", &TextureCache::GetResidentBytes, "Bytes of texture memory in use")
+        .add_property("hits", &TextureCache::GetHits)
+        .add_property("misses", &TextureCache::GetMisses)
+        .add_property("evictions", &TextureCache::GetEvictions)
+        .add_property("numTextures", &TextureCache::GetNumTextures)
+        .add_property("numUnused", &TextureCache::GetNumUnused, "Textures with no references, candidates for eviction")
+        .def("ResetStats", &TextureCache::ResetStats)
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::StartInstance(long long budgetBytes)
+{
+    if (!instance)
+    {
+        instance = TextureCachePtr(new TextureCache(budgetBytes));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+TextureCachePtr TextureCache::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::StopInstance()
+{
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+StreamedTexturePtr TextureCache::Acquire(const std::string &resPath, int lod)
+{
+    GLFW_THREAD_CHECK();
+    std::string key = TextureStreamer::VariantKey(resPath, lod);
+    EntryMap::iterator it = entries.find(key);
+    if (it != entries.end())
+    {
+        Entry &e = it->second;
+        if (e.unused)
+        {
+            unusedList.erase(e.lruPos);
+            e.unused = false;
+        }
+        ++e.refCount;
+        ++hits;
+        return e.texture;
+    }
+
+    ++misses;
+    Entry &e = entries[key];
+    e.texture = TextureStreamer::GetInstance()->Request(resPath, lod);
+    e.refCount = 1;
+    e.bytes = 0;
+    e.unused = false;
+    loading.push_back(key);
+    return e.texture;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::Release(const std::string &key)
+{
+    std::unique_lock<std::mutex> guard(releaseLock);
+    pendingReleases.push_back(key);
+}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::ApplyRelease(const std::string &key)
+{
+    EntryMap::iterator it = entries.find(key);
+    if (it == entries.end() || it->second.refCount <= 0)
+    {
+        printf("ERROR: TextureCache release of %s without a reference\n", key.c_str());
+        return;
+    }
+    Entry &e = it->second;
+    if (--e.refCount == 0)
+    {
+        e.lruPos = unusedList.insert(unusedList.end(), key);
+        e.unused = true;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void TextureCache::Evict()
+{
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    while (residentBytes > budgetBytes && !unusedList.empty())
+    {
+        std::string key = unusedList.front();
+        unusedList.pop_front();
+        EntryMap::iterator it = entries.find(key);
+        residentBytes -= it->second.bytes;
+        entries.erase(it);
+        if (streamer)
+        {
+            streamer->Forget(key);
+        }
+        ++evictions;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Apply the releases, account for the textures that finished uploading, then evict
+// down to the budget.
+void TextureCache::Update()
+{
+    GLFW_THREAD_CHECK();
+    std::vector<std::string> releases;
+    {
+        std::unique_lock<std::mutex> guard(releaseLock);
+        releases.swap(pendingReleases);
+    }
+    for (std::vector<std::string>::iterator it = releases.begin(); it != releases.end(); ++it)
+    {
+        ApplyRelease(*it);
+    }
+
+    for (size_t i = 0; i < loading.size(); )
+    {
+        EntryMap::iterator it = entries.find(loading[i]);
+        int state = it == entries.end() ? STREAM_FAILED : (int)it->second.texture->state;
+        if (state == STREAM_READY || state == STREAM_FAILED)
+        {
+            if (state == STREAM_READY)
+            {
+                StreamedTexturePtr tex = it->second.texture;
+                // the mip chain adds a third on top of the base level
+                it->second.bytes = (long long)tex->width * tex->height * 4 * 4 / 3;
+                residentBytes += it->second.bytes;
+            }
+            loading[i] = loading.back();
+            loading.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    Evict();
+}
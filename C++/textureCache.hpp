@@ -0,0 +1,74 @@
+/* -----------------------------------------------------------------------------------
+   -- textureCache.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __TEXTURE_CACHE_HPP__
+#define __TEXTURE_CACHE_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include <mutex>
+#include "textureStreamer.hpp"
+
+class TextureCache;
+typedef boost::shared_ptr<TextureCache> TextureCachePtr;
+
+// -----------------------------------------------------------------------------------
+// Reference counts the streamed textures by variant key, each lod of a resPath is its
+// own entry so a zoomed out view can drop the full resolution image. Textures nobody references are
+// kept in least recently used order and evicted once the resident bytes go over the
+// budget, the next Acquire streams them in again.
+// Acquire and Update are render thread only, Release can come from any thread since
+// render objects can be destroyed from python.
+class TextureCache
+{
+private:
+    struct Entry
+    {
+        StreamedTexturePtr              texture;    // the streamed texture
+        int                             refCount;   // render objects using it
+        long long                       bytes;      // GPU bytes, 0 until it is uploaded
+        bool                            unused;     // on the unused list
+        std::list<std::string>::iterator lruPos;    // where on the unused list
+    };
+    typedef std::map<std::string, Entry> EntryMap;
+
+    static TextureCachePtr  instance;               // the singleton instance.
+    EntryMap                entries;                // every texture we know about
+    std::list<std::string>  unusedList;             // unreferenced textures, oldest first
+    std::vector<std::string> loading;               // acquired but not uploaded yet
+    std::vector<std::string> pendingReleases;       // releases from any thread, applied in Update
+    std::mutex              releaseLock;            // guards pendingReleases
+    long long               budgetBytes;            // evict unused textures above this
+    long long               residentBytes;          // bytes of every uploaded texture
+    long                    hits, misses, evictions;
+
+    void ApplyRelease(const std::string &key);
+    void Evict();
+
+public:
+    TextureCache(long long _budgetBytes);
+    ~TextureCache();
+    static void Boost();
+    static void StartInstance(long long budgetBytes = 512LL * 1024 * 1024);   // Static Instance interface
+    static TextureCachePtr GetInstance();                                     // ..
+    static void StopInstance();                                               // ..
+
+    StreamedTexturePtr Acquire(const std::string &resPath, int lod = 0);   // take a reference, streams it in if needed
+    void Release(const std::string &key);                      // drop a reference by StreamedTexture::key, from any thread
+    void Update();                                             // once per frame on the render thread
+
+    long long GetBudget()                   { return budgetBytes; }
+    void SetBudget(long long b)             { budgetBytes = b; }
+    long long GetResidentBytes()            { return residentBytes; }
+    long GetHits()                          { return hits; }
+    long GetMisses()                        { return misses; }
+    long GetEvictions()                     { return evictions; }
+    int  GetNumTextures()                   { return entries.size(); }
+    int  GetNumUnused()                     { return unusedList.size(); }
+    void ResetStats()                       { hits = misses = evictions = 0; }
+};
+
+#endif
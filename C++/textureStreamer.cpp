@@ -0,0 +1,400 @@
+/* -----------------------------------------------------------------------------------
+   -- textureStreamer.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <boost/bind.hpp>
+#include <chrono>
+#include <sstream>
+
+using namespace boost::python;
+using namespace std;
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+
+#include "textureStreamer.hpp"
+#include "utils.hpp"
+#include "memoryAccounting.hpp"
+
+// the default time ProcessUploads may spend each frame.
+#define DEFAULT_UPLOAD_BUDGET_MS 2.0f
+// large images are uploaded in slices of about this many bytes, so one image can be
+// spread over several frames.
+#define UPLOAD_SLICE_BYTES (1024 * 1024)
+
+typedef std::chrono::high_resolution_clock StreamClock;
+
+TextureStreamerPtr TextureStreamer::instance;
+
+// -----------------------------------------------------------------------------------
+TextureStreamer::TextureStreamer(int numThreads) :
+    decoder()
+  , pool(numThreads)
+  , textures()
+  , decoded()
+  , pendingReleases()
+  , placeholder(0)
+  , pbo(0)
+  , uploadBudgetMs(DEFAULT_UPLOAD_BUDGET_MS)
+  , uploadedBytes(0)
+  , uploadedTextures(0)
+{}
+
+// -----------------------------------------------------------------------------------
+TextureStreamer::~TextureStreamer()
+{
+    pool.Wait();
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::Boost()
+{
+    class_ < TextureStreamer, TextureStreamerPtr, boost::noncopyable >("TextureStreamer", "Background decoding and budgeted upload of textures", no_init)
+        .def("GetInstance", &TextureStreamer::GetInstance)
+        .staticmethod("GetInstance")
+        .add_property("uploadBudget", &TextureStreamer::GetUploadBudget, &TextureStreamer::SetUploadBudget, "Milliseconds per frame that may be spent uploading textures")
+        .add_property("pendingDecodes", &TextureStreamer::GetPendingDecodes, "Images waiting for, or being decoded")
+        .add_property("uploadedBytes", &TextureStreamer::GetUploadedBytes, "Bytes uploaded last frame")
+        .add_property("uploadedTextures", &TextureStreamer::GetUploadedTextures, "Textures completed last frame")
+    ;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::StartInstance(int numThreads)
+{
+    if (!instance)
+    {
+        instance = TextureStreamerPtr(new TextureStreamer(numThreads));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+TextureStreamerPtr TextureStreamer::GetInstance()
+{
+    return instance;
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::StopInstance()
+{
+    instance.reset();
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::Init()
+{
+    GLFW_THREAD_CHECK();
+    // a flat grey, so it is obvious something is still on its way.
+    unsigned char grey[4] = { 128, 128, 128, 160 };
+    glGenTextures(1, &placeholder);
+    glBindTexture(GL_TEXTURE_2D, placeholder);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, grey);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenBuffers(1, &pbo);
+    GL_CHECK_ERROR("GL Error: TextureStreamer::Init")
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::Shutdown()
+{
+    pool.Wait();
+    for (std::map<std::string, StreamedTexturePtr>::iterator it = textures.begin(); it != textures.end(); ++it)
+    {
+        if (it->second->texture != 0)
+        {
+            glDeleteTextures(1, &it->second->texture);
+            MemoryAccounting::Free(MEM_TEXTURES, it->second->accounted);
+            it->second->accounted = 0;
+        }
+    }
+    textures.clear();
+    decoded.clear();
+    {
+        std::unique_lock<std::mutex> guard(releaseLock);
+        pendingReleases.clear();
+    }
+    if (pbo) glDeleteBuffers(1, &pbo);
+    if (placeholder) glDeleteTextures(1, &placeholder);
+    pbo = placeholder = 0;
+}
+
+// -----------------------------------------------------------------------------------
+std::string TextureStreamer::VariantKey(const std::string &resPath, int lod)
+{
+    if (lod <= 0)
+    {
+        return resPath;
+    }
+    std::ostringstream stringStream;
+    stringStream << resPath << "#" << lod;
+    return stringStream.str();
+}
+
+// -----------------------------------------------------------------------------------
+StreamedTexturePtr TextureStreamer::Request(const std::string &resPath, int lod)
+{
+    if (lod < 0) lod = 0;
+    if (lod > MAX_TEXTURE_LOD) lod = MAX_TEXTURE_LOD;
+    std::string key = VariantKey(resPath, lod);
+    std::map<std::string, StreamedTexturePtr>::iterator it = textures.find(key);
+    if (it != textures.end())
+    {
+        ++it->second->users;
+        return it->second;
+    }
+    StreamedTexturePtr tex(new StreamedTexture(resPath, key, lod));
+    tex->users = 1;
+    textures[key] = tex;
+    pool.Post(boost::bind(&TextureStreamer::Decode, this, tex));
+    return tex;
+}
+
+// -----------------------------------------------------------------------------------
+// For callers without a TextureCache, the cache keeps its own count and Forgets. The
+// last reference to an image can go on the python thread, so like the cache the
+// release is only queued, the map and GL are left to the render thread.
+void TextureStreamer::Release(const std::string &key)
+{
+    std::unique_lock<std::mutex> guard(releaseLock);
+    pendingReleases.push_back(key);
+}
+
+// -----------------------------------------------------------------------------------
+void TextureStreamer::ApplyReleases()
+{
+    std::vector<std::string> releases;
+    {
+        std::unique_lock<std::mutex> guard(releaseLock);
+        releases.swap(pendingReleases);
+    }
+    for (std::vector<std::string>::iterator key = releases.begin(); key != releases.end(); ++key)
+    {
+        std::map<std::string, StreamedTexturePtr>::iterator it = textures.find(*key);
+        if (it != textures.end() && --it->second->users <= 0)
+        {
+            Forget(*key);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// A decode or upload still in flight holds its own reference, it finishes into the
+// forgotten entry and is thrown away with it.
+void TextureStreamer::Forget(const std::string &key)
+{
+    std::map<std::string, StreamedTexturePtr>::iterator it = textures.find(key);
+    if (it == textures.end())
+    {
+        return;
+    }
+    StreamedTexturePtr tex = it->second;
+    textures.erase(it);
+    {
+        std::unique_lock<std::mutex> guard(decodedLock);
+        for (std::deque<StreamedTexturePtr>::iterator d = decoded.begin(); d != decoded.end(); ++d)
+        {
+            if (*d == tex)
+            {
+                decoded.erase(d);
+                break;
+            }
+        }
+    }
+    if (tex->texture != 0)
+    {
+        glDeleteTextures(1, &tex->texture);
+        tex->texture = 0;
+        MemoryAccounting::Free(MEM_TEXTURES, tex->accounted);
+        tex->accounted = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Worker thread.
+void TextureStreamer::Decode(StreamedTexturePtr tex)
+{
+    if (decoder.empty() || !decoder(tex->resPath, tex->image) || tex->image.width <= 0 || tex->image.height <= 0)
+    {
+        printf("ERROR: TextureStreamer failed to decode %s\n", tex->resPath.c_str());
+        tex->image.pixels.clear();
+        tex->state = STREAM_FAILED;
+        return;
+    }
+    tex->sourceWidth = tex->image.width;
+    tex->sourceHeight = tex->image.height;
+    tex->opaque = IsOpaque(tex->image);
+    for (int i = 0; i < tex->lod && (tex->image.width > 1 || tex->image.height > 1); ++i)
+    {
+        HalveImage(tex->image);
+    }
+    tex->width = tex->image.width;
+    tex->height = tex->image.height;
+    tex->state = STREAM_DECODED;
+
+    std::unique_lock<std::mutex> guard(decodedLock);
+    decoded.push_back(tex);
+}
+
+// -----------------------------------------------------------------------------------
+bool TextureStreamer::IsOpaque(const DecodedImage &image)
+{
+    const unsigned char *p = &image.pixels[0];
+    const unsigned char *end = p + image.pixels.size();
+    for (p += 3; p < end; p += 4)
+    {
+        if (*p != 255)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// 2x2 box filter, an odd last row or column is averaged with itself.
+void TextureStreamer::HalveImage(DecodedImage &image)
+{
+    int w = image.width, h = image.height;
+    int nw = w > 1 ? w / 2 : 1;
+    int nh = h > 1 ? h / 2 : 1;
+    std::vector<unsigned char> out(nw * nh * 4);
+    for (int y = 0; y < nh; ++y)
+    {
+        int y0 = glm::min(y * 2, h - 1), y1 = glm::min(y * 2 + 1, h - 1);
+        for (int x = 0; x < nw; ++x)
+        {
+            int x0 = glm::min(x * 2, w - 1), x1 = glm::min(x * 2 + 1, w - 1);
+            const unsigned char *a = &image.pixels[(y0 * w + x0) * 4];
+            const unsigned char *b = &image.pixels[(y0 * w + x1) * 4];
+            const unsigned char *c = &image.pixels[(y1 * w + x0) * 4];
+            const unsigned char *d = &image.pixels[(y1 * w + x1) * 4];
+            unsigned char *o = &out[(y * nw + x) * 4];
+            for (int ch = 0; ch < 4; ++ch)
+            {
+                o[ch] = (a[ch] + b[ch] + c[ch] + d[ch] + 2) / 4;
+            }
+        }
+    }
+    image.pixels.swap(out);
+    image.width = nw;
+    image.height = nh;
+}
+
+// -----------------------------------------------------------------------------------
+// Stage the next rows of the image through the PBO, the driver can then copy them
+// to the texture without us waiting on it.
+bool TextureStreamer::UploadRows(StreamedTexturePtr tex, int rows)
+{
+    if (tex->texture == 0)
+    {
+        glGenTextures(1, &tex->texture);
+        glBindTexture(GL_TEXTURE_2D, tex->texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, tex->width, tex->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        tex->accounted = MemoryAccounting::Alloc(MEM_TEXTURES, (long long)tex->width * tex->height * 4 * 4 / 3);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        tex->state = STREAM_UPLOADING;
+    }
+    else
+    {
+        glBindTexture(GL_TEXTURE_2D, tex->texture);
+    }
+
+    if (tex->rowsUploaded + rows > tex->height)
+    {
+        rows = tex->height - tex->rowsUploaded;
+    }
+    size_t rowBytes = tex->width * 4;
+    size_t bytes = rows * rowBytes;
+
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pbo);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, &tex->image.pixels[tex->rowsUploaded * rowBytes], GL_STREAM_DRAW);
+    GLint alignment = 4;        // put back afterwards, the other uploads expect their own
+    glGetIntegerv(GL_UNPACK_ALIGNMENT, &alignment);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, tex->rowsUploaded, tex->width, rows, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    tex->rowsUploaded += rows;
+    uploadedBytes += bytes;
+    if (tex->rowsUploaded < tex->height)
+    {
+        glBindTexture(GL_TEXTURE_2D, 0);
+        GL_CHECK_ERROR("GL Error: TextureStreamer::UploadRows")
+        return false;
+    }
+    // the last rows are up, build the rest of the mip chain from them.
+    glGenerateMipmap(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    GL_CHECK_ERROR("GL Error: TextureStreamer::UploadRows")
+    std::vector<unsigned char>().swap(tex->image.pixels);
+    tex->state = STREAM_READY;
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// A texture stays queued until its last rows are up, so this covers the partial ones.
+bool TextureStreamer::HasPendingUploads()
+{
+    std::unique_lock<std::mutex> guard(decodedLock);
+    return !decoded.empty();
+}
+
+// -----------------------------------------------------------------------------------
+// At least one slice goes up every frame, so a tiny budget still makes progress.
+int TextureStreamer::ProcessUploads()
+{
+    GLFW_THREAD_CHECK();
+    ApplyReleases();
+    uploadedBytes = 0;
+    uploadedTextures = 0;
+    StreamClock::time_point start = StreamClock::now();
+
+    while (true)
+    {
+        StreamedTexturePtr tex;
+        {
+            std::unique_lock<std::mutex> guard(decodedLock);
+            if (decoded.empty())
+            {
+                break;
+            }
+            tex = decoded.front();
+        }
+
+        // forgotten while it was decoding, nobody wants it anymore
+        std::map<std::string, StreamedTexturePtr>::iterator it = textures.find(tex->key);
+        if (it == textures.end() || it->second != tex)
+        {
+            std::unique_lock<std::mutex> guard(decodedLock);
+            decoded.pop_front();
+            continue;
+        }
+
+        int sliceRows = UPLOAD_SLICE_BYTES / (tex->width * 4);
+        if (sliceRows < 1)
+        {
+            sliceRows = 1;
+        }
+        if (UploadRows(tex, sliceRows))
+        {
+            ++uploadedTextures;
+            std::unique_lock<std::mutex> guard(decodedLock);
+            decoded.pop_front();
+        }
+
+        double elapsed = std::chrono::duration<double, std::milli>(StreamClock::now() - start).count();
+        if (elapsed >= uploadBudgetMs)
+        {
+            break;
+        }
+    }
+    return uploadedTextures;
+}
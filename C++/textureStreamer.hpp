@@ -0,0 +1,123 @@
+/* -----------------------------------------------------------------------------------
+   -- textureStreamer.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __TEXTURE_STREAMER_HPP__
+#define __TEXTURE_STREAMER_HPP__
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <atomic>
+#include <mutex>
+#include <boost/function.hpp>
+#include "sdtGraphics.hpp"
+#include "workerPool.hpp"
+
+class TextureStreamer;
+typedef boost::shared_ptr<TextureStreamer> TextureStreamerPtr;
+
+// -----------------------------------------------------------------------------------
+// A decoded image, tightly packed RGBA8 rows.
+struct DecodedImage
+{
+    int width, height;
+    std::vector<unsigned char> pixels;
+};
+
+// Decodes the image for a resPath, this is run on the worker threads so it must not
+// touch python or GL. The scene installs one that reads from its resource pack.
+typedef boost::function<bool (const std::string &resPath, DecodedImage &image)> TextureDecoder;
+
+// -----------------------------------------------------------------------------------
+enum StreamState
+{
+    STREAM_DECODING,        // waiting for, or in, a worker
+    STREAM_DECODED,         // waiting for the render thread to upload it
+    STREAM_UPLOADING,       // part of the rows are on the GPU
+    STREAM_READY,           // the texture can be used
+    STREAM_FAILED           // the decode failed, the placeholder is used for good
+};
+
+// the smallest variant is 1/8th of the source on each side
+#define MAX_TEXTURE_LOD 3
+
+struct StreamedTexture
+{
+    std::string         resPath;
+    std::string         key;            // resPath plus the variant, see TextureStreamer::VariantKey
+    int                 lod;            // the variant is the source halved this many times
+    std::atomic<int>    state;          // StreamState, written by the workers and the render thread
+    GLuint              texture;        // valid once READY
+    int                 width, height;  // valid once DECODED
+    int                 sourceWidth, sourceHeight;      // the full resolution size, valid once DECODED
+    bool                opaque;         // every pixel has full alpha, valid once DECODED
+    DecodedImage        image;          // released once READY
+    int                 rowsUploaded;   // progress of a budgeted upload
+    long long           accounted;      // MemoryAccounting, the texture with its mips
+    int                 users;          // Requests not Released yet, render thread only
+
+    StreamedTexture(const std::string &_resPath, const std::string &_key, int _lod) : resPath(_resPath), key(_key), lod(_lod), state(STREAM_DECODING), texture(0), width(0), height(0), sourceWidth(0), sourceHeight(0), opaque(false), image(), rowsUploaded(0), accounted(0), users(0) {}
+    bool Ready()        { return state == STREAM_READY; }
+};
+typedef boost::shared_ptr<StreamedTexture> StreamedTexturePtr;
+
+// -----------------------------------------------------------------------------------
+// Moves texture loading off the render thread. Requests are decoded on a worker pool
+// and uploaded by ProcessUploads, once per frame, inside a time budget. Until then
+// the caller draws with the placeholder texture. Every texture gets a full mip chain,
+// and reduced variants (lod > 0) are downscaled on the workers, so zoomed out views
+// don't need the full resolution image resident at all.
+class TextureStreamer
+{
+private:
+    static TextureStreamerPtr   instance;       // the singleton instance.
+    TextureDecoder              decoder;        // turns a resPath into pixels
+    WorkerPool                  pool;           // the decode threads
+    std::map<std::string, StreamedTexturePtr> textures;    // every request, by variant key. Render thread only
+    std::deque<StreamedTexturePtr> decoded;     // finished decodes waiting for upload
+    std::mutex                  decodedLock;    // guards decoded
+    std::vector<std::string>    pendingReleases;    // Releases from any thread, applied in ProcessUploads
+    std::mutex                  releaseLock;        // guards pendingReleases
+    GLuint                      placeholder;    // drawn until the real texture is up
+    GLuint                      pbo;            // staging buffer for the uploads
+    float                       uploadBudgetMs; // how long ProcessUploads may spend per frame
+    long                        uploadedBytes;  // stats for the last ProcessUploads
+    int                         uploadedTextures;
+
+    void Decode(StreamedTexturePtr tex);        // worker thread
+    void ApplyReleases();                       // render thread
+    bool UploadRows(StreamedTexturePtr tex, int rows);
+
+public:
+    TextureStreamer(int numThreads);
+    ~TextureStreamer();
+    static void Boost();
+    static void StartInstance(int numThreads = 0);      // Static Instance interface
+    static TextureStreamerPtr GetInstance();            // ..
+    static void StopInstance();                         // ..
+
+    void Init();                                        // create the GL objects, render thread only
+    void Shutdown();                                    // release the GL objects, render thread only
+    void SetDecoder(TextureDecoder d)                   { decoder = d; }
+    bool HasDecoder()                                   { return !decoder.empty(); }
+
+    StreamedTexturePtr Request(const std::string &resPath, int lod = 0);  // start loading, or return the one loading. Render thread only
+    void Release(const std::string &key);               // undo a Request, the texture is forgotten with its last user. Any thread
+    void Forget(const std::string &key);                // drop the texture, the next Request loads it again. Render thread only
+    static std::string VariantKey(const std::string &resPath, int lod);
+    static void HalveImage(DecodedImage &image);        // box filter the image down to half size
+    static bool IsOpaque(const DecodedImage &image);    // no pixel has any transparency
+    int  ProcessUploads();                              // upload what fits in the budget, returns textures completed
+    GLuint GetPlaceholder()                             { return placeholder; }
+
+    float GetUploadBudget()                             { return uploadBudgetMs; }
+    void  SetUploadBudget(float ms)                     { uploadBudgetMs = ms; }
+    int   GetPendingDecodes()                           { return pool.GetPending(); }
+    bool  HasPendingUploads();                          // decoded textures not fully uploaded yet
+    long  GetUploadedBytes()                            { return uploadedBytes; }
+    int   GetUploadedTextures()                         { return uploadedTextures; }
+};
+
+#endif
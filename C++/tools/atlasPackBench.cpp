@@ -0,0 +1,106 @@
+/* -----------------------------------------------------------------------------------
+   -- atlasPackBench.cpp
+   -- Copyright Robert Babiak, 2016
+   --
+   -- Packs the png images of a resource pack the same way TextureAtlas does at load
+   -- and reports how well the pages are filled and how long the packing took.
+   --
+   --   atlasPackBench <resource pack dir> [page size] [padding]
+   ----------------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ftw.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "../atlasPacker.hpp"
+
+struct ImageSize
+{
+    std::string path;
+    int width, height;
+};
+static std::vector<ImageSize> images;
+
+// -----------------------------------------------------------------------------------
+// Only the IHDR chunk is read, we don't need to decode the image to get its size.
+static bool ReadPngSize(const char *path, int &width, int &height)
+{
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    unsigned char header[24];
+    FILE *f = fopen(path, "rb");
+    if (f == NULL)
+    {
+        return false;
+    }
+    size_t n = fread(header, 1, sizeof(header), f);
+    fclose(f);
+    if (n != sizeof(header) || memcmp(header, signature, 8) != 0 || memcmp(header + 12, "IHDR", 4) != 0)
+    {
+        return false;
+    }
+    width  = (header[16] << 24) | (header[17] << 16) | (header[18] << 8) | header[19];
+    height = (header[20] << 24) | (header[21] << 16) | (header[22] << 8) | header[23];
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+static int VisitFile(const char *path, const struct stat *, int type, struct FTW *)
+{
+    if (type != FTW_F)
+    {
+        return 0;
+    }
+    size_t len = strlen(path);
+    if (len < 4 || strcasecmp(path + len - 4, ".png") != 0)
+    {
+        return 0;
+    }
+    ImageSize img;
+    img.path = path;
+    if (ReadPngSize(path, img.width, img.height))
+    {
+        images.push_back(img);
+    }
+    return 0;
+}
+
+// -----------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        printf("usage: %s <resource pack dir> [page size=4096] [padding=2]\n", argv[0]);
+        return 1;
+    }
+    int pageSize = argc > 2 ? atoi(argv[2]) : 4096;
+    int padding  = argc > 3 ? atoi(argv[3]) : 2;
+
+    nftw(argv[1], VisitFile, 16, FTW_PHYS);
+    if (images.empty())
+    {
+        printf("No png images found in %s\n", argv[1]);
+        return 1;
+    }
+
+    long long sourceArea = 0;
+    AtlasPacker packer(pageSize, pageSize, padding);
+    for (size_t i = 0; i < images.size(); ++i)
+    {
+        packer.Add(images[i].path, images[i].width, images[i].height);
+        sourceArea += (long long)images[i].width * images[i].height;
+    }
+
+    std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+    int pages = packer.Pack();
+    double ms = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+
+    printf("Images:          %zu (%zu too large for a page)\n", images.size(), packer.GetRejected().size());
+    printf("Source pixels:   %lld\n", sourceArea);
+    printf("Page size:       %dx%d, padding %d\n", pageSize, pageSize, padding);
+    printf("Pages:           %d\n", pages);
+    printf("Fill efficiency: %5.1f%%\n", packer.GetFillEfficiency() * 100.0f);
+    printf("Pack time:       %.3f ms\n", ms);
+    return 0;
+}
@@ -0,0 +1,672 @@
+/* -----------------------------------------------------------------------------------
+   -- renderBench.cpp
+   -- Copyright Robert Babiak, 2016
+   --
+   -- Renders a synthetic scene of RO_Images offscreen and reports the frame times
+   -- and the GL work per frame, fragments included. No window or GPU is needed, run it on the build
+   -- hosts against Mesa's llvmpipe:
+   --
+   --   LIBGL_ALWAYS_SOFTWARE=1 EGL_PLATFORM=surfaceless renderBench [options]
+   --
+   --     -n <images>       images in the scene                  (1000)
+   --     -t <textures>     distinct textures they share         (64)
+   --     -s <sets>         render sets the images are spread on (1)
+   --     -a <sets>         render sets collected each frame     (all)
+   --     -z <pixels>       texture size                         (64)
+   --     -f <frames>       frames measured                      (300)
+   --     -w <frames>       frames run before measuring          (10)
+   --     -W/-H <pixels>    framebuffer size                     (1280x720)
+   --     -m <mode>         direct, cached or batched            (direct)
+   --     -o                sort the render list by state first
+   --     -d                opaque pass, batched mode only
+   --     -p <percent>      textures with transparent pixels     (100)
+   --     -b                load the scene as a BulkLoad, no per property commands
+   --     -r <path>         save a Chrome trace of the first 10 measured frames
+   --     -c                report the RenderStats counters of the last measured frames
+   --     -g                draw the RenderStatsOverlay each frame, with -c
+   --
+   -- Link it with the render core objects (ro_base, ro_image, commandObject and the
+   -- texture/batching modules) but not the scene's command processor, the bench
+   -- applies the property commands itself at the start of each frame. There is no
+   -- build target for it here, it is built by hand next to the module.
+   ----------------------------------------------------------------------------------- */
+#include <boost/python.hpp>
+#include <boost/bind.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#define GLM_FORCE_RADIANS
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "yaml-cpp/yaml.h"
+
+#include "../ro_image.hpp"
+#include "../renderList.hpp"
+#include "../spriteBatcher.hpp"
+#include "../glStateCache.hpp"
+#include "../textureStreamer.hpp"
+#include "../textureCache.hpp"
+#include "../frameProfiler.hpp"
+#include "../renderStats.hpp"
+#include "../renderStatsOverlay.hpp"
+
+// -----------------------------------------------------------------------------------
+// There is no python thread in the bench, the commands are kept in order and applied
+// by DrainCommands the way the scene's command processor drains its queue.
+static long queuedCommands = 0;
+static std::vector<CommandObjectPtr> pendingCommands;
+void StaticQueueCommand(CommandObjectPtr cmd)
+{
+    ++queuedCommands;
+    pendingCommands.push_back(cmd);
+}
+
+// -----------------------------------------------------------------------------------
+// Applying a command can queue another, those are applied in the same drain.
+static void DrainCommands()
+{
+    for (size_t i = 0; i < pendingCommands.size(); ++i)
+    {
+        pendingCommands[i]->Apply();
+        pendingCommands[i]->Return();
+    }
+    pendingCommands.clear();
+}
+
+enum BenchMode { MODE_DIRECT, MODE_CACHED, MODE_BATCHED };
+
+struct BenchOptions
+{
+    int images, textures, sets, activeSets, textureSize;
+    int frames, warmup, width, height;
+    BenchMode mode;
+    bool sort;
+    bool opaquePass;
+    int translucent;
+    bool bulkLoad;
+    const char *tracePath;
+    bool renderStats;
+    bool overlay;
+};
+
+// -----------------------------------------------------------------------------------
+// The scene's default shader, the same uniforms RO_Image::RenderObject sets.
+static const char * benchVertexShader =
+    "#version 330 core\n"
+    "layout(location = 0) in vec3 vertPosition;\n"
+    "layout(location = 1) in vec2 vertTexCoord;\n"
+    "uniform mat4 model;\n"
+    "uniform mat4 ProjView;\n"
+    "out vec2 fragTexCoord;\n"
+    "void main()\n"
+    "{\n"
+    "    fragTexCoord = vertTexCoord;\n"
+    "    gl_Position = ProjView * model * vec4(vertPosition, 1.0);\n"
+    "}\n";
+
+static const char * benchFragmentShader =
+    "#version 330 core\n"
+    "uniform sampler2D tex;\n"
+    "in vec2 fragTexCoord;\n"
+    "out vec4 color;\n"
+    "void main()\n"
+    "{\n"
+    "    color = texture(tex, fragTexCoord);\n"
+    "}\n";
+
+// -----------------------------------------------------------------------------------
+static void Usage()
+{
+    printf("usage: renderBench [-n images] [-t textures] [-s sets] [-a active sets] [-z texture size]\n"
+           "                   [-f frames] [-w warmup frames] [-W width] [-H height]\n"
+           "                   [-m direct|cached|batched] [-o] [-d] [-p translucent percent] [-b]\n"
+           "                   [-r trace path] [-c] [-g]\n");
+}
+
+// -----------------------------------------------------------------------------------
+static bool ParseOptions(int argc, char **argv, BenchOptions &opt)
+{
+    opt.images = 1000; opt.textures = 64; opt.sets = 1; opt.activeSets = 0; opt.textureSize = 64;
+    opt.frames = 300; opt.warmup = 10; opt.width = 1280; opt.height = 720;
+    opt.mode = MODE_DIRECT; opt.sort = false; opt.opaquePass = false; opt.translucent = 100; opt.bulkLoad = false;
+    opt.tracePath = NULL; opt.renderStats = false; opt.overlay = false;
+
+    int c;
+    while ((c = getopt(argc, argv, "n:t:s:a:z:f:w:W:H:m:odp:br:cgh")) != -1)
+    {
+        switch (c)
+        {
+            case 'n': opt.images = atoi(optarg); break;
+            case 't': opt.textures = atoi(optarg); break;
+            case 's': opt.sets = atoi(optarg); break;
+            case 'a': opt.activeSets = atoi(optarg); break;
+            case 'z': opt.textureSize = atoi(optarg); break;
+            case 'f': opt.frames = atoi(optarg); break;
+            case 'w': opt.warmup = atoi(optarg); break;
+            case 'W': opt.width = atoi(optarg); break;
+            case 'H': opt.height = atoi(optarg); break;
+            case 'o': opt.sort = true; break;
+            case 'd': opt.opaquePass = true; break;
+            case 'p': opt.translucent = atoi(optarg); break;
+            case 'b': opt.bulkLoad = true; break;
+            case 'r': opt.tracePath = optarg; break;
+            case 'c': opt.renderStats = true; break;
+            case 'g': opt.overlay = true; break;
+            case 'm':
+                if (strcmp(optarg, "direct") == 0)          opt.mode = MODE_DIRECT;
+                else if (strcmp(optarg, "cached") == 0)     opt.mode = MODE_CACHED;
+                else if (strcmp(optarg, "batched") == 0)    opt.mode = MODE_BATCHED;
+                else return false;
+                break;
+            default:
+                return false;
+        }
+    }
+    if (opt.images <= 0 || opt.textures <= 0 || opt.sets <= 0 || opt.frames <= 0 || opt.textureSize <= 0)
+    {
+        return false;
+    }
+    if (opt.activeSets <= 0 || opt.activeSets > opt.sets)
+    {
+        opt.activeSets = opt.sets;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// A pbuffer on whatever EGL display we get, with Mesa and no X server that is the
+// surfaceless platform running llvmpipe.
+static bool CreateContext(int width, int height)
+{
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display == EGL_NO_DISPLAY || !eglInitialize(display, NULL, NULL))
+    {
+        printf("ERROR: no EGL display\n");
+        return false;
+    }
+    static const EGLint configAttribs[] = {
+        EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8, EGL_GREEN_SIZE, 8, EGL_BLUE_SIZE, 8, EGL_ALPHA_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLConfig config;
+    EGLint numConfigs = 0;
+    if (!eglChooseConfig(display, configAttribs, &config, 1, &numConfigs) || numConfigs == 0)
+    {
+        printf("ERROR: no EGL config with a pbuffer and desktop GL\n");
+        return false;
+    }
+    const EGLint surfaceAttribs[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+    EGLSurface surface = eglCreatePbufferSurface(display, config, surfaceAttribs);
+
+    eglBindAPI(EGL_OPENGL_API);
+    static const EGLint contextAttribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 3,
+        EGL_CONTEXT_MINOR_VERSION, 3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    EGLContext context = eglCreateContext(display, config, EGL_NO_CONTEXT, contextAttribs);
+    if (surface == EGL_NO_SURFACE || context == EGL_NO_CONTEXT || !eglMakeCurrent(display, surface, surface, context))
+    {
+        printf("ERROR: could not create a GL 3.3 core context (0x%x)\n", eglGetError());
+        return false;
+    }
+#ifdef __glew_h__
+    glewExperimental = GL_TRUE;
+    glewInit();
+    glGetError();   // glew trips GL_INVALID_ENUM on core profiles
+#endif
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+static GLuint CompileShader(GLenum type, const char *source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    GLint status = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+    if (status != GL_TRUE)
+    {
+        char log[1024];
+        glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+        printf("ERROR: renderBench shader compile failed:\n%s\n", log);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// -----------------------------------------------------------------------------------
+static GLuint BuildProgram()
+{
+    GLuint vs = CompileShader(GL_VERTEX_SHADER, benchVertexShader);
+    GLuint fs = CompileShader(GL_FRAGMENT_SHADER, benchFragmentShader);
+    if (vs == 0 || fs == 0)
+    {
+        return 0;
+    }
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vs);
+    glAttachShader(program, fs);
+    glLinkProgram(program);
+    glDeleteShader(vs);
+    glDeleteShader(fs);
+    GLint status = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &status);
+    return status == GL_TRUE ? program : 0;
+}
+
+// -----------------------------------------------------------------------------------
+// The base quad the scene binds before drawing images, 0 to BASEQUADSIDELENGTH.
+static GLuint BuildQuad()
+{
+    const float L = BASEQUADSIDELENGTH;
+    const float verts[] = {
+        0.f, 0.f, 0.f,  0.f, 1.f,
+        L,   0.f, 0.f,  1.f, 1.f,
+        L,   L,   0.f,  1.f, 0.f,
+        0.f, L,   0.f,  0.f, 0.f
+    };
+    const GLuint indices[] = { 0, 1, 2, 2, 3, 0 };
+    GLuint vao, vbo, ebo;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(verts), verts, GL_STATIC_DRAW);
+    glGenBuffers(1, &ebo);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
+    return vao;
+}
+
+// -----------------------------------------------------------------------------------
+// "bench/<n>" decodes to a checker board tinted by n, so every texture is different.
+// The first percent of the textures have a see through border.
+static bool DecodeSynthetic(int size, int textures, int translucent, const std::string &resPath, DecodedImage &image)
+{
+    int n = atoi(resPath.c_str() + resPath.find('/') + 1);
+    bool seeThrough = n * 100 < textures * translucent;
+    image.width = image.height = size;
+    image.pixels.resize(size * size * 4);
+    for (int y = 0; y < size; ++y)
+    {
+        for (int x = 0; x < size; ++x)
+        {
+            unsigned char *p = &image.pixels[(y * size + x) * 4];
+            int checker = ((x / 8) + (y / 8)) & 1;
+            p[0] = (unsigned char)(n * 37);
+            p[1] = (unsigned char)(n * 91);
+            p[2] = checker ? 255 : 64;
+            p[3] = seeThrough && (x < 2 || y < 2 || x >= size - 2 || y >= size - 2) ? 0 : 255;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Every property goes in through DecodeYaml, the same way a scene file loads.
+static void BuildScene(const BenchOptions &opt, RO_ImageVector &images)
+{
+    srand(1234);
+    for (int i = 0; i < opt.images; ++i)
+    {
+        char resPath[32];
+        char set[32];
+        snprintf(resPath, sizeof(resPath), "bench/%d", i % opt.textures);
+        snprintf(set, sizeof(set), "set%d", i % opt.sets);
+
+        YAML::Node node;
+        node["resPath"] = resPath;
+        node["size"] = YAML::Load("[" + std::to_string(opt.textureSize) + ", " + std::to_string(opt.textureSize) + ", 0]");
+        node["position"].push_back(rand() % opt.width);
+        node["position"].push_back(rand() % opt.height);
+        node["position"].push_back(i * 0.001f);
+        node["__renderSet"].push_back(set);
+
+        RO_ImagePtr img(new RO_Image(NULL));
+        BulkLoad bulk(opt.bulkLoad ? img.get() : NULL);
+        img->DecodeYaml(node);
+        images.push_back(img);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// A half faded image has to reach the batch at half alpha, BatchObject takes the
+// world alpha the transform wrote. Nothing is drawn, the instance is taken back.
+static bool CheckBatchAlpha(const BenchOptions &opt, SpriteBatcher &batcher, RenderSettingsPtr settings)
+{
+    YAML::Node node;
+    node["resPath"] = "bench/0";
+    node["size"] = YAML::Load("[" + std::to_string(opt.textureSize) + ", " + std::to_string(opt.textureSize) + ", 0]");
+    node["alpha"] = 0.5f;
+    RO_ImagePtr img(new RO_Image(NULL));
+    {
+        BulkLoad bulk(img.get());
+        img->DecodeYaml(node);
+    }
+    img->Transform(glm::mat4(1.f));
+    bool batched = img->BatchObject(&batcher, settings);
+    std::vector<SpriteInstance> pending;
+    batcher.TakePending(pending);
+    if (!batched || pending.size() != 1 || std::abs(pending[0].alpha - 0.5f) > 1e-6f)
+    {
+        printf("ERROR: renderBench a sprite at alpha 0.5 batched at %.3f\n", pending.empty() ? -1.f : pending.back().alpha);
+        return false;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+static double Percentile(const std::vector<double> &sorted, double p)
+{
+    size_t i = (size_t)(p * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(i, sorted.size() - 1)];
+}
+
+// -----------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    BenchOptions opt;
+    if (!ParseOptions(argc, argv, opt))
+    {
+        Usage();
+        return 1;
+    }
+    Py_Initialize();
+    // the bench is the render thread too, and the frame loop runs without the GIL
+    // (GIL_FREE_CHECK in CommandObject::Apply). Nothing here touches a python object.
+    PyThreadState *mainThread = PyEval_SaveThread();
+    if (!CreateContext(opt.width, opt.height))
+    {
+        return 1;
+    }
+    printf("renderer:    %s\n", (const char *)glGetString(GL_RENDERER));
+    printf("version:     %s\n", (const char *)glGetString(GL_VERSION));
+
+    GLuint program = BuildProgram();
+    GLuint quad = BuildQuad();
+    if (program == 0)
+    {
+        return 1;
+    }
+    glViewport(0, 0, opt.width, opt.height);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+    TextureStreamer::StartInstance();
+    TextureStreamerPtr streamer = TextureStreamer::GetInstance();
+    streamer->Init();
+    streamer->SetDecoder(boost::bind(&DecodeSynthetic, opt.textureSize, opt.textures, opt.translucent, _1, _2));
+    streamer->SetUploadBudget(1000.f);     // load time isn't what we are measuring
+    TextureCache::StartInstance();
+    TextureCachePtr cache = TextureCache::GetInstance();
+    FrameProfiler::StartInstance();
+    FrameProfilerPtr profiler = FrameProfiler::GetInstance();
+    RenderStats::SetEnabled(opt.renderStats);
+    RenderStats::SetOverlay(opt.overlay);
+    RenderStatsOverlay overlay;
+    if (opt.overlay && !overlay.Init())
+    {
+        return 1;
+    }
+
+    SpriteBatcher batcher;
+    if (opt.mode == MODE_BATCHED && !batcher.Init())
+    {
+        return 1;
+    }
+    batcher.SetOpaquePass(opt.opaquePass);
+    GLuint fragmentQuery;
+    glGenQueries(1, &fragmentQuery);
+    GLStateCache glState;
+    RenderListSorter sorter;
+
+    RO_ImageVector images;
+    long bypassedBefore = BulkLoad::Bypassed();
+    std::chrono::steady_clock::time_point loadStart = std::chrono::steady_clock::now();
+    queuedCommands = 0;
+    BuildScene(opt, images);
+    DrainCommands();
+    double loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - loadStart).count();
+    long loadCommands = queuedCommands;
+    long loadBypassed = BulkLoad::Bypassed() - bypassedBefore;
+
+    stringList renderSet;
+    for (int i = 0; i < opt.activeSets; ++i)
+    {
+        renderSet.push_back("set" + std::to_string(i));
+    }
+
+    RenderSettings settings;
+    settings.modelLocation = glGetUniformLocation(program, "model");
+    settings.vpLocation = glGetUniformLocation(program, "ProjView");
+    settings.tsModelLocation = -1;
+    settings.tsVPLocation = -1;
+    settings.defaultShaderID = program;
+    settings.tokenShaderID = -1;
+    settings.ProjViewMat = glm::ortho(0.f, (float)opt.width, 0.f, (float)opt.height, -1000.f, 1000.f);
+    settings.viewportSize = glm::vec2(opt.width, opt.height);
+    settings.glState = opt.mode == MODE_CACHED ? &glState : NULL;
+    if (opt.mode == MODE_BATCHED && !CheckBatchAlpha(opt, batcher, &settings))
+    {
+        return 1;
+    }
+
+    RenderObjectVector renderables;
+    renderables.reserve(opt.images);
+    std::vector<double> frameMs, transformMs, collectMs, renderMs;
+    long drawCalls = 0, stateCalls = 0, stateCallsSaved = 0, collected = 0, opaque = 0;
+    double fragments = 0;
+
+    // run until every texture is up, then the warmup, then the measured frames
+    int uploaded = 0;
+    int textureCount = std::min(opt.textures, opt.images);
+    for (int frame = 0; frame < opt.warmup + opt.frames; )
+    {
+        if (opt.tracePath && uploaded >= textureCount && frame == opt.warmup && !profiler->GetCapturing() && !profiler->GetReady())
+        {
+            profiler->Capture(std::min(opt.frames, 10));
+        }
+        std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+        {
+            FRAME_ZONE("Commands")
+            RENDER_PHASE(RS_PHASE_COMMANDS)
+            DrainCommands();
+        }
+        {
+            FRAME_ZONE("Uploads")
+            cache->Update();
+            uploaded += streamer->ProcessUploads();
+        }
+
+        renderables.clear();
+        glm::mat4 identity(1.f);
+        {
+            FRAME_ZONE("Transform")
+            RENDER_PHASE(RS_PHASE_TRANSFORM)
+            for (RO_ImageVector::iterator it = images.begin(); it != images.end(); ++it)
+            {
+                (*it)->Transform(identity);
+            }
+        }
+        std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+        RenderObjectVectorPtr list = &renderables;
+        {
+            FRAME_ZONE("Collect")
+            RENDER_PHASE(RS_PHASE_COLLECT)
+            for (RO_ImageVector::iterator it = images.begin(); it != images.end(); ++it)
+            {
+                (*it)->CollectRenderables(&renderables, renderSet);
+            }
+            if (opt.sort)
+            {
+                list = sorter.Sort(list, settings.ProjViewMat);
+            }
+        }
+        std::chrono::steady_clock::time_point t2 = std::chrono::steady_clock::now();
+
+        long draws = 0;
+        {
+            FRAME_ZONE("Render")
+            RENDER_PHASE(RS_PHASE_RENDER)
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glBeginQuery(GL_SAMPLES_PASSED, fragmentQuery);
+            glUseProgram(program);
+            glBindVertexArray(quad);
+            if (opt.mode == MODE_BATCHED)
+            {
+                batcher.Render(list, &settings);
+                draws = batcher.GetDrawCalls();
+                opaque += batcher.GetSpritesOpaque();
+            }
+            else
+            {
+                if (opt.mode == MODE_CACHED)
+                {
+                    glState.BeginFrame();
+                }
+                for (RenderObjectVector::iterator it = list->begin(); it != list->end(); ++it)
+                {
+                    (*it)->RenderObject(&settings);
+                }
+                if (opt.mode == MODE_CACHED)
+                {
+                    glState.EndFrame();
+                }
+                draws = list->size();
+            }
+            glEndQuery(GL_SAMPLES_PASSED);
+            glFinish();     // llvmpipe rasterizes on its own threads, wait for it
+        }
+        std::chrono::steady_clock::time_point t3 = std::chrono::steady_clock::now();
+        GL_CHECK_ERROR("GL Error: renderBench frame")
+        overlay.Draw();     // after t3, the overlay isn't part of the frame being measured
+        profiler->EndFrame();
+        RenderStats::EndFrame();
+
+        // a texture whose decode failed never uploads, don't wait on it forever
+        if (uploaded < textureCount && streamer->GetPendingDecodes() == 0 && !streamer->HasPendingUploads())
+        {
+            printf("ERROR: renderBench only %d of %d textures uploaded, the rest failed to decode\n", uploaded, textureCount);
+            return 1;
+        }
+        if (uploaded < textureCount || frame++ < opt.warmup)
+        {
+            continue;
+        }
+        frameMs.push_back(std::chrono::duration<double, std::milli>(t3 - t0).count());
+        transformMs.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+        collectMs.push_back(std::chrono::duration<double, std::milli>(t2 - t1).count());
+        renderMs.push_back(std::chrono::duration<double, std::milli>(t3 - t2).count());
+        GLuint samples = 0;
+        glGetQueryObjectuiv(fragmentQuery, GL_QUERY_RESULT, &samples);
+        fragments += samples;
+        drawCalls += draws;
+        collected += list->size();
+        stateCalls += glState.GetCallsIssued();
+        stateCallsSaved += glState.GetCallsSaved();
+    }
+
+    const char *modeNames[] = { "direct", "cached", "batched" };
+    printf("scene:       %d images, %d textures of %dpx, %d/%d render sets\n", opt.images, opt.textures, opt.textureSize, opt.activeSets, opt.sets);
+    printf("mode:        %s%s%s, %d frames at %dx%d\n", modeNames[opt.mode], opt.sort ? " sorted" : "", opt.opaquePass ? " opaque pass" : "", opt.frames, opt.width, opt.height);
+    printf("load:        %.2f ms%s, %ld commands queued, %ld updates written directly\n", loadMs, opt.bulkLoad ? " bulk" : "", loadCommands, loadBypassed);
+
+    std::vector<double> *series[] = { &frameMs, &transformMs, &collectMs, &renderMs };
+    const char *seriesNames[] = { "frame", "transform", "collect", "render" };
+    printf("%-12s %9s %9s %9s %9s %9s\n", "ms", "mean", "p50", "p90", "p99", "max");
+    for (int s = 0; s < 4; ++s)
+    {
+        std::vector<double> sorted = *series[s];
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0;
+        for (size_t i = 0; i < sorted.size(); ++i)
+        {
+            sum += sorted[i];
+        }
+        printf("%-12s %9.3f %9.3f %9.3f %9.3f %9.3f\n", seriesNames[s], sum / sorted.size(),
+            Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted.back());
+    }
+    printf("per frame:   %.0f collected, %.0f draw calls, %.0f fragments (%.2fx the screen)", (double)collected / opt.frames, (double)drawCalls / opt.frames,
+        fragments / opt.frames, fragments / opt.frames / ((double)opt.width * opt.height));
+    if (opt.opaquePass)
+    {
+        printf(", %.0f opaque sprites", (double)opaque / opt.frames);
+    }
+    if (opt.mode == MODE_CACHED)
+    {
+        printf(", %.0f state calls, %.0f skipped by the state cache", (double)stateCalls / opt.frames, (double)stateCallsSaved / opt.frames);
+    }
+    if (opt.sort)
+    {
+        printf(", %ld texture changes (%ld unsorted)", sorter.GetKeyChangesAfter(), sorter.GetKeyChangesBefore());
+    }
+    printf("\n");
+    if (opt.renderStats)
+    {
+        // the history only holds the last RENDER_STATS_HISTORY frames
+        uint64_t values[RS_COUNT];
+        double sums[RS_COUNT] = {0};
+        int count = 0;
+        for (int age = 0; age < std::min(opt.frames, RenderStats::GetFrameCount()); ++age)
+        {
+            if (RenderStats::GetFrame(age, values))
+            {
+                for (int s = 0; s < RS_COUNT; ++s)
+                {
+                    sums[s] += values[s];
+                }
+                ++count;
+            }
+        }
+        printf("stats:      ");
+        for (int s = 0; s < RS_COUNT && count > 0; ++s)
+        {
+            if (s >= RS_FIRST_PHASE)
+            {
+                printf(" %s %.3f", RenderStats::StatName(s), sums[s] / count / 1000000.0);
+            }
+            else
+            {
+                printf(" %s %.0f", RenderStats::StatName(s), sums[s] / count);
+            }
+        }
+        printf(", the last %d frames\n", count);
+    }
+    if (opt.tracePath && profiler->GetReady())
+    {
+        profiler->Save(opt.tracePath);
+        printf("trace:       %d frames, %ld zones, %ld dropped, saved to %s\n", profiler->GetFramesCaptured(), profiler->GetEvents(), profiler->GetDropped(), opt.tracePath);
+    }
+
+    DrainCommands();
+    images.clear();
+    cache->Update();
+    overlay.Shutdown();
+    batcher.Shutdown();
+    streamer->Shutdown();
+    TextureCache::StopInstance();
+    TextureStreamer::StopInstance();
+    FrameProfiler::StopInstance();
+    PyEval_RestoreThread(mainThread);
+    return 0;
+}
@@ -0,0 +1,144 @@
+/* -----------------------------------------------------------------------------------
+   -- sceneCompile.cpp
+   -- Copyright Robert Babiak, 2016
+   --
+   -- Converts a YAML scene to the compiled binary form the scene can map at load.
+   -- With -t it also times reading both forms, the YAML parse against mapping the
+   -- binary and walking every node, which is the part of the load the format replaces,
+   -- then how the SceneLoader's parallel parse scales from one thread up to every core.
+   --
+   --   sceneCompile [-t] <scene.yaml> <scene.sdts>
+   ----------------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <fstream>
+#include <sstream>
+#include "../sceneBinary.hpp"
+#include "../sceneLoader.hpp"
+
+typedef std::chrono::high_resolution_clock Clock;
+
+// -----------------------------------------------------------------------------------
+static double Ms(Clock::time_point start)
+{
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// -----------------------------------------------------------------------------------
+// Reads the same fields DecodeYaml does, so both sides do the same amount of work.
+static double WalkYaml(const YAML::Node &node)
+{
+    double sum = 0;
+    if (node.IsSequence())
+    {
+        for (YAML::const_iterator it = node.begin(); it != node.end(); ++it) sum += WalkYaml(*it);
+        return sum;
+    }
+    if (node["rotation"])   sum += node["rotation"].as<float>();
+    if (node["alpha"])      sum += node["alpha"].as<float>();
+    if (node["position"])   sum += node["position"][0].as<float>() + node["position"][1].as<float>();
+    if (node["resPath"])    sum += node["resPath"].as<std::string>().size();
+    if (node["__children"]) sum += WalkYaml(node["__children"]);
+    return sum;
+}
+
+// -----------------------------------------------------------------------------------
+static double WalkBinary(SceneBinary &binary)
+{
+    double sum = 0;
+    for (int i = 0; i < binary.GetNumNodes(); ++i)
+    {
+        const SceneBinaryNode &node = binary.GetNode(i);
+        if (node.fields & SBF_ROTATION) sum += node.rotation;
+        if (node.fields & SBF_ALPHA)    sum += node.alpha;
+        if (node.fields & SBF_POSITION) sum += node.position[0] + node.position[1];
+        if (node.fields & SBF_RESPATH)  sum += strlen(binary.GetString(node.resPath));
+    }
+    return sum;
+}
+
+// -----------------------------------------------------------------------------------
+static long FileSize(const char *path)
+{
+    struct stat st;
+    return stat(path, &st) == 0 ? (long)st.st_size : -1;
+}
+
+// -----------------------------------------------------------------------------------
+int main(int argc, char **argv)
+{
+    bool timing = false;
+    int arg = 1;
+    if (arg < argc && strcmp(argv[arg], "-t") == 0)
+    {
+        timing = true;
+        ++arg;
+    }
+    if (argc - arg != 2)
+    {
+        printf("usage: sceneCompile [-t] <scene.yaml> <scene.sdts>\n");
+        return 1;
+    }
+    const char *yamlPath = argv[arg];
+    const char *outPath = argv[arg + 1];
+
+    Clock::time_point start = Clock::now();
+    if (!SceneBinary::Compile(yamlPath, outPath))
+    {
+        return 1;
+    }
+    double compileMs = Ms(start);
+
+    SceneBinary binary;
+    if (!binary.Open(outPath))
+    {
+        return 1;
+    }
+    printf("%s: %d nodes, %d roots, %d strings, %ld bytes (yaml %ld bytes), compiled in %.1f ms\n",
+           outPath, binary.GetNumNodes(), binary.GetNumRoots(), binary.GetNumStrings(),
+           FileSize(outPath), FileSize(yamlPath), compileMs);
+    int totalNodes = binary.GetNumNodes();
+    binary.Close();
+
+    if (timing)
+    {
+        start = Clock::now();
+        double yamlSum = WalkYaml(YAML::LoadFile(yamlPath));
+        double yamlMs = Ms(start);
+
+        start = Clock::now();
+        binary.Open(outPath);
+        double binarySum = WalkBinary(binary);
+        binary.Close();
+        double binaryMs = Ms(start);
+
+        printf("read: yaml %.2f ms, binary %.2f ms (%.0fx)%s\n", yamlMs, binaryMs, yamlMs / (binaryMs > 0 ? binaryMs : 1e-3),
+               fabs(yamlSum - binarySum) <= 1e-6 * fabs(yamlSum) ? "" : "  ** the two forms differ **");
+
+        std::ifstream file(yamlPath, std::ios::in | std::ios::binary);
+        std::ostringstream text;
+        text << file.rdbuf();
+        int cores = std::max(1, (int)std::thread::hardware_concurrency());
+        double oneThreadMs = 0;
+        for (int threads = 1; ; threads = std::min(threads * 2, cores))
+        {
+            SceneLoader loader(threads);
+            std::vector<SceneBinaryPtr> parts;
+            loader.Decode(text.str(), parts);
+            int numNodes = 0;
+            for (size_t i = 0; i < parts.size(); ++i) numNodes += parts[i]->GetNumNodes();
+            if (threads == 1) oneThreadMs = loader.GetDecodeMs();
+            printf("parallel parse: %2d threads, %3d parts, %.2f ms (%.2fx)%s\n", threads, loader.GetNumParts(), loader.GetDecodeMs(),
+                   oneThreadMs / loader.GetDecodeMs(), numNodes == totalNodes ? "" : "  ** node count differs **");
+            if (threads == cores) break;
+        }
+    }
+    return 0;
+}
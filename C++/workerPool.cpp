@@ -0,0 +1,150 @@
+/* -----------------------------------------------------------------------------------
+   -- workerPool.cpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#include <stdio.h>
+#include <boost/bind.hpp>
+#include "workerPool.hpp"
+
+// -----------------------------------------------------------------------------------
+int WorkerPool::DefaultThreads()
+{
+    int cores = std::thread::hardware_concurrency();
+    return cores > 2 ? cores - 1 : 1;
+}
+
+// -----------------------------------------------------------------------------------
+WorkerPool::WorkerPool(int numThreads) :
+    threads()
+  , jobs()
+  , busy(0)
+  , stopping(false)
+{
+    if (numThreads <= 0)
+    {
+        numThreads = DefaultThreads();
+    }
+    for (int i = 0; i < numThreads; ++i)
+    {
+        threads.push_back(std::thread(&WorkerPool::WorkerLoop, this));
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Anything still queued is finished before the workers exit.
+WorkerPool::~WorkerPool()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    jobReady.notify_all();
+    for (size_t i = 0; i < threads.size(); ++i)
+    {
+        threads[i].join();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void WorkerPool::Post(WorkerJob job)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        jobs.push_back(job);
+    }
+    jobReady.notify_one();
+}
+
+// -----------------------------------------------------------------------------------
+void WorkerPool::Wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (!jobs.empty() || busy > 0)
+    {
+        allDone.wait(guard);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+void WorkerPool::Post(WorkerJob job, WorkerGroup &group)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        ++group.pending;
+        jobs.push_back(boost::bind(&WorkerPool::RunGrouped, this, job, &group));
+    }
+    jobReady.notify_one();
+}
+
+// -----------------------------------------------------------------------------------
+void WorkerPool::Wait(WorkerGroup &group)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (group.pending > 0)
+    {
+        allDone.wait(guard);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Worker thread. The group is counted down even if the job throws.
+void WorkerPool::RunGrouped(WorkerJob job, WorkerGroup *group)
+{
+    try
+    {
+        job();
+    }
+    catch (std::exception &e)
+    {
+        printf("ERROR: WorkerPool job threw: %s\n", e.what());
+    }
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        --group->pending;
+    }
+    allDone.notify_all();
+}
+
+// -----------------------------------------------------------------------------------
+int WorkerPool::GetPending()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    return jobs.size() + busy;
+}
+
+// -----------------------------------------------------------------------------------
+void WorkerPool::WorkerLoop()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (true)
+    {
+        while (jobs.empty() && !stopping)
+        {
+            jobReady.wait(guard);
+        }
+        if (jobs.empty())
+        {
+            return; // stopping and nothing left to do
+        }
+        WorkerJob job = jobs.front();
+        jobs.pop_front();
+        ++busy;
+
+        guard.unlock();
+        try
+        {
+            job();
+        }
+        catch (std::exception &e)
+        {
+            printf("ERROR: WorkerPool job threw: %s\n", e.what());
+        }
+        guard.lock();
+
+        --busy;
+        if (jobs.empty() && busy == 0)
+        {
+            allDone.notify_all();
+        }
+    }
+}
@@ -0,0 +1,59 @@
+/* -----------------------------------------------------------------------------------
+   -- workerPool.hpp
+   -- Copyright Robert Babiak, 2016
+   ----------------------------------------------------------------------------------- */
+#ifndef __WORKER_POOL_HPP__
+#define __WORKER_POOL_HPP__
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+class WorkerPool;
+typedef boost::shared_ptr<WorkerPool> WorkerPoolPtr;
+typedef boost::function<void (void)> WorkerJob;
+
+// -----------------------------------------------------------------------------------
+// The jobs one user of a shared pool posted, so it can wait for its own jobs without
+// waiting on everyone else's. Guarded by the pool's lock.
+struct WorkerGroup
+{
+    int     pending;                            // jobs posted and not finished
+    WorkerGroup() : pending(0) {}
+};
+
+// -----------------------------------------------------------------------------------
+// A plain pool of worker threads pulling jobs off a shared queue.
+// Jobs must not touch python or GL, those stay on their own threads.
+class WorkerPool
+{
+private:
+    std::vector<std::thread>    threads;        // the workers
+    std::deque<WorkerJob>       jobs;           // jobs waiting for a worker
+    std::mutex                  lock;           // guards jobs, busy and stopping
+    std::condition_variable     jobReady;       // signalled when a job is posted
+    std::condition_variable     allDone;        // signalled when the pool goes idle
+    int                         busy;           // jobs being run right now
+    bool                        stopping;       // the pool is shutting down
+
+    void WorkerLoop();
+    void RunGrouped(WorkerJob job, WorkerGroup *group);
+
+public:
+    WorkerPool(int numThreads = 0);             // 0 picks one less than the number of cores
+    ~WorkerPool();
+
+    void Post(WorkerJob job);                   // queue a job for any worker
+    void Wait();                                // block until every posted job has finished
+    void Post(WorkerJob job, WorkerGroup &group);   // .. counted in the group
+    void Wait(WorkerGroup &group);              // block until the group's jobs have finished
+    int  GetNumThreads()                        { return threads.size(); }
+    int  GetPending();                          // jobs queued or running
+
+    static int DefaultThreads();
+};
+
+#endif
@@ -25,6 +25,11 @@
         on_unprime_token    - will fire when a token has requested unsubscripted from the server.
                               the token is removed from the local invItems even if the server call fails.
 
+    Token deltas:
+        Position, rotation, visibility, scale, alpha and visible state of the tokens with a
+        render object come batched, one binary packet a tick (see deltaStream.hpp), and are
+        applied through Token.Update like a tokenUpdate, firing on_update_token per token.
+
    ----------------------------------------------------------------------------------- */
 
 // -----------------------------------------------------------------------------------
@@ -343,6 +348,22 @@ function TokenManager(socket)
             }
         }, self);
 
+        // The batched token deltas, binary or base64 in JSON where the socket can't send binary.
+        self.webSocket.addOpcodeFunction("__binary", function(opcode, buffer)
+        {
+            self.ApplyTokenDeltas(buffer);
+        }, self);
+        self.webSocket.addOpcodeFunction("tokenDelta", function(opcode, data)
+        {
+            var raw = atob(data.packet);
+            var bytes = new Uint8Array(raw.length);
+            for (var i = 0; i < raw.length; i++)
+            {
+                bytes[i] = raw.charCodeAt(i);
+            }
+            self.ApplyTokenDeltas(bytes.buffer);
+        }, self);
+
         self.webSocket.addOpcodeFunction("tokenRemove", function(opcode, data)
         {
             // if we have the item then call update on it.
@@ -480,6 +501,115 @@ TokenManager.prototype.GetToken = function( tokenID )
     return this.tokens[tokenID];
 };
 
+// -----------------------------------------------------------------------------------
+// The packet layout and the scales must match deltaStream.hpp.
+var TOKEN_DELTA_VERSION = 2;
+var TOKEN_DELTA_POSITION_SCALE = 8;
+var TOKEN_DELTA_ROTATION_SCALE = 10;
+var TOKEN_DELTA_SCALE_SCALE = 1000;
+
+// -----------------------------------------------------------------------------------
+function DecodeTokenDeltas(buffer)
+// Returns a list of deltas, each shaped like a tokenUpdate, or null if the packet isn't
+// one we know. Varints stay under 2^53, so plain arithmetic is used instead of bit ops.
+{
+    var bytes = new Uint8Array(buffer);
+    var pos = 0;
+    function Varint()
+    {
+        var value = 0;
+        var mul = 1;
+        var b;
+        do
+        {
+            b = bytes[pos++];
+            value += (b & 0x7f) * mul;
+            mul *= 128;
+        } while (b & 0x80);
+        return value;
+    }
+    function Zigzag()
+    {
+        var v = Varint();
+        return v % 2 === 0 ? v / 2 : -(v + 1) / 2;
+    }
+    function Signed(scale)
+    {
+        return Zigzag() / scale;
+    }
+
+    if (bytes.length === 0 || bytes[pos++] !== TOKEN_DELTA_VERSION)
+    {
+        return null;
+    }
+    var tick = Varint();
+    var count = Varint();
+    var deltas = [];
+    var itemID = 0;
+    for (var i = 0; i < count; i++)
+    {
+        itemID += Zigzag();
+        var fields = Varint();
+        var delta = {item_id: itemID, tick: tick};
+        if (fields & 1)
+        {
+            var x = Signed(TOKEN_DELTA_POSITION_SCALE);
+            var y = Signed(TOKEN_DELTA_POSITION_SCALE);
+            delta.position = [x, y, Signed(TOKEN_DELTA_POSITION_SCALE)];
+        }
+        if (fields & 2)
+        {
+            delta.rotation = Signed(TOKEN_DELTA_ROTATION_SCALE);
+        }
+        if (fields & 4)
+        {
+            var sx = Signed(TOKEN_DELTA_SCALE_SCALE);
+            delta.scale = [sx, Signed(TOKEN_DELTA_SCALE_SCALE)];
+        }
+        if (fields & 8)
+        {
+            delta.alpha = bytes[pos++] / 255;
+        }
+        if (fields & 16)
+        {
+            delta.visible = bytes[pos++];
+        }
+        if (fields & 32)
+        {
+            var length = Varint();
+            var state = "";
+            for (var c = 0; c < length; c++)
+            {
+                state += String.fromCharCode(bytes[pos++]);
+            }
+            delta.visibleState = decodeURIComponent(escape(state));
+        }
+        deltas.push(delta);
+    }
+    return deltas;
+}
+
+// -----------------------------------------------------------------------------------
+TokenManager.prototype.ApplyTokenDeltas = function(buffer)
+{
+    var deltas = DecodeTokenDeltas(buffer);
+    if (deltas === null)
+    {
+        console.error("TokenManager: unknown token delta packet");
+        return;
+    }
+    for (var i = 0; i < deltas.length; i++)
+    {
+        var delta = deltas[i];
+        // Tokens still priming are null, they get the current values with their data.
+        if (this.tokens.hasOwnProperty(delta.item_id) && this.tokens[delta.item_id] !== null)
+        {
+            this.tokens[delta.item_id].Update(delta);
+            this.TriggerEvent("update_token", delta.item_id, delta);
+        }
+    }
+};
+
 // -----------------------------------------------------------------------------------
 TokenManager.prototype.TriggerEvent = function( name, tokenID, token)
 {
@@ -16,6 +16,7 @@ function ProtocolWebSocket(port, protocol, name, protoFuncs, callback)
         this.rpcCalls = {};
         this.handlers = protoFuncs;
         this.socket = new WebSocket(host, protocol);
+        this.socket.binaryType = "arraybuffer";
         this.socket.protocolHandler = this;
         this.socket.onopen = function (e)
         {
@@ -50,7 +51,25 @@ ProtocolWebSocket.prototype.OnMessage = function(e)
 // For RPC calls we store a callback that will be executed when the returned message is
 // sent from the server. If the server fails to send a response (error) the callback
 // function will be abandoned and the web socket will leak memory.
+// Binary messages have no opcode, they go to the "__binary" handler.
 {
+    if (e.data instanceof ArrayBuffer)
+    {
+        var binary = this.protocolHandler.handlers["__binary"];
+        if (binary === undefined)
+        {
+            console.error("received binary message without a handler");
+        }
+        else if (binary.constructor === Array)
+        {
+            binary[0].call(binary[1], "__binary", e.data);
+        }
+        else
+        {
+            binary.call(this, "__binary", e.data);
+        }
+        return;
+    }
     var data = JSON.parse(e.data);
     var opcode = data["opcode"];
     if (opcode.indexOf("__RPC.") === 0)
@@ -0,0 +1,78 @@
+## -----------------------------------------------------------------------------------
+## -- CommandFuture.py
+## -- Copyright Robert Babiak, 2016
+## -----------------------------------------------------------------------------------
+import stackless
+
+
+# ======================================================================================
+class CommandFuture(object):
+    """
+        Resolves once the render thread has applied every command queued before it was
+        made. Wait blocks the calling tasklet on a stackless channel, the other tasklets
+        keep running.
+    """
+    def __init__(self, fence, futures):
+        self.fence = fence
+        self.futures = futures
+        self.channel = stackless.channel()
+        self.channel.preference = 1
+
+    # -----------------------------------------------------------------------------------
+    def IsDone(self):
+        return self.fence.done
+
+    # -----------------------------------------------------------------------------------
+    def Wait(self):
+        if self.fence.done:
+            return
+        if self.futures.InPump():
+            # the tasklet that pumps us is the one waiting, blocking it would never wake,
+            # sleep on the scheduler so the other tasklets run until the fence is applied
+            while not self.fence.done:
+                sm.Sleep(0.001)
+            self.futures.Pump()
+            return
+        self.channel.receive()
+
+    # -----------------------------------------------------------------------------------
+    def Resolve(self):
+        # wake everyone waiting, a future can be waited on by more than one tasklet
+        while self.channel.balance < 0:
+            self.channel.send(None)
+
+
+# ======================================================================================
+class CommandFutures(object):
+    """
+        The futures waiting on the render thread. Pump is called once per tick on the
+        python thread, it resolves the futures whose fence was applied. The ticking tasklet
+        is marked with SetPumpTasklet, a Wait on it polls the fence instead of blocking.
+    """
+    def __init__(self):
+        self.pending = {}
+        self.pumpTasklet = None
+
+    # -----------------------------------------------------------------------------------
+    def SetPumpTasklet(self, tasklet):
+        self.pumpTasklet = tasklet
+
+    # -----------------------------------------------------------------------------------
+    def InPump(self):
+        return self.pumpTasklet is not None and stackless.getcurrent() is self.pumpTasklet
+
+    # -----------------------------------------------------------------------------------
+    def Queue(self):
+        import Graphics
+        fence = Graphics.CommandFence.Queue()
+        future = CommandFuture(fence, self)
+        self.pending[fence.id] = future
+        return future
+
+    # -----------------------------------------------------------------------------------
+    def Pump(self):
+        import Graphics
+        for fenceID in Graphics.CommandFence.Collect():
+            future = self.pending.pop(fenceID, None)
+            if future is not None:
+                future.Resolve()
@@ -10,6 +10,7 @@ import pkgutil
 import stackless
 import threading
 from Serivce import SERVICE_STATES
+from CommandFuture import CommandFutures
 __Services_Version__ = "1.0.0"
 
 
@@ -35,6 +36,8 @@ class ServiceManager(object):
         self.threadID = id(threading.currentThread())
         self.queuedEvents = stackless.channel()
         self.queuedEvents.preference = 1
+        self.commandFutures = CommandFutures()
+        self.tickHandlers = []
 
         stackless.tasklet(self.HandleQueuedScatterEvents)().run()
 
@@ -159,10 +162,80 @@ class ServiceManager(object):
             # evt = self.queuedEvents.receive()
             self.ProcessScatterEvent(event_name, *args, **kwargs)
 
+    # -----------------------------------------------------------------------------------
+    def RenderFuture(self):
+        """
+        A future that resolves once the render thread has applied every command queued so
+        far, property changes and bulk updates included.
+            sm.RenderFuture().Wait()
+        """
+        return self.commandFutures.Queue()
+
+    # -----------------------------------------------------------------------------------
+    def WaitForRender(self):
+        """
+        Block this tasklet until the render thread has caught up, instead of polling or sleeping.
+        From a tick it polls, the tick can't wait on itself.
+        """
+        self.commandFutures.Queue().Wait()
+
+    # -----------------------------------------------------------------------------------
+    def CaptureFrames(self, frames, path):
+        """
+        Profile the next frames and save them as a Chrome trace, for chrome://tracing or
+        Perfetto. Blocks this tasklet until the frames are drawn, returns True once saved.
+            sm.CaptureFrames(5, "/tmp/frames.json")
+        """
+        import Graphics
+        profiler = Graphics.FrameProfiler.GetInstance()
+        if profiler is None:
+            return False
+        profiler.Capture(frames)
+        while profiler.capturing:
+            self.WaitForRender()
+        return profiler.Save(path)
+
+    # -----------------------------------------------------------------------------------
+    def EnableRenderStats(self, enable=True, overlay=False):
+        """
+        Turn the render counters on or off, and the on screen graph of the phase times with
+        them. Counting starts with the next frame.
+            sm.EnableRenderStats()
+        """
+        import Graphics
+        Graphics.RenderStats.SetEnabled(enable)
+        Graphics.RenderStats.SetOverlay(enable and overlay)
+
+    # -----------------------------------------------------------------------------------
+    def RenderStats(self, frames=0):
+        """
+        The render counters and phase times averaged over the last frames, 0 for all that are
+        kept. None while the counting is off, see EnableRenderStats.
+            sm.RenderStats(60)["drawCalls"]
+        """
+        import Graphics
+        if not Graphics.RenderStats.GetEnabled():
+            return None
+        return Graphics.RenderStats.GetAverage(frames)
+
     # -----------------------------------------------------------------------------------
     def Sleep(self, time):
         StacklessSync.Sleep(time)
 
+    # -----------------------------------------------------------------------------------
+    def AddTickHandler(self, func):
+        """
+        Call func() every tick, after the services have ticked. For the helpers that aren't
+        services themselves but need a heart beat.
+        """
+        if func not in self.tickHandlers:
+            self.tickHandlers.append(func)
+
+    # -----------------------------------------------------------------------------------
+    def RemoveTickHandler(self, func):
+        if func in self.tickHandlers:
+            self.tickHandlers.remove(func)
+
     # -----------------------------------------------------------------------------------
     def TickServices(self):
         """
@@ -170,6 +243,9 @@ class ServiceManager(object):
         each service requesting a heart beat time, and then a thread pumping all services
         and keeping a queue of services in order of there next heart beat time.
         """
+        import Graphics
+        Graphics.PyReleaseQueue.Drain()     # what the render thread let go of since the last tick
+        self.commandFutures.Pump()
         now = time.clock()
         if self.lastTick is None:
             self.lastTick = now
@@ -177,9 +253,16 @@ class ServiceManager(object):
         #figure out timers
         delatT = now - self.lastTick
         self.lastTick = now
-        for svc in self._running_services.itervalues():
-            if hasattr(svc, "OnTick"):
-                svc.OnTick(delatT)
+        # a WaitForRender from a tick would wait on the Pump this tasklet does
+        self.commandFutures.SetPumpTasklet(stackless.getcurrent())
+        try:
+            for svc in self._running_services.itervalues():
+                if hasattr(svc, "OnTick"):
+                    svc.OnTick(delatT)
+            for func in list(self.tickHandlers):
+                func()
+        finally:
+            self.commandFutures.SetPumpTasklet(None)
 
     # -----------------------------------------------------------------------------------
     def SystemShutdown(self):
@@ -19,8 +19,18 @@ class TokenObjectSocketHandler(SocketHandlerBase.SocketHandlerBase):
         kwargs["item_id"] = self.token.item_id
         self.Send("tokenAttrUpdate_%s" % self.token.item_id, excludeOwnerID, **kwargs)
 
+    # -----------------------------------------------------------------------------------
+    def IsDeltaTracked(self):
+        """ The token's render changes go to the clients in the delta packets """
+        import Graphics
+        node = getattr(self.token, "renderObject", None)
+        stream = Graphics.DeltaStream.GetInstance()
+        return node is not None and stream is not None and stream.IsTracked(node)
+
     # -----------------------------------------------------------------------------------
     def OnItemChanged(self, item, key, value):
+        if key in ["x", "y", "z", "position", "rotation", "visible"] and self.IsDeltaTracked():
+            return
         a = {"item_id": item.item_id}
         if key in ["x", "y", "z"]:
             a["position"] = (item.x, item.y, item.z)
@@ -1,3 +1,4 @@
+import base64
 from ..WebService import SocketHandlerBase
 from traceback import format_exc
 
@@ -7,6 +8,35 @@ class TokenSocketHandler(SocketHandlerBase.SocketHandlerBase):
         SocketHandlerBase.SocketHandlerBase.__init__(self, validator)
 
         self.tokenMgr = tokenMgr
+        self.deltaViews = {}        # userID: DeltaStream view, the tokens the user is subscribed to
+        self.deltaItems = {}        # item_id: (render object, userIDs subscribed), tracked in the stream
+
+    # -----------------------------------------------------------------------------------
+    def GetDeltaStream(self):
+        import Graphics
+        return Graphics.DeltaStream.GetInstance()
+
+    # -----------------------------------------------------------------------------------
+    def DeltaView(self, userID):
+        stream = self.GetDeltaStream()
+        if stream is None:
+            return None, None
+        if userID not in self.deltaViews:
+            if not self.deltaViews:
+                sm.AddTickHandler(self.SendDeltas)
+            self.deltaViews[userID] = stream.AddView()
+        return stream, self.deltaViews[userID]
+
+    # -----------------------------------------------------------------------------------
+    def ReleaseDeltaItem(self, itemID, userID):
+        """ The user no longer sees the item, the stream stops tracking it once nobody does. """
+        if itemID not in self.deltaItems:
+            return
+        node, users = self.deltaItems[itemID]
+        users.discard(userID)
+        if not users:
+            del self.deltaItems[itemID]
+            self.GetDeltaStream().Untrack(node)
 
     # -----------------------------------------------------------------------------------
     def SubscribeToken(self, tokenID, _userID=None, *args, **kwargs):
@@ -15,6 +45,13 @@ class TokenSocketHandler(SocketHandlerBase.SocketHandlerBase):
             if tok is not None:
                 web = tok.Subscribe(_userID, self.webListeners[_userID], self.validator)
                 self.webListeners[_userID].RegisterHandler(*web)
+                node = getattr(tok, "renderObject", None)
+                stream, view = self.DeltaView(_userID)
+                if node is not None and stream is not None:
+                    if not stream.IsTracked(node):
+                        stream.Track(node, tok.item_id)
+                    self.deltaItems.setdefault(tok.item_id, (node, set()))[1].add(_userID)
+                    stream.Subscribe(view, tok.item_id)
             return {"Status": "OK",
                     "HandlerID": web[0],
                     "Token": tok.GetWeb()
@@ -30,6 +67,9 @@ class TokenSocketHandler(SocketHandlerBase.SocketHandlerBase):
             if tok is not None:
                 hndlID = tok.Unsubscribe(_userID)
                 self.webListeners[_userID].UnregisterHandler(hndlID)
+                if _userID in self.deltaViews:
+                    self.GetDeltaStream().Unsubscribe(self.deltaViews[_userID], tok.item_id)
+                    self.ReleaseDeltaItem(tok.item_id, _userID)
             return {"Status": "OK"}
         except Exception, e:
             return {"Status": "Exception", "message": str(e)}
@@ -47,6 +87,31 @@ class TokenSocketHandler(SocketHandlerBase.SocketHandlerBase):
     def RemoveListener(self, userID, socket):
         if userID in self.webListeners:
             del self.webListeners[userID]
+        if userID in self.deltaViews:
+            self.GetDeltaStream().RemoveView(self.deltaViews.pop(userID))
+            for itemID in [i for i, (node, users) in self.deltaItems.iteritems() if userID in users]:
+                self.ReleaseDeltaItem(itemID, userID)
+            if not self.deltaViews:
+                sm.RemoveTickHandler(self.SendDeltas)
+
+    # -----------------------------------------------------------------------------------
+    def SendDeltas(self):
+        """ Send each user one packet with the render changes to their tokens since the
+            last call. Ticked by the service manager while anyone has a view. Sockets that can't send binary get it base64
+            in a tokenDelta message. """
+        stream = self.GetDeltaStream()
+        if stream is None or not self.deltaViews:
+            return
+        packets = stream.Flush()
+        for userID, view in self.deltaViews.iteritems():
+            packet = packets.get(view)
+            if packet is None or userID not in self.webListeners:
+                continue
+            socket = self.webListeners[userID]
+            if hasattr(socket, "SendBinary"):
+                socket.SendBinary(packet)
+            else:
+                socket.Send("tokenDelta", packet=base64.b64encode(packet))
 
     # -----------------------------------------------------------------------------------
     def Send(self, eventName, excludeUserID=None, **kwargs):